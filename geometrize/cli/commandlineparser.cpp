@@ -1,5 +1,9 @@
 #include "commandlineparser.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
 #include <QApplication>
 #include <QCommandLineOption>
 #include <QCommandLineParser>
@@ -12,6 +16,8 @@
 #include "localization/strings.h"
 #include "script/chaiscriptcreator.h"
 #include "script/scriptrunner.h"
+#include "task/stopconditions.h"
+#include "task/synchronousimagetask.h"
 #include "task/taskutil.h"
 
 namespace
@@ -19,6 +25,9 @@ namespace
     const QString scriptFileFlag{"script_file"};
     const QString scriptSourceFlag{"script_inline"};
     const QString localeOverrideFlag{"locale_override"};
+    const QString resumeFlag{"resume"};
+
+    const std::uint32_t resumeCheckpointInterval{60}; // The minimum number of seconds between checkpoints written by a resumed task
 }
 
 namespace geometrize
@@ -42,6 +51,7 @@ void setupCommandLineParser(QCommandLineParser& parser, const QStringList& argum
     parser.addOption(QCommandLineOption(scriptFileFlag, "Executes the ChaiScript script file at the given file path", "File path to ChaiScript script file"));
     parser.addOption(QCommandLineOption(scriptSourceFlag, "Executes the inline ChaiScript source code unmodified", "Inline ChaiScript source code"));
     parser.addOption(QCommandLineOption(localeOverrideFlag, "Overrides the locale and translation that the application launches with", "Locale code"));
+    parser.addOption(QCommandLineOption(resumeFlag, "Resumes the image task checkpoint at the given file path, running it until its stop conditions are met and updating the checkpoint as it goes", "File path to image task checkpoint"));
 
     if(!parser.parse(arguments)) {
         assert(0 && "Failed to parse command line arguments");
@@ -50,31 +60,58 @@ void setupCommandLineParser(QCommandLineParser& parser, const QStringList& argum
     parser.process(arguments);
 }
 
+/**
+ * @brief resumeCheckpoint Resumes an image task from a checkpoint and runs it until it meets the stop conditions in its preferences.
+ * @param checkpointPath The path to the checkpoint file, which is kept up to date while the task runs.
+ * @return 0 on success, any other return code if the checkpoint could not be resumed.
+ */
+int resumeCheckpoint(const std::string& checkpointPath)
+{
+    const std::shared_ptr<geometrize::task::SynchronousImageTask> task{geometrize::task::SynchronousImageTask::resume(checkpointPath)};
+    if(!task) {
+        geometrize::util::printToConsole("Failed to read image task checkpoint: " + checkpointPath);
+        return 1;
+    }
+
+    geometrize::util::printToConsole("Resuming image task with " + std::to_string(task->getShapes().size()) + " shapes from checkpoint: " + checkpointPath);
+    task->setCheckpointFile(checkpointPath, resumeCheckpointInterval);
+    if(task->run() == geometrize::task::StopReason::NONE) {
+        geometrize::util::printToConsole("The resumed image task has no stop conditions set, so it was not stepped");
+        return 0;
+    }
+    geometrize::util::printToConsole("Image task finished with " + std::to_string(task->getShapes().size()) + " shapes, saved to checkpoint: " + checkpointPath);
+    return 0;
+}
+
 /**
  * @brief handleArgumentPairs Handles the arguments that were set on the parser.
  * @param parser The parser to use to use.
+ * @return 0 on success, any other return code if there was an error.
  */
-void handleCommandLineArguments(QCommandLineParser& parser)
+int handleCommandLineArguments(QCommandLineParser& parser)
 {
     if(parser.isSet(scriptFileFlag)) {
         const QString scriptPath{parser.value(scriptFileFlag)};
         const std::string code{geometrize::util::readFileAsString(scriptPath.toStdString())};
 
         std::unique_ptr<chaiscript::ChaiScript> engine{geometrize::script::createImageTaskEngine()};
-        geometrize::script::runScript(code, *engine);
+        geometrize::script::runScript(code, *engine, scriptPath.toStdString());
     } else if(parser.isSet(scriptSourceFlag)) {
         const std::string code{parser.value(scriptSourceFlag).toStdString()};
 
         std::unique_ptr<chaiscript::ChaiScript> engine{geometrize::script::createImageTaskEngine()};
         geometrize::script::runScript(code, *engine);
+    } else if(parser.isSet(resumeFlag)) {
+        return resumeCheckpoint(parser.value(resumeFlag).toStdString());
     }
+    return 0;
 }
 
 bool shouldRunInConsoleMode(const QStringList& arguments)
 {
     QCommandLineParser parser;
     setupCommandLineParser(parser, arguments);
-    return parser.isSet(scriptFileFlag) || parser.isSet(scriptSourceFlag);
+    return parser.isSet(scriptFileFlag) || parser.isSet(scriptSourceFlag) || parser.isSet(resumeFlag);
 }
 
 std::string getOverrideLocaleCode(const QStringList& arguments)
@@ -94,9 +131,7 @@ int runApp(QApplication& app)
 
     QCommandLineParser parser;
     setupCommandLineParser(parser, arguments);
-    handleCommandLineArguments(parser);
-
-    return 0;
+    return handleCommandLineArguments(parser);
 }
 
 }
@@ -213,6 +213,14 @@ QString openTargetImagePickerDialog(QWidget* parent)
                                         QWidget::tr("Image Files (*.jpg *.jpeg *.png *.bmp)", "List of supported image file formats. The text in the parentheses must not be changed"));
 }
 
+QString openSaveScriptProfileDialog(QWidget* parent)
+{
+    return QFileDialog::getSaveFileName(parent,
+                                        QWidget::tr("Save Script Profile", "Title on a dialog that allows the user to save the timings of the scripts that have been run"),
+                                        "",
+                                        QWidget::tr("JSON Data (*.json)", "List of supported script profile file formats. The text in the parentheses must not be changed"));
+}
+
 }
 
 }
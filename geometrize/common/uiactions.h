@@ -44,6 +44,7 @@ QString openSaveImageTaskSettingsDialog(QWidget* parent);
 QString openLoadGlobalSettingsDialog(QWidget* parent);
 QString openSaveGlobalSettingsDialog(QWidget* parent);
 QString openTargetImagePickerDialog(QWidget* parent);
+QString openSaveScriptProfileDialog(QWidget* parent);
 
 }
 
@@ -27,7 +27,7 @@ namespace dialog
 class ImageTaskExportWidget::ImageTaskExportWidgetImpl
 {
 public:
-    ImageTaskExportWidgetImpl(ImageTaskExportWidget* pQ) : m_task{nullptr}, m_shapes{nullptr}, q{pQ}, ui{std::make_unique<Ui::ImageTaskExportWidget>()}
+    ImageTaskExportWidgetImpl(ImageTaskExportWidget* pQ) : m_task{nullptr}, q{pQ}, ui{std::make_unique<Ui::ImageTaskExportWidget>()}
     {
         ui->setupUi(q);
         populateUi();
@@ -36,15 +36,14 @@ public:
     ImageTaskExportWidgetImpl operator=(const ImageTaskExportWidgetImpl&) = delete;
     ImageTaskExportWidgetImpl(const ImageTaskExportWidgetImpl&) = delete;
 
-    void setImageTask(const task::ImageTask* task, const std::vector<geometrize::ShapeResult>* shapes)
+    void setImageTask(const task::ImageTask* task)
     {
         m_task = task;
-        m_shapes = shapes;
     }
 
     void saveSVG() const
     {
-        if(!m_task || !m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -54,13 +53,13 @@ public:
             return;
         }
 
-        const std::string data{geometrize::exporter::exportSVG(*m_shapes, m_task->getCurrent().getWidth(), m_task->getCurrent().getHeight())};
+        const std::string data{geometrize::exporter::exportSVG(m_task->getShapes().toVector(), m_task->getWidth(), m_task->getHeight())};
         util::writeStringToFile(data, path.toStdString());
     }
 
     void saveRasterizedSVG() const
     {
-        if(!m_task || !m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -72,10 +71,10 @@ public:
 
         // Rasterize as x3 normal size and downscale for less jaggy result
         const std::uint32_t scaleFactor{3};
-        const std::uint32_t width{m_task->getCurrent().getWidth()};
-        const std::uint32_t height{m_task->getCurrent().getHeight()};
+        const std::uint32_t width{m_task->getWidth()};
+        const std::uint32_t height{m_task->getHeight()};
         geometrize::exporter::exportRasterizedSvg(
-                    *m_shapes,
+                    m_task->getShapes().toVector(),
                     width,
                     height,
                     width * scaleFactor,
@@ -85,7 +84,7 @@ public:
 
     void saveRasterizedSVGs() const
     {
-        if(!m_task || !m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -97,10 +96,10 @@ public:
 
         // Rasterize as x3 normal size and downscale for less jaggy result
         const std::uint32_t scaleFactor{3};
-        const std::uint32_t width{m_task->getCurrent().getWidth()};
-        const std::uint32_t height{m_task->getCurrent().getHeight()};
+        const std::uint32_t width{m_task->getWidth()};
+        const std::uint32_t height{m_task->getHeight()};
         geometrize::exporter::exportRasterizedSvgs(
-                    *m_shapes,
+                    m_task->getShapes().toVector(),
                     width,
                     height,
                     width * scaleFactor,
@@ -112,7 +111,7 @@ public:
 
     void saveGeometryData() const
     {
-        if(!m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -129,13 +128,13 @@ public:
             format = geometrize::exporter::ShapeDataFormat::CUSTOM_ARRAY;
         }
 
-        const std::string data{geometrize::exporter::exportShapeData(*m_shapes, format)};
+        const std::string data{geometrize::exporter::exportShapeData(m_task->getShapes().toVector(), format)};
         util::writeStringToFile(data, path.toStdString());
     }
 
     void saveGIF() const
     {
-        if(!m_task || !m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -147,10 +146,10 @@ public:
 
         // Rasterize as x3 normal size and downscale for less jaggy result
         const std::uint32_t scaleFactor{3};
-        const std::uint32_t width{m_task->getCurrent().getWidth()};
-        const std::uint32_t height{m_task->getCurrent().getHeight()};
+        const std::uint32_t width{m_task->getWidth()};
+        const std::uint32_t height{m_task->getHeight()};
         geometrize::exporter::exportGIF(
-            *m_shapes,
+            m_task->getShapes().toVector(),
             width,
             height,
             width * scaleFactor,
@@ -160,7 +159,7 @@ public:
 
     void saveHTML5WebpageButton() const
     {
-        if(!m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -170,13 +169,13 @@ public:
             return;
         }
 
-        const std::string pageSource{geometrize::exporter::exportCanvasWebpage(*m_shapes)};
+        const std::string pageSource{geometrize::exporter::exportCanvasWebpage(m_task->getShapes().toVector())};
         util::writeStringToFile(pageSource, path.toStdString());
     }
 
     void saveWebGLWebpageButton() const
     {
-        if(!m_shapes) {
+        if(!m_task) {
             showExportMisconfiguredMessage();
             return;
         }
@@ -186,7 +185,7 @@ public:
             return;
         }
 
-        const std::string pageSource{geometrize::exporter::exportWebGLWebpage(*m_shapes)};
+        const std::string pageSource{geometrize::exporter::exportWebGLWebpage(m_task->getShapes().toVector())};
         util::writeStringToFile(pageSource, path.toStdString());
     }
 
@@ -208,7 +207,6 @@ private:
     }
 
     const geometrize::task::ImageTask* m_task;
-    const std::vector<geometrize::ShapeResult>* m_shapes;
 
     ImageTaskExportWidget* q;
     std::unique_ptr<Ui::ImageTaskExportWidget> ui;
@@ -224,9 +222,9 @@ ImageTaskExportWidget::~ImageTaskExportWidget()
 {
 }
 
-void ImageTaskExportWidget::setImageTask(const task::ImageTask* task, const std::vector<geometrize::ShapeResult>* shapes)
+void ImageTaskExportWidget::setImageTask(const task::ImageTask* task)
 {
-    d->setImageTask(task, shapes);
+    d->setImageTask(task);
 }
 
 void ImageTaskExportWidget::on_saveImageButton_clicked()
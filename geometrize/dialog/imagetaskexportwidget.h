@@ -1,17 +1,11 @@
 #pragma once
 
 #include <memory>
-#include <vector>
 
 #include <QWidget>
 
 class QEvent;
 
-namespace geometrize
-{
-struct ShapeResult;
-}
-
 namespace geometrize
 {
 
@@ -41,10 +35,9 @@ public:
 
     /**
      * @brief setImageTask Sets the current image task used by the export functions.
-     * @param task Non-owning pointer to the image task that the exporters on this widget will use.
-     * @param shapes A non-owning pointer to the shape data produced by the image task.
+     * @param task Non-owning pointer to the image task that the exporters on this widget will use. The exporters export every shape in the task's shape log.
      */
-    void setImageTask(const task::ImageTask* task, const std::vector<geometrize::ShapeResult>* shapes);
+    void setImageTask(const task::ImageTask* task);
 
 protected:
     void changeEvent(QEvent*) override;
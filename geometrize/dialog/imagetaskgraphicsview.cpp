@@ -1,6 +1,8 @@
 #include "imagetaskgraphicsview.h"
 
 #include <QEvent>
+#include <QMouseEvent>
+#include <QRubberBand>
 #include <QWheelEvent>
 
 namespace geometrize
@@ -9,7 +11,7 @@ namespace geometrize
 namespace dialog
 {
 
-ImageTaskGraphicsView::ImageTaskGraphicsView(QWidget* parent) : QGraphicsView(parent)
+ImageTaskGraphicsView::ImageTaskGraphicsView(QWidget* parent) : QGraphicsView(parent), m_regionBand{nullptr}, m_drawingRegion{false}, m_regionIsEllipse{false}
 {
     setMouseTracking(true);
     setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
@@ -53,11 +55,52 @@ void ImageTaskGraphicsView::wheelEvent(QWheelEvent* e)
     }
 }
 
+void ImageTaskGraphicsView::mousePressEvent(QMouseEvent* event)
+{
+    if(event->button() != Qt::LeftButton || !(event->modifiers() & Qt::ShiftModifier)) {
+        QGraphicsView::mousePressEvent(event);
+        return;
+    }
+
+    if(!m_regionBand) {
+        m_regionBand = new QRubberBand(QRubberBand::Rectangle, viewport());
+    }
+    m_drawingRegion = true;
+    m_regionIsEllipse = !(event->modifiers() & Qt::ControlModifier);
+    m_regionOrigin = event->pos();
+    m_regionBand->setGeometry(QRect(m_regionOrigin, QSize()));
+    m_regionBand->show();
+    event->accept();
+}
+
 void ImageTaskGraphicsView::mouseMoveEvent(QMouseEvent* event)
 {
+    if(m_drawingRegion) {
+        m_regionBand->setGeometry(QRect(m_regionOrigin, event->pos()).normalized());
+        event->accept();
+        return;
+    }
     QGraphicsView::mouseMoveEvent(event);
 }
 
+void ImageTaskGraphicsView::mouseReleaseEvent(QMouseEvent* event)
+{
+    if(!m_drawingRegion || event->button() != Qt::LeftButton) {
+        QGraphicsView::mouseReleaseEvent(event);
+        return;
+    }
+
+    m_drawingRegion = false;
+    m_regionBand->hide();
+    event->accept();
+
+    const QRect viewRect{QRect(m_regionOrigin, event->pos()).normalized()};
+    if(viewRect.width() < 2 || viewRect.height() < 2) {
+        return; // Treat tiny drags as clicks rather than regions
+    }
+    emit regionDrawn(mapToScene(viewRect).boundingRect(), m_regionIsEllipse);
+}
+
 void ImageTaskGraphicsView::changeEvent(QEvent* event)
 {
     if (event->type() == QEvent::LanguageChange) {
@@ -2,8 +2,12 @@
 
 #include <QGraphicsView>
 #include <QObject>
+#include <QPoint>
+#include <QRectF>
 
 class QEvent;
+class QMouseEvent;
+class QRubberBand;
 class QWheelEvent;
 
 namespace geometrize
@@ -14,6 +18,7 @@ namespace dialog
 
 /**
  * @brief The ImageTaskGraphicsView class models a graphics view for viewing the images and shapes used and/or produced by image tasks.
+ * Dragging pans the view, while dragging with Shift held draws a region over the image (an ellipse, or a rectangle if Ctrl is held too).
  */
 class ImageTaskGraphicsView : public QGraphicsView
 {
@@ -22,6 +27,14 @@ class ImageTaskGraphicsView : public QGraphicsView
 public:
     explicit ImageTaskGraphicsView(QWidget* parent = nullptr);
 
+signals:
+    /**
+     * @brief regionDrawn Signal dispatched when the user finishes drawing a region over the view.
+     * @param sceneRect The bounds of the region, in scene coordinates.
+     * @param ellipse True if the region is the ellipse inscribed in the bounds, false if it is the rectangle.
+     */
+    void regionDrawn(const QRectF& sceneRect, bool ellipse);
+
 protected:
     void changeEvent(QEvent*) override;
 
@@ -29,7 +42,14 @@ private:
     void populateUi();
 
     void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+
+    QRubberBand* m_regionBand; ///> Previews the bounds of the region being drawn, hidden while no region is being drawn
+    QPoint m_regionOrigin; ///> The viewport position that the region being drawn started at
+    bool m_drawingRegion; ///> Whether the user is dragging out a region rather than panning
+    bool m_regionIsEllipse; ///> Whether the region being drawn is an ellipse rather than a rectangle
 };
 
 }
@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "dialog/imagetaskpixmapgraphicsitem.h"
+#include "dialog/imagetaskregionsgraphicsitem.h"
 
 namespace geometrize
 {
@@ -17,6 +18,8 @@ public:
     {
         q->addItem(&m_workingPixmapItem);
         q->addItem(&m_targetPixmapItem);
+        m_regionsItem.setZValue(2);
+        q->addItem(&m_regionsItem);
     }
     ImageTaskPixmapSceneImpl operator=(const ImageTaskPixmapSceneImpl&) = delete;
     ImageTaskPixmapSceneImpl(const ImageTaskPixmapSceneImpl&) = delete;
@@ -37,11 +40,17 @@ public:
         m_targetPixmapItem.setPixmap(pixmap);
     }
 
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+    {
+        m_regionsItem.setRegions(regions);
+    }
+
 private:
     ImageTaskPixmapScene* q;
 
     ImageTaskPixmapGraphicsItem m_workingPixmapItem;
     ImageTaskPixmapGraphicsItem m_targetPixmapItem;
+    ImageTaskRegionsGraphicsItem m_regionsItem;
 };
 
 ImageTaskPixmapScene::ImageTaskPixmapScene(QObject* parent) : QGraphicsScene{parent}, d{std::make_unique<ImageTaskPixmapScene::ImageTaskPixmapSceneImpl>(this)}
@@ -67,6 +76,11 @@ void ImageTaskPixmapScene::setTargetPixmap(const QPixmap& pixmap)
     d->setTargetPixmap(pixmap);
 }
 
+void ImageTaskPixmapScene::setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+{
+    d->setWeightRegions(regions);
+}
+
 }
 
 }
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <QGraphicsScene>
 #include <QMouseEvent>
 #include <QWheelEvent>
 
+#include "optimizer/weightmask.h"
+
 namespace geometrize
 {
 
@@ -41,6 +44,12 @@ public:
      */
     void setTargetPixmap(const QPixmap& pixmap);
 
+    /**
+     * @brief setWeightRegions Sets the weight regions outlined over the images.
+     * @param regions The weight regions, in pixels of the target image.
+     */
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions);
+
 private:
     class ImageTaskPixmapSceneImpl;
     std::unique_ptr<ImageTaskPixmapSceneImpl> d;
@@ -0,0 +1,76 @@
+#include "imagetaskregionsgraphicsitem.h"
+
+#include <QColor>
+#include <QPainter>
+#include <QPen>
+
+namespace geometrize
+{
+
+namespace dialog
+{
+
+namespace
+{
+
+QRectF getRegionRect(const geometrize::optimizer::WeightRegion& region)
+{
+    // Region bounds are inclusive pixel coordinates, so the far edge is one past the last pixel
+    return QRectF(QPointF(region.x1, region.y1), QPointF(region.x2 + 1, region.y2 + 1));
+}
+
+}
+
+ImageTaskRegionsGraphicsItem::ImageTaskRegionsGraphicsItem() : QGraphicsItem()
+{
+    setFlag(ItemIsMovable, false);
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+ImageTaskRegionsGraphicsItem::~ImageTaskRegionsGraphicsItem()
+{
+}
+
+void ImageTaskRegionsGraphicsItem::setRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+{
+    prepareGeometryChange();
+    m_regions = regions;
+    m_bounds = QRectF();
+    for(const geometrize::optimizer::WeightRegion& region : m_regions) {
+        m_bounds = m_bounds.united(getRegionRect(region));
+    }
+    update();
+}
+
+QRectF ImageTaskRegionsGraphicsItem::boundingRect() const
+{
+    // Pad for the pen, which is drawn centered on the outline
+    return m_bounds.adjusted(-2, -2, 2, 2);
+}
+
+void ImageTaskRegionsGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/)
+{
+    QPen pen(Qt::DashLine);
+    pen.setCosmetic(true);
+    pen.setWidth(2);
+
+    painter->setBrush(Qt::NoBrush);
+    for(const geometrize::optimizer::WeightRegion& region : m_regions) {
+        // Fainter outlines for regions that matter less
+        QColor color(Qt::yellow);
+        color.setAlpha(64 + region.weight * 191 / 255);
+        pen.setColor(color);
+        painter->setPen(pen);
+
+        const QRectF rect{getRegionRect(region)};
+        if(region.shape == geometrize::optimizer::WeightRegion::Shape::ELLIPSE) {
+            painter->drawEllipse(rect);
+        } else {
+            painter->drawRect(rect);
+        }
+    }
+}
+
+}
+
+}
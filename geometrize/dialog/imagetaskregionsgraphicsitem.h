@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include <QGraphicsItem>
+#include <QRectF>
+
+#include "optimizer/weightmask.h"
+
+class QPainter;
+class QStyleOptionGraphicsItem;
+class QWidget;
+
+namespace geometrize
+{
+
+namespace dialog
+{
+
+/**
+ * @brief The ImageTaskRegionsGraphicsItem class models a graphic item that outlines the weight regions of an image task.
+ * The outlines are drawn over the images, at a constant width however far the view is zoomed.
+ */
+class ImageTaskRegionsGraphicsItem : public QGraphicsItem
+{
+public:
+    explicit ImageTaskRegionsGraphicsItem();
+    ~ImageTaskRegionsGraphicsItem();
+
+    /**
+     * @brief setRegions Sets the regions to outline.
+     * @param regions The weight regions, in pixels of the target image.
+     */
+    void setRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    std::vector<geometrize::optimizer::WeightRegion> m_regions; ///> The regions to outline
+    QRectF m_bounds; ///> The bounds of all the regions
+};
+
+}
+
+}
@@ -1,6 +1,8 @@
 #include "imagetaskrunnerwidget.h"
 #include "ui_imagetaskrunnerwidget.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 #include <QEvent>
@@ -20,7 +22,7 @@ namespace dialog
 class ImageTaskRunnerWidget::ImageTaskRunnerWidgetImpl
 {
 public:
-    ImageTaskRunnerWidgetImpl(ImageTaskRunnerWidget* pQ) : q{pQ}, ui{std::make_unique<Ui::ImageTaskRunnerWidget>()}
+    ImageTaskRunnerWidgetImpl(ImageTaskRunnerWidget* pQ) : m_task{nullptr}, q{pQ}, ui{std::make_unique<Ui::ImageTaskRunnerWidget>()}
     {
         ui->setupUi(q);
 
@@ -45,18 +47,26 @@ public:
 
         populateUi();
     }
-    ~ImageTaskRunnerWidgetImpl() = default;
+    ~ImageTaskRunnerWidgetImpl()
+    {
+        if(m_runningChangedConnection) {
+            disconnect(m_runningChangedConnection);
+        }
+    }
     ImageTaskRunnerWidgetImpl operator=(const ImageTaskRunnerWidgetImpl&) = delete;
     ImageTaskRunnerWidgetImpl(const ImageTaskRunnerWidgetImpl&) = delete;
 
     void setImageTask(task::ImageTask* task)
     {
         m_task = task;
-    }
 
-    void setRunStopButtonText(const QString& text)
-    {
-        ui->runStopButton->setText(text);
+        if(m_runningChangedConnection) {
+            disconnect(m_runningChangedConnection);
+        }
+        m_runningChangedConnection = connect(m_task, &task::ImageTask::signal_runningChanged, [this](bool) {
+            updateRunStopButtonText();
+        });
+        updateRunStopButtonText();
     }
 
     void syncUserInterface()
@@ -90,12 +100,23 @@ public:
 
         ui->maxThreadsSpinBox->setValue(opts.maxThreads);
 
+        ui->pyramidDepthSpinBox->setValue(prefs.getPyramidDepth());
+        ui->searchesPerStepSpinBox->setValue(prefs.getSearchesPerStep());
+        ui->tileSizeSpinBox->setValue(prefs.getTileSize());
+        ui->errorGuidedSampling->setChecked(prefs.isErrorGuidedSamplingEnabled());
+        ui->regionOfInterest->setChecked(prefs.isRegionOfInterestEnabled());
+
         // If the script editor is set up, populate it with the current scripts (and apply to engine)
         // TODO
     }
 
     void toggleRunning()
     {
+        if(m_task->isRunning()) {
+            m_task->stopRunning();
+        } else {
+            m_task->startRunning(static_cast<std::size_t>(ui->stepLimitSpinBox->value()));
+        }
         emit q->runStopButtonClicked();
     }
 
@@ -149,10 +170,41 @@ public:
         m_task->getPreferences().setMaxThreads(value);
     }
 
-    void setRegionOfInterestEnabled(const bool /*enabled*/)
+    void setPyramidDepth(const int value)
     {
-        // TODO
-        //m_task->getPreferences().setRegionOfInterestEnabled(enabled);
+        m_task->getPreferences().setPyramidDepth(value);
+    }
+
+    void setSearchesPerStep(const int value)
+    {
+        m_task->getPreferences().setSearchesPerStep(value);
+    }
+
+    void setTileSize(const int value)
+    {
+        m_task->getPreferences().setTileSize(value);
+    }
+
+    void setErrorGuidedSamplingEnabled(const bool enabled)
+    {
+        m_task->getPreferences().setErrorGuidedSamplingEnabled(enabled);
+    }
+
+    void setRegionOfInterestEnabled(const bool enabled)
+    {
+        m_task->getPreferences().setRegionOfInterestEnabled(enabled);
+        emit q->regionsChanged();
+    }
+
+    void clearRegions()
+    {
+        m_task->getPreferences().clearWeightRegions();
+        emit q->regionsChanged();
+    }
+
+    std::uint8_t getRegionWeight() const
+    {
+        return static_cast<std::uint8_t>((ui->regionWeightSpinBox->value() * 255 + 50) / 100);
     }
 
     void onLanguageChange()
@@ -164,12 +216,22 @@ public:
 private:
     void populateUi()
     {
+        updateRunStopButtonText();
+    }
 
+    void updateRunStopButtonText()
+    {
+        if(m_task && m_task->isRunning()) {
+            ui->runStopButton->setText(tr("Stop", "Text on a button that the user presses to make the app stop/pause transforming an image into shapes"));
+        } else {
+            ui->runStopButton->setText(tr("Start", "Text on a button that the user presses to make the app start/begin transforming an image into shapes"));
+        }
     }
 
     geometrize::task::ImageTask* m_task;
     ImageTaskRunnerWidget* q;
     std::unique_ptr<Ui::ImageTaskRunnerWidget> ui;
+    QMetaObject::Connection m_runningChangedConnection{}; ///> Connection for updating the run/stop button when the image task starts or stops running
 };
 
 ImageTaskRunnerWidget::ImageTaskRunnerWidget(QWidget* parent) :
@@ -187,14 +249,14 @@ void ImageTaskRunnerWidget::setImageTask(task::ImageTask* task)
     d->setImageTask(task);
 }
 
-void ImageTaskRunnerWidget::setRunStopButtonText(const QString& text)
+void ImageTaskRunnerWidget::syncUserInterface()
 {
-    d->setRunStopButtonText(text);
+    d->syncUserInterface();
 }
 
-void ImageTaskRunnerWidget::syncUserInterface()
+std::uint8_t ImageTaskRunnerWidget::getRegionWeight() const
 {
-    d->syncUserInterface();
+    return d->getRegionWeight();
 }
 
 void ImageTaskRunnerWidget::on_runStopButton_clicked()
@@ -282,11 +344,36 @@ void ImageTaskRunnerWidget::on_maxThreadsSpinBox_valueChanged(int value)
     d->setMaxThreads(value);
 }
 
+void ImageTaskRunnerWidget::on_pyramidDepthSpinBox_valueChanged(int value)
+{
+    d->setPyramidDepth(value);
+}
+
+void ImageTaskRunnerWidget::on_searchesPerStepSpinBox_valueChanged(int value)
+{
+    d->setSearchesPerStep(value);
+}
+
+void ImageTaskRunnerWidget::on_tileSizeSpinBox_valueChanged(int value)
+{
+    d->setTileSize(value);
+}
+
+void ImageTaskRunnerWidget::on_errorGuidedSampling_clicked(bool checked)
+{
+    d->setErrorGuidedSamplingEnabled(checked);
+}
+
 void ImageTaskRunnerWidget::on_regionOfInterest_clicked(bool checked)
 {
     d->setRegionOfInterestEnabled(checked);
 }
 
+void ImageTaskRunnerWidget::on_clearRegionsButton_clicked()
+{
+    d->clearRegions();
+}
+
 void ImageTaskRunnerWidget::changeEvent(QEvent* event)
 {
     if (event->type() == QEvent::LanguageChange) {
@@ -1,8 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
-#include <QString>
 #include <QWidget>
 
 class QEvent;
@@ -25,6 +25,7 @@ namespace dialog
 
 /**
  * @brief The ImageTaskRunnerWidget implements a widget for manipulating and changing the settings of an image task e.g. the number of times to mutate each shape the task generates.
+ * The run/stop button starts and stops the image task directly, optionally limited to a number of steps.
  */
 class ImageTaskRunnerWidget : public QWidget
 {
@@ -40,23 +41,23 @@ public:
      */
     void setImageTask(task::ImageTask* task);
 
-    /**
-     * @brief setRunStopButtonText Sets the text on the run/stop button in the UI.
-     * @param text The text to set on the run/stop button.
-     */
-    void setRunStopButtonText(const QString& text);
-
     /**
      * @brief syncUserInterface Syncs the user interface with the current image task.
      * This should be called after setting a new image task, or new task settings.
-     * Note this does not change the run/stop button text.
      */
     void syncUserInterface();
 
+    /**
+     * @brief getRegionWeight Gets the weight that the next region drawn over the image is given.
+     * @return The region weight, where 255 matters the most.
+     */
+    std::uint8_t getRegionWeight() const;
+
 signals:
     void runStopButtonClicked();
     void stepButtonClicked();
     void clearButtonClicked();
+    void regionsChanged();
 
 protected:
     void changeEvent(QEvent*) override;
@@ -81,7 +82,12 @@ private slots:
     void on_mutationsPerCandidateShapeSlider_valueChanged(int value);
     void on_randomSeedSpinBox_valueChanged(int value);
     void on_maxThreadsSpinBox_valueChanged(int value);
+    void on_pyramidDepthSpinBox_valueChanged(int value);
+    void on_searchesPerStepSpinBox_valueChanged(int value);
+    void on_tileSizeSpinBox_valueChanged(int value);
+    void on_errorGuidedSampling_clicked(bool checked);
     void on_regionOfInterest_clicked(bool checked);
+    void on_clearRegionsButton_clicked();
 
 private:
     class ImageTaskRunnerWidgetImpl;
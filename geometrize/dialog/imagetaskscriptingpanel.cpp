@@ -6,9 +6,13 @@
 #include <string>
 
 #include <QEvent>
+#include <QMessageBox>
+#include <QTimer>
 
+#include "common/uiactions.h"
 #include "dialog/scripteditorwidget.h"
 #include "script/geometrizerengine.h"
+#include "script/scriptprofiler.h"
 #include "script/scriptutil.h"
 #include "task/imagetask.h"
 
@@ -59,6 +63,20 @@ public:
         connect(ui->resetScriptEngineButton, &QPushButton::pressed, [this]() {
             m_task->getPreferences().setScripts(getScripts());
         });
+
+        // Setup the script profiler controls, the profiler is shared by every image task so the panels all show the same timings
+        connect(ui->profileScriptsButton, &QCheckBox::toggled, [this](const bool enabled) {
+            script::getSharedScriptProfiler().setEnabled(enabled);
+            setProfilingEnabled(enabled);
+        });
+        connect(ui->exportProfileButton, &QPushButton::pressed, [this]() {
+            exportProfile();
+        });
+        connect(&m_profileTimer, &QTimer::timeout, [this]() {
+            updateProfileView();
+        });
+        m_profileTimer.setInterval(1000);
+        setProfilingEnabled(script::getSharedScriptProfiler().isEnabled());
     }
     ~ImageTaskScriptingPanelImpl() = default;
     ImageTaskScriptingPanelImpl operator=(const ImageTaskScriptingPanelImpl&) = delete;
@@ -69,12 +87,13 @@ public:
         m_task = task;
 
         // Connect to the geometrizer that can update the widget when it tries to
+        // Scripts are evaluated on the worker, so the panel is given as the context to have the editors updated on the UI thread
         geometrize::script::GeometrizerEngine& geometrizer{m_task->getGeometrizer()};
 
         if(m_scriptEvaluationSucceededConnection) {
             disconnect(m_scriptEvaluationSucceededConnection);
         }
-        m_scriptEvaluationSucceededConnection = connect(&geometrizer, &geometrize::script::GeometrizerEngine::signal_scriptEvaluationSucceeded, [this](const std::string& functionName, const std::string& /*code*/) {
+        m_scriptEvaluationSucceededConnection = connect(&geometrizer, &geometrize::script::GeometrizerEngine::signal_scriptEvaluationSucceeded, q, [this](const std::string& functionName, const std::string& /*code*/) {
             if(dialog::ScriptEditorWidget* editor = findEditor(functionName)) {
                 editor->onScriptEvaluationSucceeded();
             }
@@ -83,7 +102,7 @@ public:
         if(m_scriptEvaluationFailedConnection) {
             disconnect(m_scriptEvaluationFailedConnection);
         }
-        m_scriptEvaluationFailedConnection = connect(&geometrizer, &geometrize::script::GeometrizerEngine::signal_scriptEvaluationFailed, [this](const std::string& functionName, const std::string& /*code*/, const std::string& errorMessage) {
+        m_scriptEvaluationFailedConnection = connect(&geometrizer, &geometrize::script::GeometrizerEngine::signal_scriptEvaluationFailed, q, [this](const std::string& functionName, const std::string& /*code*/, const std::string& errorMessage) {
             if(dialog::ScriptEditorWidget* editor = findEditor(functionName)) {
                 editor->onScriptEvaluationFailed(errorMessage);
             }
@@ -96,6 +115,7 @@ public:
     {
         setScriptModeEnabled(m_task->getPreferences().isScriptModeEnabled());
         setScripts(m_task->getPreferences().getScripts());
+        setProfilingEnabled(script::getSharedScriptProfiler().isEnabled());
     }
 
     void onLanguageChange()
@@ -120,6 +140,35 @@ private:
         }
     }
 
+    void setProfilingEnabled(const bool enabled)
+    {
+        ui->profileScriptsButton->setChecked(enabled);
+        ui->profileView->setVisible(enabled);
+        if(enabled) {
+            updateProfileView();
+            m_profileTimer.start();
+        } else {
+            m_profileTimer.stop();
+        }
+    }
+
+    void updateProfileView()
+    {
+        ui->profileView->setPlainText(QString::fromStdString(script::formatScriptProfiles(script::getSharedScriptProfiler().getProfiles())));
+    }
+
+    void exportProfile()
+    {
+        const QString path{common::ui::openSaveScriptProfileDialog(q)};
+        if(path.isEmpty()) {
+            return;
+        }
+        if(!script::writeScriptProfiles(script::getSharedScriptProfiler().getProfiles(), path.toStdString())) {
+            QMessageBox::warning(q, tr("Export failed", "Title of an error dialog shown when the script profile could not be saved"),
+                                 tr("Could not save the script profile to %1", "Error message shown when the script profile could not be saved to a file").arg(path));
+        }
+    }
+
     std::map<std::string, std::string> getScripts() const
     {
         std::map<std::string, std::string> m;
@@ -155,6 +204,7 @@ private:
 
     QMetaObject::Connection m_scriptEvaluationSucceededConnection{}; ///> Connection for the scripting panel to react when a script is successfully evaluated
     QMetaObject::Connection m_scriptEvaluationFailedConnection{}; ///> Connection for the scripting panel to react when a script fails to evaluate
+    QTimer m_profileTimer; ///> Timer used to refresh the script timings while the scripts are being profiled
     std::vector<ScriptEditorWidget*> m_editors;
     std::unique_ptr<Ui::ImageTaskScriptPanel> ui;
     ImageTaskScriptingPanel* q;
@@ -3,10 +3,13 @@
 
 #include <cassert>
 #include <memory>
+#include <numeric>
+#include <vector>
 
 #include <QDateTime>
 #include <QLocale>
 #include <QEvent>
+#include <QStringList>
 
 namespace geometrize
 {
@@ -62,6 +65,34 @@ public:
         setImageDimensionsText();
     }
 
+    void setThreadUtilization(const std::vector<float>& utilization)
+    {
+        if(utilization.empty()) {
+            ui->threadUtilizationValueLabel->setText(QLocale().toString(0.0f, 'f', 0));
+            ui->threadUtilizationValueLabel->setToolTip("");
+            return;
+        }
+
+        const float average{std::accumulate(utilization.begin(), utilization.end(), 0.0f) / utilization.size()};
+        ui->threadUtilizationValueLabel->setText(QLocale().toString(average * 100.0f, 'f', 0));
+
+        QStringList perThread;
+        for(const float value : utilization) {
+            perThread.append(QLocale().toString(value * 100.0f, 'f', 0));
+        }
+        ui->threadUtilizationValueLabel->setToolTip(perThread.join(" "));
+    }
+
+    void setCandidateMemory(const geometrize::optimizer::Arena::Statistics& statistics)
+    {
+        ui->candidateMemoryValueLabel->setText(QLocale().toString(static_cast<double>(statistics.bytesReserved) / 1024.0, 'f', 0));
+        ui->candidateMemoryValueLabel->setToolTip(tr("%1 candidate shapes allocated, %2 blocks requested from the heap, %3 resets",
+                                                     "Tooltip giving how many candidate shapes were allocated, how many times more memory was requested for them, and how many times that memory was reused from the start")
+                                                  .arg(QLocale().toString(static_cast<qulonglong>(statistics.allocations)))
+                                                  .arg(QLocale().toString(static_cast<qulonglong>(statistics.blockAllocations)))
+                                                  .arg(QLocale().toString(static_cast<qulonglong>(statistics.resets))));
+    }
+
     void onLanguageChange()
     {
         ui->retranslateUi(q);
@@ -143,6 +174,16 @@ void ImageTaskStatsWidget::setImageDimensions(const std::uint32_t width, const s
     d->setImageDimensions(width, height);
 }
 
+void ImageTaskStatsWidget::setCandidateMemory(const geometrize::optimizer::Arena::Statistics& statistics)
+{
+    d->setCandidateMemory(statistics);
+}
+
+void ImageTaskStatsWidget::setThreadUtilization(const std::vector<float>& utilization)
+{
+    d->setThreadUtilization(utilization);
+}
+
 void ImageTaskStatsWidget::changeEvent(QEvent* event)
 {
     if (event->type() == QEvent::LanguageChange) {
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <QWidget>
 
+#include "optimizer/arena.h"
+
 class QEvent;
 
 namespace geometrize
@@ -34,6 +38,8 @@ public:
     void setShapeCount(std::size_t shapeCount);
     void setSimilarity(float similarity);
     void setImageDimensions(std::uint32_t width, std::uint32_t height);
+    void setThreadUtilization(const std::vector<float>& utilization);
+    void setCandidateMemory(const geometrize::optimizer::Arena::Statistics& statistics);
 
 protected:
     void changeEvent(QEvent*) override;
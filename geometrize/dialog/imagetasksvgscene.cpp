@@ -9,6 +9,7 @@
 #include "geometrize/exporter/svgexporter.h"
 
 #include "dialog/imagetaskpixmapgraphicsitem.h"
+#include "dialog/imagetaskregionsgraphicsitem.h"
 
 namespace geometrize
 {
@@ -32,10 +33,12 @@ public:
 class ImageTaskSvgScene::ImageTaskSvgSceneImpl
 {
 public:
-    ImageTaskSvgSceneImpl(ImageTaskSvgScene* pQ) : q{pQ}, m_targetPixmapItem{new ImageTaskPixmapGraphicsItem()}
+    ImageTaskSvgSceneImpl(ImageTaskSvgScene* pQ) : q{pQ}, m_targetPixmapItem{new ImageTaskPixmapGraphicsItem()}, m_regionsItem{new ImageTaskRegionsGraphicsItem()}
     {
         m_targetPixmapItem->setZValue(1);
         q->addItem(m_targetPixmapItem);
+        m_regionsItem->setZValue(2);
+        q->addItem(m_regionsItem);
     }
     ImageTaskSvgSceneImpl operator=(const ImageTaskSvgSceneImpl&) = delete;
     ImageTaskSvgSceneImpl(const ImageTaskSvgSceneImpl&) = delete;
@@ -66,9 +69,25 @@ public:
         svgItem->setZValue(0);
     }
 
+    void clearSvg()
+    {
+        for(QGraphicsItem* item : q->items()) {
+            if(item != m_targetPixmapItem && item != m_regionsItem) {
+                q->removeItem(item);
+                delete item;
+            }
+        }
+    }
+
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+    {
+        m_regionsItem->setRegions(regions);
+    }
+
 private:
     ImageTaskSvgScene* q;
     ImageTaskPixmapGraphicsItem* m_targetPixmapItem;
+    ImageTaskRegionsGraphicsItem* m_regionsItem;
 };
 
 ImageTaskSvgScene::ImageTaskSvgScene() : QGraphicsScene(), d{std::make_unique<ImageTaskSvgScene::ImageTaskSvgSceneImpl>(this)}
@@ -94,6 +113,16 @@ void ImageTaskSvgScene::drawSvg(const std::vector<geometrize::ShapeResult>& shap
     d->drawSvg(shapes, width, height);
 }
 
+void ImageTaskSvgScene::clearSvg()
+{
+    d->clearSvg();
+}
+
+void ImageTaskSvgScene::setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+{
+    d->setWeightRegions(regions);
+}
+
 }
 
 }
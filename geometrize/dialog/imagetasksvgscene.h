@@ -5,6 +5,8 @@
 
 #include <QGraphicsScene>
 
+#include "optimizer/weightmask.h"
+
 namespace geometrize
 {
 struct ShapeResult;
@@ -47,6 +49,17 @@ public:
      */
     void drawSvg(const std::vector<geometrize::ShapeResult>& shapes, const std::uint32_t width, const std::uint32_t height);
 
+    /**
+     * @brief clearSvg Removes every SVG drawn in the scene, keeping the target pixmap and region outlines.
+     */
+    void clearSvg();
+
+    /**
+     * @brief setWeightRegions Sets the weight regions outlined over the images.
+     * @param regions The weight regions, in pixels of the target image.
+     */
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions);
+
 private:
     class ImageTaskSvgSceneImpl;
     std::unique_ptr<ImageTaskSvgSceneImpl> d;
@@ -3,7 +3,9 @@
 
 #include <algorithm>
 #include <cassert>
-#include <functional>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include <QEvent>
@@ -11,6 +13,8 @@
 #include <QMessageBox>
 #include <QPixmap>
 #include <QRectF>
+#include <QSignalBlocker>
+#include <QSlider>
 #include <QTimer>
 
 #include "geometrize/bitmap/bitmap.h"
@@ -26,16 +30,20 @@
 #include "dialog/scripteditorwidget.h"
 #include "image/imageloader.h"
 #include "localization/strings.h"
+#include "optimizer/threadpool.h"
+#include "optimizer/weightmask.h"
 #include "preferences/globalpreferences.h"
+#include "preferences/imagetaskpreferences.h"
 #include "script/geometrizerengine.h"
 #include "task/imagetask.h"
+#include "task/shapelog.h"
 #include "version/versioninfo.h"
 
 namespace
 {
 
 // Utility function for destroying an image task set on a window.
-// This is a special case because we may need to defer task deletion until the task is finished working.
+// A task that is stepping is cancelled first, the destructor then only has to wait the few milliseconds it takes the step to notice.
 void destroyTask(geometrize::task::ImageTask* task)
 {
     if(task == nullptr) {
@@ -43,16 +51,8 @@ void destroyTask(geometrize::task::ImageTask* task)
         return;
     }
 
-    if(task->isStepping()) {
-        // Wait until the task finishes stepping before disposing of it
-        // Otherwise it will probably crash as the Geometrize library will be working with deleted data
-        task->connect(task, &geometrize::task::ImageTask::signal_modelDidStep, [task](std::vector<geometrize::ShapeResult>) {
-            task->deleteLater();
-        });
-    } else {
-        delete task;
-        task = nullptr;
-    }
+    task->cancelSteps();
+    delete task;
 }
 
 }
@@ -99,6 +99,14 @@ public:
         m_currentImageView->setVisible(false); // Make sure the image view is hidden by default (we prefer the SVG view)
         m_svgImageView->setVisible(true);
 
+        // Handle regions drawn over either view, both scenes share the target image's pixel coordinates
+        connect(m_currentImageView, &ImageTaskGraphicsView::regionDrawn, [this](const QRectF& sceneRect, const bool ellipse) {
+            addWeightRegion(sceneRect, ellipse);
+        });
+        connect(m_svgImageView, &ImageTaskGraphicsView::regionDrawn, [this](const QRectF& sceneRect, const bool ellipse) {
+            addWeightRegion(sceneRect, ellipse);
+        });
+
         // Handle clicks on checkable title bar items
         connect(ui->actionScript_Console, &QAction::toggled, [this](const bool checked) {
             setConsoleVisibility(checked);
@@ -120,10 +128,11 @@ public:
                 destroyTask(lastTask);
             }
 
-            m_shapes.clear();
+            m_shapes = task::ShapeLogView();
+            syncRewindSlider();
         });
         connect(q, &ImageTaskWindow::didSwitchImageTask, [this](task::ImageTask*, task::ImageTask* currentTask) {
-            ui->imageTaskExportWidget->setImageTask(currentTask, &m_shapes);
+            ui->imageTaskExportWidget->setImageTask(currentTask);
             ui->imageTaskRunnerWidget->setImageTask(currentTask);
 
             if(dialog::ImageTaskScriptingPanel* scriptingPanel = getScriptingPanel()) {
@@ -132,27 +141,48 @@ public:
 
             m_taskPreferencesSetConnection = connect(currentTask, &task::ImageTask::signal_preferencesSet, [this]() {
                 ui->imageTaskRunnerWidget->syncUserInterface();
+                updateRegionOverlays();
             });
 
             m_taskWillStepConnection = connect(currentTask, &task::ImageTask::signal_modelWillStep, [this]() {
                 ui->statsDockContents->setCurrentStatus(geometrize::dialog::ImageTaskStatsWidget::RUNNING);
             });
 
-            m_taskDidStepConnection = connect(currentTask, &task::ImageTask::signal_modelDidStep, [this](std::vector<geometrize::ShapeResult> shapes) {
-                processPostStepCbs();
-
+            // While running, the task keeps stepping on the worker and this receives whatever was added since the last update
+            m_taskDidStepConnection = connect(currentTask, &task::ImageTask::signal_modelDidStep, [this](task::ShapeLogView shapes) {
                 updateCurrentGraphics(shapes);
                 // If the first shape added background rectangle then fit the scenes to it
-                if(m_shapes.size() == 0) {
+                if(m_shapes.empty()) {
                     fitScenesInViews();
                 }
-                std::copy(shapes.begin(), shapes.end(), std::back_inserter(m_shapes));
+                // Only the published shapes, the log may already hold shapes that are not in the image shown yet
+                m_shapes = m_task->getPublishedShapes();
 
                 updateStats();
+                syncRewindSlider();
+            });
 
-                if(isRunning()) {
-                    stepModel();
-                }
+            // After rewinding, the shapes drawn so far may no longer be part of the model, so the vector view is drawn again from the remaining shapes
+            m_taskRewoundConnection = connect(currentTask, &task::ImageTask::signal_modelRewound, [this](task::ShapeLogView shapes) {
+                m_currentSvgScene.clearSvg();
+                updateCurrentGraphics(shapes);
+                m_shapes = shapes;
+
+                updateStats();
+                syncRewindSlider();
+            });
+
+            m_taskRunningChangedConnection = connect(currentTask, &task::ImageTask::signal_runningChanged, [this](bool) {
+                updateStats();
+            });
+
+            // A failing step, usually a broken script function, has already stopped the run, so only the error is left to show
+            m_taskStepFailedConnection = connect(currentTask, &task::ImageTask::signal_stepFailed, [this](const std::string& errorMessage) {
+                QMessageBox::warning(
+                            q,
+                            tr("Image task step failed", "Title of an error dialog shown when adding shapes to the image fails, usually because of an error in a custom script"),
+                            tr("Adding shapes failed, so the image task was stopped. The error was: %1",
+                               "Error message shown when adding shapes to the image fails, followed by the error text").arg(QString::fromStdString(errorMessage)));
             });
 
             q->setWindowTitle(geometrize::strings::Strings::getApplicationName()
@@ -166,12 +196,38 @@ public:
 
             ui->consoleWidget->setEngine(currentTask->getGeometrizer().getEngine());
             ui->imageTaskRunnerWidget->syncUserInterface();
+            updateRegionOverlays();
 
-            ui->imageTaskImageWidget->setTargetImage(image::createImage(currentTask->getTarget()));
+            ui->imageTaskImageWidget->setTargetImage(image::createImage(*currentTask->getTargetSnapshot()));
 
             m_timeRunning = 0.0f;
         });
 
+        // Handle requests to go back to an earlier shape. Only a drag of the handle rewinds, since removed shapes cannot be restored, so the slider
+        // is put back before asking, which also keeps it from reporting the released position as a new value
+        connect(ui->rewindSlider, &QSlider::sliderReleased, [this]() {
+            const std::size_t shapeCount{static_cast<std::size_t>(ui->rewindSlider->sliderPosition())};
+            syncRewindSlider();
+            if(!m_task || shapeCount >= m_shapes.size()) {
+                return;
+            }
+            const QMessageBox::StandardButton answer{QMessageBox::question(
+                        q,
+                        tr("Remove shapes", "Title of a dialog asking the user to confirm going back to an earlier shape, which removes the shapes after it"),
+                        tr("Go back to shape %1 and remove the %2 shapes after it? This cannot be undone.",
+                           "Question asking the user to confirm going back to an earlier shape, giving the shape number and how many shapes are removed")
+                           .arg(QLocale().toString(static_cast<qulonglong>(shapeCount)))
+                           .arg(QLocale().toString(static_cast<qulonglong>(m_shapes.size() - shapeCount))))};
+            if(answer == QMessageBox::Yes && m_task) {
+                m_task->rewindTo(shapeCount);
+            }
+        });
+
+        // Clicks on the groove and mouse wheel ticks would move the slider without rewinding, so it is put back where the shapes are
+        connect(ui->rewindSlider, &QSlider::valueChanged, [this](int) {
+            syncRewindSlider();
+        });
+
         // Handle requested target image overlay opacity changes
         connect(ui->imageTaskImageWidget, &ImageTaskImageWidget::targetImageOpacityChanged, [this](const unsigned int value) {
             const float opacity{value * (1.0f / 255.0f)};
@@ -184,9 +240,8 @@ public:
             assert(!image.isNull());
 
             // Validate the target image size
-            const geometrize::Bitmap& target{m_task->getTarget()};
-            const int targetWidth{static_cast<int>(target.getWidth())};
-            const int targetHeight{static_cast<int>(target.getHeight())};
+            const int targetWidth{static_cast<int>(m_task->getWidth())};
+            const int targetHeight{static_cast<int>(m_task->getHeight())};
             if(targetWidth != image.width() || targetHeight != image.height()) {
                 const QString selectedImageSize(tr("%1x%2", "Dimensions of an image e.g. width-x-height, 1024x800").arg(QLocale().toString(image.width())).arg(QLocale().toString(image.height())));
                 const QString targetImageSize(tr("%1x%2", "Dimensions of an image e.g. width-x-height, 1024x800").arg(QLocale().toString(targetWidth)).arg(QLocale().toString(targetHeight)));
@@ -204,38 +259,25 @@ public:
 
         // Handle a request to change the target image that has passed size checks and validation
         connect(ui->imageTaskImageWidget, &ImageTaskImageWidget::targetImageSet, [this](const QImage& image) {
-            // If the task is running then defer the target image change to the next step, else do it immediately
-            if(isRunning()) {
-                const QImage imageCopy{image.copy()};
-                addPostStepCb([this, imageCopy]() {
-                    Bitmap target = geometrize::image::createBitmap(imageCopy);
-                    switchTargetImage(target);
-                });
-            } else {
-                Bitmap target = geometrize::image::createBitmap(image);
-                switchTargetImage(target);
-            }
+            // The task aborts the step in progress and swaps the image between steps, so this is safe while it is running
+            const Bitmap target{geometrize::image::createBitmap(image)};
+            m_task->switchTarget(target);
         });
 
-        // Handle runner button presses
-        connect(ui->imageTaskRunnerWidget, &ImageTaskRunnerWidget::runStopButtonClicked, [this]() {
-            setRunning(!isRunning());
-
-            // Toggle running button text and request another image task step if running started
-            updateStartStopButtonText();
-            if(isRunning()) {
-                stepModel();
-            }
-        });
+        // Handle runner button presses, the runner widget starts and stops the task itself
         connect(ui->imageTaskRunnerWidget, &ImageTaskRunnerWidget::stepButtonClicked, [this]() {
             stepModel();
         });
         connect(ui->imageTaskRunnerWidget, &ImageTaskRunnerWidget::clearButtonClicked, [this]() {
             clearModel();
         });
+        connect(ui->imageTaskRunnerWidget, &ImageTaskRunnerWidget::regionsChanged, [this]() {
+            updateRegionOverlays();
+        });
 
         connect(q, &ImageTaskWindow::didLoadSettingsTemplate, [this]() {
             ui->imageTaskRunnerWidget->syncUserInterface();
+            updateRegionOverlays();
 
             if(dialog::ImageTaskScriptingPanel* scriptingPanel = getScriptingPanel()) {
                  scriptingPanel->syncUserInterface();
@@ -375,7 +417,6 @@ public:
 private:
     void populateUi()
     {
-        updateStartStopButtonText();
         q->setWindowTitle(geometrize::strings::Strings::getApplicationName());
     }
 
@@ -389,30 +430,29 @@ private:
         return q->findChild<geometrize::dialog::ImageTaskScriptingPanel*>();
     }
 
-    void updateStartStopButtonText()
-    {
-        if(!isRunning()) {
-            ui->imageTaskRunnerWidget->setRunStopButtonText(tr("Start", "Text on a button that the user presses to make the app start/begin transforming an image into shapes"));
-        } else {
-            ui->imageTaskRunnerWidget->setRunStopButtonText(tr("Stop", "Text on a button that the user presses to make the app stop/pause transforming an image into shapes"));
-        }
-    }
-
-    void updateCurrentGraphics(const std::vector<geometrize::ShapeResult>& shapes)
+    void updateCurrentGraphics(const task::ShapeLogView& shapes)
     {
-        const QPixmap pixmap{image::createPixmap(m_task->getCurrent())};
+        // Drawn from the copy published with the shapes, the worker keeps drawing into the current image while the task runs
+        const QPixmap pixmap{image::createPixmap(*m_task->getCurrentSnapshot())};
         m_currentImageScene.setWorkingPixmap(pixmap);
-        m_currentSvgScene.drawSvg(shapes, pixmap.size().width(), pixmap.size().height());
+        m_currentSvgScene.drawSvg(shapes.toVector(), pixmap.size().width(), pixmap.size().height());
     }
 
-    bool isRunning() const
+    void syncRewindSlider()
     {
-        return m_running; // TODO this is buggy, need to synch up whether the task is running or not in a better way
+        // Left alone while being dragged, so new shapes do not pull it away from the point the user is choosing
+        if(ui->rewindSlider->isSliderDown()) {
+            return;
+        }
+        const QSignalBlocker blocker(ui->rewindSlider);
+        const int shapeCount{static_cast<int>(m_shapes.size())};
+        ui->rewindSlider->setMaximum(shapeCount);
+        ui->rewindSlider->setValue(shapeCount);
     }
 
-    void setRunning(const bool running)
+    bool isRunning() const
     {
-        m_running = running;
+        return m_task && m_task->isRunning();
     }
 
     void stepModel()
@@ -422,21 +462,15 @@ private:
 
     void clearModel()
     {
-        auto task = new geometrize::task::ImageTask(m_task->getDisplayName(), m_task->getTarget());
+        Bitmap target{*m_task->getTargetSnapshot()};
+        auto task = new geometrize::task::ImageTask(m_task->getDisplayName(), target);
         task->setPreferences(m_task->getPreferences());
         setImageTask(task);
     }
 
-    void switchTargetImage(Bitmap& bitmap)
-    {
-        Bitmap& targetBitmap{m_task->getTarget()};
-        targetBitmap = bitmap;
-    }
-
     void switchCurrentImage(Bitmap& bitmap)
     {
-        Bitmap& currentBitmap{m_task->getCurrent()};
-        currentBitmap = bitmap;
+        m_task->switchCurrent(bitmap);
     }
 
     void updateStats()
@@ -455,6 +489,12 @@ private:
         }
 
         ui->statsDockContents->setTimeRunning(static_cast<int>(m_timeRunning / 1000.0f));
+
+        const optimizer::ThreadPool::Statistics poolStatistics{optimizer::getSharedThreadPool().getStatistics()};
+        ui->statsDockContents->setThreadUtilization(optimizer::computeUtilization(m_lastPoolStatistics, poolStatistics));
+        m_lastPoolStatistics = poolStatistics;
+
+        ui->statsDockContents->setCandidateMemory(m_task->getAllocationStatistics());
     }
 
     void disconnectTask()
@@ -468,11 +508,61 @@ private:
         if(m_taskDidStepConnection) {
             disconnect(m_taskDidStepConnection);
         }
+        if(m_taskRunningChangedConnection) {
+            disconnect(m_taskRunningChangedConnection);
+        }
+        if(m_taskRewoundConnection) {
+            disconnect(m_taskRewoundConnection);
+        }
+        if(m_taskStepFailedConnection) {
+            disconnect(m_taskStepFailedConnection);
+        }
+    }
+
+    void addWeightRegion(const QRectF& sceneRect, const bool ellipse)
+    {
+        if(!m_task) {
+            return;
+        }
+
+        // Clamp the region to the target image, ignoring regions drawn entirely outside it
+        const QRectF imageRect(0, 0, m_task->getWidth(), m_task->getHeight());
+        const QRectF rect{sceneRect.intersected(imageRect)};
+        if(rect.isEmpty()) {
+            return;
+        }
+
+        geometrize::optimizer::WeightRegion region;
+        region.shape = ellipse ? geometrize::optimizer::WeightRegion::Shape::ELLIPSE : geometrize::optimizer::WeightRegion::Shape::RECTANGLE;
+        region.x1 = static_cast<std::int32_t>(std::floor(rect.left()));
+        region.y1 = static_cast<std::int32_t>(std::floor(rect.top()));
+        region.x2 = std::max(region.x1, static_cast<std::int32_t>(std::ceil(rect.right())) - 1);
+        region.y2 = std::max(region.y1, static_cast<std::int32_t>(std::ceil(rect.bottom())) - 1);
+        region.weight = ui->imageTaskRunnerWidget->getRegionWeight();
+
+        // Drawing a region implies the user wants the search restricted to it
+        geometrize::preferences::ImageTaskPreferences& prefs{m_task->getPreferences()};
+        prefs.addWeightRegion(region);
+        prefs.setRegionOfInterestEnabled(true);
+
+        ui->imageTaskRunnerWidget->syncUserInterface();
+        updateRegionOverlays();
+    }
+
+    // Regions are only outlined while they are in use, so the checkbox shows and hides them
+    void updateRegionOverlays()
+    {
+        std::vector<geometrize::optimizer::WeightRegion> regions;
+        if(m_task && m_task->getPreferences().isRegionOfInterestEnabled()) {
+            regions = m_task->getPreferences().getWeightRegions();
+        }
+        m_currentImageScene.setWeightRegions(regions);
+        m_currentSvgScene.setWeightRegions(regions);
     }
 
     void setupOverlayImages()
     {
-        const QPixmap target{image::createPixmap(m_task->getTarget())};
+        const QPixmap target{image::createPixmap(*m_task->getTargetSnapshot())};
         m_currentImageScene.setTargetPixmap(target);
         m_currentSvgScene.setTargetPixmap(target);
     }
@@ -502,24 +592,6 @@ private:
         ui->imageTaskImageWidget->setTargetImage(image);
     }
 
-    void addPostStepCb(const std::function<void()>& f)
-    {
-        m_onPostStepCbs.push_back(f);
-    }
-
-    void clearPostStepCbs()
-    {
-        m_onPostStepCbs.clear();
-    }
-
-    void processPostStepCbs()
-    {
-        for(const auto& f : m_onPostStepCbs) {
-            f();
-        }
-        clearPostStepCbs();
-    }
-
     std::unique_ptr<Ui::ImageTaskWindow> ui{nullptr};
 
     ImageTaskWindow* q{nullptr};
@@ -528,9 +600,11 @@ private:
     QMetaObject::Connection m_taskPreferencesSetConnection{}; ///> Connection for telling the dialog when the image task preferences are set
     QMetaObject::Connection m_taskWillStepConnection{}; ///> Connection for the window to do work just prior the image task starts a step
     QMetaObject::Connection m_taskDidStepConnection{}; ///> Connection for the window to do work just after the image task finishes a step
-    std::vector<std::function<void()>> m_onPostStepCbs; ///> One-shot callbacks triggered when the image task finishes a step
+    QMetaObject::Connection m_taskRunningChangedConnection{}; ///> Connection for the window to update when the image task starts or stops running
+    QMetaObject::Connection m_taskStepFailedConnection{}; ///> Connection for the window to show the error when an image task step fails
+    QMetaObject::Connection m_taskRewoundConnection{}; ///> Connection for the window to redraw when the image task goes back to an earlier shape
 
-    std::vector<geometrize::ShapeResult> m_shapes; ///> The shapes and score results created by the image task
+    task::ShapeLogView m_shapes; ///> The shapes and score results created by the image task, shared with the task's shape log
 
     ImageTaskPixmapScene m_currentImageScene; ///> The scene containing the raster/pixel-based representation of the shapes
     ImageTaskSvgScene m_currentSvgScene; ///> The scene containing the vector-based representation of the shapes
@@ -538,10 +612,10 @@ private:
     geometrize::dialog::ImageTaskGraphicsView* m_currentImageView{nullptr}; ///> The view that holds the raster/pixel-based scene
     geometrize::dialog::ImageTaskGraphicsView* m_svgImageView{nullptr}; ///> The view that holds the vector-based scene
 
-    bool m_running{false}; ///> Whether the model is running (automatically)
     QTimer m_timeRunningTimer; ///> Timer used to keep track of how long the image task has been in the "running" state
     float m_timeRunning{0.0f}; ///> Total time that the image task has been in the "running" state
     const float m_timeRunningResolutionMs{100.0f}; ///> Resolution of the time running timer
+    optimizer::ThreadPool::Statistics m_lastPoolStatistics{optimizer::getSharedThreadPool().getStatistics()}; ///> Snapshot of the shared thread pool statistics, used to measure thread utilization between stats updates
 };
 
 ImageTaskWindow::ImageTaskWindow() :
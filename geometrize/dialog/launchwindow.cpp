@@ -175,10 +175,10 @@ private:
             m_logoTask->getPreferences().setShapeTypes(geometrize::ShapeTypes::RECTANGLE);
             m_logoTask->getPreferences().setShapeAlpha(255U);
 
-            ui->logoLabel->setPixmap(image::createPixmap(m_logoTask->getCurrent()));
+            ui->logoLabel->setPixmap(image::createPixmap(*m_logoTask->getCurrentSnapshot()));
 
-            connect(m_logoTask.get(), &task::ImageTask::signal_modelDidStep, [this](std::vector<geometrize::ShapeResult> /*results*/) {
-                const QPixmap pixmap{image::createPixmap(m_logoTask->getCurrent())};
+            connect(m_logoTask.get(), &task::ImageTask::signal_modelDidStep, [this](task::ShapeLogView /*results*/) {
+                const QPixmap pixmap{image::createPixmap(*m_logoTask->getCurrentSnapshot())};
                 ui->logoLabel->setPixmap(pixmap);
 
                 updateLogoTaskProgress();
@@ -7,6 +7,7 @@
 
 #include "logger/logger.h"
 #include "logger/logmessageevents.h"
+#include "script/scriptprofiler.h"
 #include "script/scriptrunner.h"
 #include "script/scriptutil.h"
 
@@ -49,6 +50,9 @@ public:
                     }
                 } else if(command == "clear") {
                     ui->outputView->clear();
+                } else if(command == "profile") {
+                    // Script profiling is opt-in, see setScriptProfilingEnabled
+                    append(QString::fromStdString(script::formatScriptProfiles(script::getSharedScriptProfiler().getProfiles())));
                 } else {
                     script::runScript(command, *m_engine);
                 }
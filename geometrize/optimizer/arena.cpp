@@ -0,0 +1,70 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+Arena::Arena(const std::size_t blockSize) : m_blockSize{std::max<std::size_t>(blockSize, 1U)}, m_currentBlock{0}, m_offset{0}, m_live{0}
+{
+}
+
+void* Arena::allocate(const std::size_t size, const std::size_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    // Try the current block, then any later blocks left over from before the last reset, then request a new block
+    while(m_currentBlock < m_blocks.size()) {
+        Block& block{m_blocks[m_currentBlock]};
+        const std::uintptr_t base{reinterpret_cast<std::uintptr_t>(block.data.get())};
+        const std::size_t start{static_cast<std::size_t>(((base + m_offset + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1)) - base)};
+        if(start + size <= block.size) {
+            m_offset = start + size;
+            m_live++;
+            m_statistics.allocations++;
+            return block.data.get() + start;
+        }
+        m_currentBlock++;
+        m_offset = 0;
+    }
+
+    Block block;
+    block.size = std::max(m_blockSize, size + alignment);
+    block.data = std::make_unique<unsigned char[]>(block.size);
+    m_statistics.blockAllocations++;
+    m_statistics.bytesReserved += block.size;
+    m_blocks.push_back(std::move(block));
+    m_currentBlock = m_blocks.size() - 1;
+    m_offset = 0;
+    return allocate(size, alignment);
+}
+
+void Arena::deallocate(void*)
+{
+    assert(m_live > 0);
+    m_live--;
+}
+
+void Arena::reset()
+{
+    assert(m_live == 0 && "Arena reset while objects allocated from it are still alive");
+    m_currentBlock = 0;
+    m_offset = 0;
+    m_statistics.resets++;
+}
+
+Arena::Statistics Arena::getStatistics() const
+{
+    return m_statistics;
+}
+
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The Arena class hands out memory from a few large blocks, so that short-lived objects can be created without going to the heap.
+ * Freeing memory is a no-op: everything is released at once by reset, and the blocks are kept for reuse.
+ * An arena is not thread-safe, give each thread its own.
+ */
+class Arena
+{
+public:
+    /**
+     * @brief The Statistics struct counts the work an arena has done since it was created.
+     */
+    struct Statistics
+    {
+        std::uint64_t allocations{0}; ///< The number of allocations served from the arena.
+        std::uint64_t blockAllocations{0}; ///< The number of blocks the arena had to request from the heap.
+        std::uint64_t resets{0}; ///< The number of times the arena has been reset.
+        std::size_t bytesReserved{0}; ///< The total size of the blocks currently held by the arena.
+    };
+
+    static const std::size_t DEFAULT_BLOCK_SIZE{64 * 1024}; ///< The size of the blocks requested from the heap, unless a single allocation needs more.
+
+    /**
+     * @brief Arena Creates a new arena. No memory is reserved until the first allocation.
+     * @param blockSize The size of the blocks to request from the heap.
+     */
+    explicit Arena(std::size_t blockSize = DEFAULT_BLOCK_SIZE);
+    Arena& operator=(const Arena&) = delete;
+    Arena(const Arena&) = delete;
+    ~Arena() = default;
+
+    /**
+     * @brief allocate Reserves memory from the arena.
+     * @param size The number of bytes to reserve.
+     * @param alignment The alignment of the memory, a power of two.
+     * @return A pointer to the memory. It stays valid until the arena is reset or destroyed.
+     */
+    void* allocate(std::size_t size, std::size_t alignment);
+
+    /**
+     * @brief deallocate Returns memory to the arena. The memory is not reused until the arena is reset.
+     * @param p The memory to return.
+     */
+    void deallocate(void* p);
+
+    /**
+     * @brief reset Makes all of the memory of the arena available again. Every object allocated from the arena must have been destroyed.
+     */
+    void reset();
+
+    /**
+     * @brief getStatistics Gets the allocation counters of the arena.
+     * @return The allocation counters.
+     */
+    Statistics getStatistics() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        std::size_t size;
+    };
+
+    const std::size_t m_blockSize; ///> The size of the blocks requested from the heap
+    std::vector<Block> m_blocks; ///> The blocks held by the arena, in the order they are filled
+    std::size_t m_currentBlock; ///> The index of the block that allocations are currently served from
+    std::size_t m_offset; ///> The number of bytes used in the current block
+    std::size_t m_live; ///> The number of allocations that have not been returned, used to catch resets while objects are alive
+    Statistics m_statistics; ///> The allocation counters
+};
+
+/**
+ * @brief The ArenaAllocator class is a standard allocator that takes its memory from an Arena, e.g. for use with std::allocate_shared.
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : m_arena{&arena}
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena{other.getArena()}
+    {
+    }
+
+    T* allocate(const std::size_t count)
+    {
+        return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t)
+    {
+        m_arena->deallocate(p);
+    }
+
+    Arena* getArena() const
+    {
+        return m_arena;
+    }
+
+private:
+    Arena* m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.getArena() == b.getArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return !(a == b);
+}
+
+}
+
+}
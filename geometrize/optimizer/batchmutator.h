@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "geometrize/shape/shapetypes.h"
+
+namespace geometrize
+{
+class Shape;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The BatchMutator class mutates many candidate shapes of one type in a single call.
+ * Mutation functions with a high fixed cost per call, such as scripted ones, use it to spread that cost over a whole batch of candidates.
+ * The stepper calls it from many threads at once, so implementations must be safe to call concurrently.
+ */
+class BatchMutator
+{
+public:
+    virtual ~BatchMutator() = default;
+
+    /**
+     * @brief canMutate Checks whether shapes of the given type can be mutated in batches.
+     * @param type The shape type.
+     * @return True if batches of shapes of the type can be mutated, false if each shape must mutate itself.
+     */
+    virtual bool canMutate(geometrize::ShapeTypes type) const = 0;
+
+    /**
+     * @brief mutate Mutates each of the shapes once, as if each had been mutated by itself.
+     * @param shapes The shapes to mutate, all of the same type, for which canMutate returned true.
+     */
+    virtual void mutate(std::vector<std::shared_ptr<geometrize::Shape>>& shapes) = 0;
+};
+
+}
+
+}
@@ -0,0 +1,41 @@
+#include "cancellation.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+CancellationToken::CancellationToken() : m_generation{nullptr}, m_expected{0}
+{
+}
+
+CancellationToken::CancellationToken(const std::atomic<std::uint64_t>* generation, const std::uint64_t expected) : m_generation{generation}, m_expected{expected}
+{
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return m_generation != nullptr && m_generation->load(std::memory_order_relaxed) != m_expected;
+}
+
+CancellationSource::CancellationSource() : m_generation{0}
+{
+}
+
+CancellationToken CancellationSource::getToken() const
+{
+    return CancellationToken(&m_generation, m_generation.load());
+}
+
+void CancellationSource::cancel()
+{
+    m_generation++;
+}
+
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+class CancellationSource;
+
+/**
+ * @brief The CancellationToken class lets long-running work check whether it has been asked to stop.
+ * A token is cancelled once its source is cancelled after the token was taken from it. Tokens taken later are unaffected.
+ * Default-constructed tokens are never cancelled. Checking a token is a single relaxed atomic load, cheap enough for inner loops.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    /**
+     * @brief isCancelled Returns true if the work this token was handed out for should stop.
+     * @return True if the token has been cancelled, else false.
+     */
+    bool isCancelled() const;
+
+private:
+    friend class CancellationSource;
+    CancellationToken(const std::atomic<std::uint64_t>* generation, std::uint64_t expected);
+
+    const std::atomic<std::uint64_t>* m_generation; ///> The generation counter of the source, null for tokens that are never cancelled
+    std::uint64_t m_expected; ///> The generation of the source when the token was taken
+};
+
+/**
+ * @brief The CancellationSource class hands out cancellation tokens and cancels all of the tokens handed out so far at once.
+ * Both getToken and cancel may be called from any thread. The source must outlive its tokens.
+ */
+class CancellationSource
+{
+public:
+    CancellationSource();
+    CancellationSource& operator=(const CancellationSource&) = delete;
+    CancellationSource(const CancellationSource&) = delete;
+    ~CancellationSource() = default;
+
+    /**
+     * @brief getToken Gets a token that is cancelled by the next call to cancel.
+     * @return The token.
+     */
+    CancellationToken getToken() const;
+
+    /**
+     * @brief cancel Cancels every token handed out so far.
+     */
+    void cancel();
+
+private:
+    std::atomic<std::uint64_t> m_generation; ///> Incremented by every cancellation
+};
+
+}
+
+}
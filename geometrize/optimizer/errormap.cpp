@@ -0,0 +1,139 @@
+#include "errormap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/rasterizer/scanline.h"
+
+#include "optimizer/kernels.h"
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+ErrorMap::ErrorMap() : m_width{0}, m_height{0}, m_tileColumns{0}, m_tileRows{0}, m_valid{false}, m_total{0}
+{
+}
+
+void ErrorMap::reset(const geometrize::Bitmap& target, const geometrize::Bitmap& current)
+{
+    assert(target.getWidth() == current.getWidth() && target.getHeight() == current.getHeight());
+
+    m_width = target.getWidth();
+    m_height = target.getHeight();
+    m_tileColumns = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileRows = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    m_total = 0;
+    m_rows.assign(m_height, 0);
+    m_tiles.assign(static_cast<std::size_t>(m_tileColumns) * m_tileRows, 0);
+    m_valid = true;
+
+    if(m_width == 0) {
+        return;
+    }
+
+    std::vector<geometrize::Scanline> rows;
+    for(std::uint32_t y = 0; y < m_height; y++) {
+        rows.emplace_back(static_cast<std::int32_t>(y), 0, static_cast<std::int32_t>(m_width) - 1);
+    }
+    addLines(target, current, rows);
+}
+
+bool ErrorMap::isValid() const
+{
+    return m_valid;
+}
+
+void ErrorMap::invalidate()
+{
+    m_valid = false;
+}
+
+void ErrorMap::removeLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines)
+{
+    updateLines(target, current, lines, [](std::uint64_t& value, const std::uint64_t error) { value -= error; });
+}
+
+void ErrorMap::addLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines)
+{
+    updateLines(target, current, lines, [](std::uint64_t& value, const std::uint64_t error) { value += error; });
+}
+
+template<typename Op>
+void ErrorMap::updateLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines, Op op)
+{
+    assert(m_valid && "Error map must be reset before it can be updated");
+
+    const std::uint8_t* targetData{target.getDataRef().data()};
+    const std::uint8_t* currentData{current.getDataRef().data()};
+
+    for(const geometrize::Scanline& line : lines) {
+        const std::uint32_t y{static_cast<std::uint32_t>(line.y)};
+        const std::uint32_t tileY{y / TILE_SIZE};
+
+        // Split the scanline at tile boundaries so each tile gets its own share of the error
+        std::uint32_t x{static_cast<std::uint32_t>(line.x1)};
+        const std::uint32_t x2{static_cast<std::uint32_t>(line.x2)};
+        while(x <= x2) {
+            const std::uint32_t tileX{x / TILE_SIZE};
+            const std::uint32_t end{std::min(x2, (tileX + 1) * TILE_SIZE - 1)};
+            const std::size_t offset{(static_cast<std::size_t>(y) * m_width + x) * 4U};
+            const std::uint64_t error{sumSquaredDifferences(targetData + offset, currentData + offset, (end - x + 1) * 4U)};
+
+            op(m_tiles[static_cast<std::size_t>(tileY) * m_tileColumns + tileX], error);
+            op(m_rows[y], error);
+            op(m_total, error);
+
+            x = end + 1;
+        }
+    }
+}
+
+std::uint64_t ErrorMap::getTotalError() const
+{
+    return m_total;
+}
+
+float ErrorMap::getScore() const
+{
+    return scoreFromError(m_total, m_width, m_height);
+}
+
+std::uint64_t ErrorMap::getRowError(const std::uint32_t y) const
+{
+    return m_rows[y];
+}
+
+std::uint64_t ErrorMap::getTileError(const std::uint32_t tileX, const std::uint32_t tileY) const
+{
+    return m_tiles[static_cast<std::size_t>(tileY) * m_tileColumns + tileX];
+}
+
+std::uint32_t ErrorMap::getTileColumns() const
+{
+    return m_tileColumns;
+}
+
+std::uint32_t ErrorMap::getTileRows() const
+{
+    return m_tileRows;
+}
+
+std::uint32_t ErrorMap::getWidth() const
+{
+    return m_width;
+}
+
+std::uint32_t ErrorMap::getHeight() const
+{
+    return m_height;
+}
+
+}
+
+}
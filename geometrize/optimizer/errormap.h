@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/rasterizer/scanline.h"
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The ErrorMap class keeps a running total of the squared error between a target and a current image, broken down per row and per tile.
+ * It is built with one full pass over the images, and afterwards only needs to visit the pixels that change when shapes are drawn.
+ */
+class ErrorMap
+{
+public:
+    static const std::uint32_t TILE_SIZE{32}; ///< The width and height of the tiles, in pixels.
+
+    ErrorMap();
+    ErrorMap& operator=(const ErrorMap&) = default;
+    ErrorMap(const ErrorMap&) = default;
+    ~ErrorMap() = default;
+
+    /**
+     * @brief reset Recalculates the error map from scratch.
+     * @param target The target image.
+     * @param current The current image.
+     */
+    void reset(const geometrize::Bitmap& target, const geometrize::Bitmap& current);
+
+    /**
+     * @brief isValid Returns true if the error map has been calculated for a pair of images.
+     * @return True if the error map is valid, else false.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief invalidate Marks the error map as out of date, e.g. after the target or current images are replaced wholesale.
+     */
+    void invalidate();
+
+    /**
+     * @brief removeLines Subtracts the error of the pixels covered by the scanlines. Call this immediately before drawing to the current image.
+     * @param target The target image.
+     * @param current The current image, before the scanlines are drawn.
+     * @param lines The scanlines that are about to be drawn.
+     */
+    void removeLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines);
+
+    /**
+     * @brief addLines Adds the error of the pixels covered by the scanlines. Call this immediately after drawing to the current image.
+     * @param target The target image.
+     * @param current The current image, after the scanlines are drawn.
+     * @param lines The scanlines that were drawn.
+     */
+    void addLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines);
+
+    /**
+     * @brief getTotalError Gets the sum of the squared differences of every channel of every pixel.
+     * @return The total squared error.
+     */
+    std::uint64_t getTotalError() const;
+
+    /**
+     * @brief getScore Gets the normalized root-mean-square difference between the images.
+     * @return The normalized difference between the images, in the range [0, 1].
+     */
+    float getScore() const;
+
+    /**
+     * @brief getRowError Gets the squared error of a row of pixels.
+     * @param y The row.
+     * @return The squared error of the row.
+     */
+    std::uint64_t getRowError(std::uint32_t y) const;
+
+    /**
+     * @brief getTileError Gets the squared error of a tile.
+     * @param tileX The column of the tile.
+     * @param tileY The row of the tile.
+     * @return The squared error of the tile.
+     */
+    std::uint64_t getTileError(std::uint32_t tileX, std::uint32_t tileY) const;
+
+    /**
+     * @brief getTileColumns Gets the number of columns of tiles.
+     * @return The number of columns of tiles.
+     */
+    std::uint32_t getTileColumns() const;
+
+    /**
+     * @brief getTileRows Gets the number of rows of tiles.
+     * @return The number of rows of tiles.
+     */
+    std::uint32_t getTileRows() const;
+
+    /**
+     * @brief getWidth Gets the width of the images the error map was calculated for.
+     * @return The width of the images.
+     */
+    std::uint32_t getWidth() const;
+
+    /**
+     * @brief getHeight Gets the height of the images the error map was calculated for.
+     * @return The height of the images.
+     */
+    std::uint32_t getHeight() const;
+
+private:
+    template<typename Op>
+    void updateLines(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines, Op op);
+
+    std::uint32_t m_width; ///> Width of the images
+    std::uint32_t m_height; ///> Height of the images
+    std::uint32_t m_tileColumns; ///> Number of columns of tiles
+    std::uint32_t m_tileRows; ///> Number of rows of tiles
+    bool m_valid; ///> Whether the error map has been calculated
+    std::uint64_t m_total; ///> Sum of the squared error of every channel of every pixel
+    std::vector<std::uint64_t> m_rows; ///> Squared error per row of pixels
+    std::vector<std::uint64_t> m_tiles; ///> Squared error per tile, in row-major order
+};
+
+}
+
+}
@@ -0,0 +1,113 @@
+#include "errorsampler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/commonutil.h"
+
+#include "optimizer/errormap.h"
+
+namespace
+{
+
+const std::uint32_t randomBits{30}; // The number of bits taken from each draw of the random generator, which yields 31-bit values at most
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+ErrorSampler::ErrorSampler() : m_width{0}, m_height{0}, m_factor{1}, m_offsetX{0}, m_offsetY{0}, m_valid{false}
+{
+}
+
+void ErrorSampler::reset(const ErrorMap& errors, const std::uint32_t width, const std::uint32_t height, const std::uint32_t factor, const std::uint32_t offsetX, const std::uint32_t offsetY)
+{
+    m_width = width;
+    m_height = height;
+    m_factor = std::max(1U, factor);
+    m_offsetX = offsetX;
+    m_offsetY = offsetY;
+    m_cells.clear();
+    m_cumulativeErrors.clear();
+    m_valid = true;
+
+    // The part of the full size image that the image covers, exclusive of the right and bottom edges
+    const std::uint32_t left{offsetX};
+    const std::uint32_t top{offsetY};
+    const std::uint32_t right{std::min(offsetX + width * m_factor, errors.getWidth())};
+    const std::uint32_t bottom{std::min(offsetY + height * m_factor, errors.getHeight())};
+    if(left >= right || top >= bottom) {
+        return;
+    }
+
+    // Tiles that straddle the edge of the image only count the share of their error that lies within it
+    const std::uint32_t tileSize{ErrorMap::TILE_SIZE};
+    std::uint64_t total{0};
+    for(std::uint32_t tileY = top / tileSize; tileY <= (bottom - 1) / tileSize; tileY++) {
+        const std::uint32_t tileTop{tileY * tileSize};
+        const std::uint32_t tileBottom{std::min(tileTop + tileSize, errors.getHeight())};
+        const std::uint32_t y1{std::max(tileTop, top)};
+        const std::uint32_t y2{std::min(tileBottom, bottom)};
+        for(std::uint32_t tileX = left / tileSize; tileX <= (right - 1) / tileSize; tileX++) {
+            const std::uint32_t tileLeft{tileX * tileSize};
+            const std::uint32_t tileRight{std::min(tileLeft + tileSize, errors.getWidth())};
+            const std::uint32_t x1{std::max(tileLeft, left)};
+            const std::uint32_t x2{std::min(tileRight, right)};
+
+            const std::uint64_t tileArea{static_cast<std::uint64_t>(tileRight - tileLeft) * (tileBottom - tileTop)};
+            const std::uint64_t area{static_cast<std::uint64_t>(x2 - x1) * (y2 - y1)};
+            const std::uint64_t error{errors.getTileError(tileX, tileY) * area / tileArea};
+            if(error == 0) {
+                continue;
+            }
+            total += error;
+            m_cells.push_back(Cell{static_cast<std::int32_t>(x1), static_cast<std::int32_t>(y1), static_cast<std::int32_t>(x2) - 1, static_cast<std::int32_t>(y2) - 1});
+            m_cumulativeErrors.push_back(total);
+        }
+    }
+}
+
+bool ErrorSampler::isValid() const
+{
+    return m_valid;
+}
+
+void ErrorSampler::invalidate()
+{
+    m_valid = false;
+}
+
+bool ErrorSampler::randomPoint(std::int32_t& x, std::int32_t& y) const
+{
+    if(m_cumulativeErrors.empty()) {
+        return false;
+    }
+
+    // Two draws make a fraction fine enough to tell apart every cell, however large the total error gets
+    const std::int32_t maxDraw{(1 << randomBits) - 1};
+    const std::uint64_t high{static_cast<std::uint64_t>(geometrize::commonutil::randomRange(0, maxDraw))};
+    const std::uint64_t low{static_cast<std::uint64_t>(geometrize::commonutil::randomRange(0, maxDraw))};
+    const long double fraction{static_cast<long double>((high << randomBits) | low) / static_cast<long double>(1ULL << (randomBits * 2))};
+    const std::uint64_t total{m_cumulativeErrors.back()};
+    const std::uint64_t target{std::min(total - 1, static_cast<std::uint64_t>(fraction * static_cast<long double>(total)))};
+
+    // The cell is the first one whose running total passes the target
+    const auto cell = std::upper_bound(m_cumulativeErrors.begin(), m_cumulativeErrors.end(), target);
+    const Cell& picked{m_cells[static_cast<std::size_t>(cell - m_cumulativeErrors.begin())]};
+    const std::uint32_t px{static_cast<std::uint32_t>(geometrize::commonutil::randomRange(picked.x1, picked.x2))};
+    const std::uint32_t py{static_cast<std::uint32_t>(geometrize::commonutil::randomRange(picked.y1, picked.y2))};
+
+    x = static_cast<std::int32_t>(std::min((px - m_offsetX) / m_factor, m_width - 1));
+    y = static_cast<std::int32_t>(std::min((py - m_offsetY) / m_factor, m_height - 1));
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+class ErrorMap;
+}
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The ErrorSampler class picks pixels at random in proportion to the error that remains around them, so candidate shapes go where they are most needed.
+ * It is built from the per-tile totals of an error map, so rebuilding it costs one visit per error map tile rather than one per pixel.
+ * Within a tile every pixel is equally likely, the tiles being small enough that this is close to sampling by the error of each pixel.
+ */
+class ErrorSampler
+{
+public:
+    ErrorSampler();
+    ErrorSampler& operator=(const ErrorSampler&) = default;
+    ErrorSampler(const ErrorSampler&) = default;
+    ~ErrorSampler() = default;
+
+    /**
+     * @brief reset Rebuilds the sampler from an error map, for an image that may be a shrunk or cropped copy of the full size image.
+     * Points are mapped to the image by subtracting the offset and then dividing by the factor.
+     * @param errors The error map of the full size images.
+     * @param width The width of the image.
+     * @param height The height of the image.
+     * @param factor The factor the image was shrunk by, one for full size images.
+     * @param offsetX The left edge of the image within the full size image.
+     * @param offsetY The top edge of the image within the full size image.
+     */
+    void reset(const ErrorMap& errors, std::uint32_t width, std::uint32_t height, std::uint32_t factor = 1, std::uint32_t offsetX = 0, std::uint32_t offsetY = 0);
+
+    /**
+     * @brief isValid Returns true if the sampler has been built. A sampler that is not valid places nothing.
+     * @return True if the sampler has been built, else false.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief invalidate Marks the sampler as out of date, e.g. after shapes are drawn.
+     */
+    void invalidate();
+
+    /**
+     * @brief randomPoint Picks a pixel at random, in proportion to the error of the error map tile it lies in, using the random generator of the calling thread.
+     * @param x The column of the pixel, in the image the sampler was built for.
+     * @param y The row of the pixel, in the image the sampler was built for.
+     * @return True if a pixel was picked, false if no error remains.
+     */
+    bool randomPoint(std::int32_t& x, std::int32_t& y) const;
+
+private:
+    struct Cell
+    {
+        std::int32_t x1; ///> The first column of the part of the error map tile that lies within the image, in full size image coordinates
+        std::int32_t y1; ///> The first row of the part of the tile that lies within the image
+        std::int32_t x2; ///> The last column, inclusive
+        std::int32_t y2; ///> The last row, inclusive
+    };
+
+    std::uint32_t m_width; ///> The width of the image the sampler was built for
+    std::uint32_t m_height; ///> The height of the image the sampler was built for
+    std::uint32_t m_factor; ///> The factor the image was shrunk by
+    std::uint32_t m_offsetX; ///> The left edge of the image within the full size image
+    std::uint32_t m_offsetY; ///> The top edge of the image within the full size image
+    bool m_valid; ///> Whether the sampler has been built
+    std::vector<Cell> m_cells; ///> The error map tiles with error remaining, clipped to the image
+    std::vector<std::uint64_t> m_cumulativeErrors; ///> The total error of each cell and every cell before it
+};
+
+}
+
+}
@@ -0,0 +1,247 @@
+#include "integralimages.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+IntegralImages::IntegralImages() : m_width{0U}, m_height{0U}, m_valid{false}
+{
+}
+
+void IntegralImages::reset(const geometrize::Bitmap& target, const geometrize::Bitmap& current)
+{
+    assert(target.getWidth() == current.getWidth() && target.getHeight() == current.getHeight());
+
+    const std::uint64_t pixelCount{static_cast<std::uint64_t>(target.getWidth()) * target.getHeight()};
+    if(pixelCount == 0 || pixelCount > MAX_PIXELS) {
+        invalidate();
+        return;
+    }
+
+    m_width = target.getWidth();
+    m_height = target.getHeight();
+
+    // The tables have an extra leading row and column of zeros, so sums over rectangles touching the top or left edges need no special cases
+    const std::size_t entries{static_cast<std::size_t>(m_width + 1) * (m_height + 1)};
+    m_targetSums.assign(entries * 4U, 0U);
+    m_currentSums.assign(entries * 4U, 0U);
+    m_currentSquares.assign(entries, 0U);
+    m_products.assign(entries, 0U);
+
+    const std::size_t stride{m_width + 1U};
+    const std::uint8_t* t{target.getDataRef().data()};
+    for(std::uint32_t y = 0; y < m_height; y++) {
+        std::uint32_t row[4]{0, 0, 0, 0};
+        for(std::uint32_t x = 0; x < m_width; x++, t += 4) {
+            const std::size_t above{(y * stride + x + 1) * 4U};
+            const std::size_t here{((y + 1) * stride + x + 1) * 4U};
+            for(std::uint32_t c = 0; c < 4; c++) {
+                row[c] += t[c];
+                m_targetSums[here + c] = m_targetSums[above + c] + row[c];
+            }
+        }
+    }
+
+    updateCurrent(target, current, 0, 0, m_height - 1);
+    m_valid = true;
+}
+
+bool IntegralImages::isValid() const
+{
+    return m_valid;
+}
+
+void IntegralImages::invalidate()
+{
+    m_valid = false;
+    m_width = 0;
+    m_height = 0;
+    std::vector<std::uint32_t>().swap(m_targetSums);
+    std::vector<std::uint32_t>().swap(m_currentSums);
+    std::vector<std::uint64_t>().swap(m_currentSquares);
+    std::vector<std::uint64_t>().swap(m_products);
+}
+
+void IntegralImages::update(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::int32_t x1, const std::int32_t y1, const std::int32_t x2, const std::int32_t y2)
+{
+    if(!m_valid) {
+        return;
+    }
+    assert(current.getWidth() == m_width && current.getHeight() == m_height);
+
+    const std::int32_t w{static_cast<std::int32_t>(m_width)};
+    const std::int32_t h{static_cast<std::int32_t>(m_height)};
+    const std::int32_t left{std::max(x1, 0)};
+    const std::int32_t top{std::max(y1, 0)};
+    const std::int32_t right{std::min(x2, w - 1)};
+    const std::int32_t bottom{std::min(y2, h - 1)};
+    if(left > right || top > bottom) {
+        return;
+    }
+    updateCurrent(target, current, static_cast<std::uint32_t>(left), static_cast<std::uint32_t>(top), static_cast<std::uint32_t>(bottom));
+}
+
+geometrize::rgba IntegralImages::computeColor(const std::int32_t x1, const std::int32_t y1, const std::int32_t x2, const std::int32_t y2, const std::uint8_t alpha) const
+{
+    assert(m_valid);
+
+    const std::int64_t count{static_cast<std::int64_t>(x2 - x1 + 1) * (y2 - y1 + 1)};
+    if(count <= 0 || alpha == 0) {
+        return geometrize::rgba{0, 0, 0, 0};
+    }
+
+    // Same arithmetic as optimizer::computeColor, on sums read from the tables instead of from the pixels
+    const Sums sums{getSums(x1, y1, x2, y2)};
+    const std::int64_t a{257 * 255 / alpha};
+    const auto channel = [a, count](const std::uint64_t t, const std::uint64_t c) -> std::uint8_t {
+        const std::int64_t total{a * static_cast<std::int64_t>(t) + (257 - a) * static_cast<std::int64_t>(c)};
+        return static_cast<std::uint8_t>(std::min<std::int64_t>(std::max<std::int64_t>((total / count) >> 8, 0), 255));
+    };
+
+    return geometrize::rgba{channel(sums.target[0], sums.current[0]), channel(sums.target[1], sums.current[1]), channel(sums.target[2], sums.current[2]), alpha};
+}
+
+std::int64_t IntegralImages::energyDelta(const std::int32_t x1, const std::int32_t y1, const std::int32_t x2, const std::int32_t y2, const std::uint8_t alpha) const
+{
+    assert(m_valid);
+
+    const std::int64_t count{static_cast<std::int64_t>(x2 - x1 + 1) * (y2 - y1 + 1)};
+    if(count <= 0 || alpha == 0) {
+        return 0;
+    }
+
+    const geometrize::rgba color{computeColor(x1, y1, x2, y2, alpha)};
+    const Sums sums{getSums(x1, y1, x2, y2)};
+
+    // optimizer::drawLines maps every channel value p to roughly k * p + s, with the same k for all channels and s depending on the color
+    // The truncating divisions it does lose half a level on average, which is folded into s
+    const double m{65535.0};
+    const double sa{static_cast<double>(color.a | (color.a << 8))};
+    const double k{(m - sa) * 257.0 / (m * 256.0)};
+    const double premultiplied[4]{
+        static_cast<double>(((color.r | (color.r << 8)) * color.a) / 255),
+        static_cast<double>(((color.g | (color.g << 8)) * color.a) / 255),
+        static_cast<double>(((color.b | (color.b << 8)) * color.a) / 255),
+        sa
+    };
+
+    // Expanding the sum over the rectangle of (t - (k * p + s))^2 - (t - p)^2 leaves only sums the tables hold
+    const double n{static_cast<double>(count)};
+    double delta{(k * k - 1.0) * static_cast<double>(sums.currentSquares) - 2.0 * (k - 1.0) * static_cast<double>(sums.products)};
+    for(std::uint32_t c = 0; c < 4; c++) {
+        const double s{premultiplied[c] / 256.0 - 0.5};
+        delta += 2.0 * k * s * static_cast<double>(sums.current[c]) + n * s * s - 2.0 * s * static_cast<double>(sums.target[c]);
+    }
+    return static_cast<std::int64_t>(std::llround(delta));
+}
+
+void IntegralImages::updateCurrent(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::uint32_t x1, const std::uint32_t y1, const std::uint32_t y2)
+{
+    const std::size_t stride{m_width + 1U};
+    const std::uint32_t columns{m_width - x1};
+    const std::uint8_t* t{target.getDataRef().data()};
+    const std::uint8_t* p{current.getDataRef().data()};
+
+    // Every entry below and to the right of the changed rectangle depends on it. The rows it spans are summed again from the pixels out to the right edge,
+    // and the rows below it only shift by how much the last of those rows changed, so they are patched column by column
+    std::vector<std::uint32_t> sumsChange(static_cast<std::size_t>(columns) * 4U);
+    std::vector<std::uint64_t> squaresChange(columns);
+    std::vector<std::uint64_t> productsChange(columns);
+    {
+        const std::size_t last{(y2 + 1U) * stride + x1 + 1U};
+        for(std::uint32_t i = 0; i < columns; i++) {
+            for(std::uint32_t c = 0; c < 4; c++) {
+                sumsChange[i * 4U + c] = m_currentSums[(last + i) * 4U + c];
+            }
+            squaresChange[i] = m_currentSquares[last + i];
+            productsChange[i] = m_products[last + i];
+        }
+    }
+
+    for(std::uint32_t y = y1; y <= y2; y++) {
+        const std::size_t above{y * stride + x1};
+        const std::size_t here{(y + 1U) * stride + x1};
+
+        // Start from the part of the row left of the rectangle, which did not change
+        std::uint32_t row[4];
+        for(std::uint32_t c = 0; c < 4; c++) {
+            row[c] = m_currentSums[here * 4U + c] - m_currentSums[above * 4U + c];
+        }
+        std::uint64_t rowSquares{m_currentSquares[here] - m_currentSquares[above]};
+        std::uint64_t rowProducts{m_products[here] - m_products[above]};
+
+        const std::size_t pixel{(static_cast<std::size_t>(y) * m_width + x1) * 4U};
+        for(std::uint32_t i = 0; i < columns; i++) {
+            const std::uint8_t* tp{t + pixel + i * 4U};
+            const std::uint8_t* cp{p + pixel + i * 4U};
+            for(std::uint32_t c = 0; c < 4; c++) {
+                row[c] += cp[c];
+                rowSquares += static_cast<std::uint64_t>(cp[c]) * cp[c];
+                rowProducts += static_cast<std::uint64_t>(tp[c]) * cp[c];
+                m_currentSums[(here + i + 1U) * 4U + c] = m_currentSums[(above + i + 1U) * 4U + c] + row[c];
+            }
+            m_currentSquares[here + i + 1U] = m_currentSquares[above + i + 1U] + rowSquares;
+            m_products[here + i + 1U] = m_products[above + i + 1U] + rowProducts;
+        }
+    }
+
+    if(y2 + 1U >= m_height) {
+        return;
+    }
+
+    // Unsigned arithmetic wraps, so the changes are exact even where the sums went down
+    const std::size_t last{(y2 + 1U) * stride + x1 + 1U};
+    for(std::uint32_t i = 0; i < columns; i++) {
+        for(std::uint32_t c = 0; c < 4; c++) {
+            sumsChange[i * 4U + c] = m_currentSums[(last + i) * 4U + c] - sumsChange[i * 4U + c];
+        }
+        squaresChange[i] = m_currentSquares[last + i] - squaresChange[i];
+        productsChange[i] = m_products[last + i] - productsChange[i];
+    }
+    for(std::uint32_t y = y2 + 2U; y <= m_height; y++) {
+        const std::size_t first{y * stride + x1 + 1U};
+        for(std::uint32_t i = 0; i < columns; i++) {
+            for(std::uint32_t c = 0; c < 4; c++) {
+                m_currentSums[(first + i) * 4U + c] += sumsChange[i * 4U + c];
+            }
+            m_currentSquares[first + i] += squaresChange[i];
+            m_products[first + i] += productsChange[i];
+        }
+    }
+}
+
+IntegralImages::Sums IntegralImages::getSums(const std::int32_t x1, const std::int32_t y1, const std::int32_t x2, const std::int32_t y2) const
+{
+    assert(x1 >= 0 && y1 >= 0 && x1 <= x2 && y1 <= y2 && x2 < static_cast<std::int32_t>(m_width) && y2 < static_cast<std::int32_t>(m_height));
+
+    const std::size_t stride{m_width + 1U};
+    const std::size_t topLeft{static_cast<std::size_t>(y1) * stride + static_cast<std::size_t>(x1)};
+    const std::size_t topRight{static_cast<std::size_t>(y1) * stride + static_cast<std::size_t>(x2) + 1U};
+    const std::size_t bottomLeft{(static_cast<std::size_t>(y2) + 1U) * stride + static_cast<std::size_t>(x1)};
+    const std::size_t bottomRight{(static_cast<std::size_t>(y2) + 1U) * stride + static_cast<std::size_t>(x2) + 1U};
+
+    Sums sums;
+    for(std::uint32_t c = 0; c < 4; c++) {
+        sums.target[c] = static_cast<std::uint32_t>(m_targetSums[bottomRight * 4U + c] - m_targetSums[topRight * 4U + c] - m_targetSums[bottomLeft * 4U + c] + m_targetSums[topLeft * 4U + c]);
+        sums.current[c] = static_cast<std::uint32_t>(m_currentSums[bottomRight * 4U + c] - m_currentSums[topRight * 4U + c] - m_currentSums[bottomLeft * 4U + c] + m_currentSums[topLeft * 4U + c]);
+    }
+    sums.currentSquares = m_currentSquares[bottomRight] - m_currentSquares[topRight] - m_currentSquares[bottomLeft] + m_currentSquares[topLeft];
+    sums.products = m_products[bottomRight] - m_products[topRight] - m_products[bottomLeft] + m_products[topLeft];
+    return sums;
+}
+
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/bitmap/rgba.h"
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The IntegralImages class keeps summed-area tables of a target and current image pair, so that the optimal color of an axis-aligned
+ * rectangle and the change in squared error from drawing it can be calculated in constant time, without touching the pixels under the rectangle.
+ * The color matches optimizer::computeColor exactly. The energy treats alpha blending as exact arithmetic, so it differs from
+ * optimizer::energyDelta by the rounding of each blended pixel, which is plenty for ranking candidates.
+ */
+class IntegralImages
+{
+public:
+    /**
+     * @brief MAX_PIXELS The largest image, in pixels, that integral images are kept for. Larger images fall back to rasterizing.
+     */
+    static const std::uint32_t MAX_PIXELS{1U << 22};
+
+    IntegralImages();
+    IntegralImages& operator=(const IntegralImages&) = default;
+    IntegralImages(const IntegralImages&) = default;
+    ~IntegralImages() = default;
+
+    /**
+     * @brief reset Recalculates the tables from scratch. The tables are left invalid if the images are larger than MAX_PIXELS.
+     * @param target The target image.
+     * @param current The current image.
+     */
+    void reset(const geometrize::Bitmap& target, const geometrize::Bitmap& current);
+
+    /**
+     * @brief isValid Returns true if the tables have been calculated for a pair of images.
+     * @return True if the tables are valid, else false.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief invalidate Marks the tables as out of date and releases their memory.
+     */
+    void invalidate();
+
+    /**
+     * @brief update Recalculates the tables after the pixels of the current image within a rectangle changed.
+     * @param target The target image.
+     * @param current The current image, after the change.
+     * @param x1 The left edge of the rectangle that changed.
+     * @param y1 The top edge of the rectangle that changed.
+     * @param x2 The right edge of the rectangle that changed, inclusive.
+     * @param y2 The bottom edge of the rectangle that changed, inclusive.
+     */
+    void update(const geometrize::Bitmap& target, const geometrize::Bitmap& current, std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2);
+
+    /**
+     * @brief computeColor Calculates the color of a rectangle that best approximates the target image.
+     * @param x1 The left edge of the rectangle.
+     * @param y1 The top edge of the rectangle.
+     * @param x2 The right edge of the rectangle, inclusive.
+     * @param y2 The bottom edge of the rectangle, inclusive.
+     * @param alpha The alpha of the rectangle.
+     * @return The color of the rectangle.
+     */
+    geometrize::rgba computeColor(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint8_t alpha) const;
+
+    /**
+     * @brief energyDelta Calculates how the total squared error between the images would change if a rectangle were drawn with its optimal color.
+     * @param x1 The left edge of the rectangle.
+     * @param y1 The top edge of the rectangle.
+     * @param x2 The right edge of the rectangle, inclusive.
+     * @param y2 The bottom edge of the rectangle, inclusive.
+     * @param alpha The alpha of the rectangle.
+     * @return The change in squared error, negative if drawing the rectangle improves the image.
+     */
+    std::int64_t energyDelta(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint8_t alpha) const;
+
+private:
+    struct Sums
+    {
+        std::uint64_t target[4];
+        std::uint64_t current[4];
+        std::uint64_t currentSquares;
+        std::uint64_t products;
+    };
+
+    void updateCurrent(const geometrize::Bitmap& target, const geometrize::Bitmap& current, std::uint32_t x1, std::uint32_t y1, std::uint32_t y2);
+    Sums getSums(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2) const;
+
+    std::uint32_t m_width; ///> Width of the images
+    std::uint32_t m_height; ///> Height of the images
+    bool m_valid; ///> Whether the tables have been calculated
+    std::vector<std::uint32_t> m_targetSums; ///> Summed-area table of each channel of the target image, four interleaved channels per entry
+    std::vector<std::uint32_t> m_currentSums; ///> Summed-area table of each channel of the current image, four interleaved channels per entry
+    std::vector<std::uint64_t> m_currentSquares; ///> Summed-area table of the squares of the current image, summed over all channels
+    std::vector<std::uint64_t> m_products; ///> Summed-area table of the target image times the current image, summed over all channels
+};
+
+}
+
+}
@@ -0,0 +1,422 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/rasterizer/scanline.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GEOMETRIZE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(GEOMETRIZE_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GEOMETRIZE_TARGET_SSE2 __attribute__((target("sse2")))
+#define GEOMETRIZE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GEOMETRIZE_TARGET_SSE2
+#define GEOMETRIZE_TARGET_AVX2
+#endif
+
+namespace
+{
+
+// The instruction sets the kernels have implementations for, picked once at startup from what the CPU supports
+enum class KernelLevel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Sums of the red, green and blue channels of a run of pixels
+struct ChannelSums
+{
+    std::uint64_t r{0};
+    std::uint64_t g{0};
+    std::uint64_t b{0};
+};
+
+// Sums the squared differences of two runs of bytes
+using SumSquaredDifferencesFn = std::uint64_t(*)(const std::uint8_t* first, const std::uint8_t* second, std::size_t byteCount);
+
+// Sums the color channels of a run of RGBA8888 pixels
+using SumChannelsFn = void(*)(const std::uint8_t* pixels, std::size_t pixelCount, ChannelSums& sums);
+
+std::uint64_t sumSquaredDifferencesScalar(const std::uint8_t* first, const std::uint8_t* second, const std::size_t byteCount)
+{
+    std::uint64_t total{0};
+    for(std::size_t i = 0; i < byteCount; i++) {
+        const std::int32_t d{static_cast<std::int32_t>(first[i]) - static_cast<std::int32_t>(second[i])};
+        total += static_cast<std::uint64_t>(d * d);
+    }
+    return total;
+}
+
+void sumChannelsScalar(const std::uint8_t* pixels, const std::size_t pixelCount, ChannelSums& sums)
+{
+    for(std::size_t i = 0; i < pixelCount; i++) {
+        sums.r += pixels[i * 4 + 0];
+        sums.g += pixels[i * 4 + 1];
+        sums.b += pixels[i * 4 + 2];
+    }
+}
+
+#ifdef GEOMETRIZE_KERNELS_X86
+
+// Each 32-bit accumulator lane gains at most 4 * 255^2 per iteration, so flush to 64 bits well before the lanes can overflow
+const std::size_t simdFlushInterval{4096};
+
+GEOMETRIZE_TARGET_SSE2 std::uint64_t horizontalSumSse2(const __m128i v)
+{
+    alignas(16) std::uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+GEOMETRIZE_TARGET_SSE2 std::uint64_t sumSquaredDifferencesSse2(const std::uint8_t* first, const std::uint8_t* second, const std::size_t byteCount)
+{
+    const __m128i zero{_mm_setzero_si128()};
+    std::uint64_t total{0};
+    std::size_t i{0};
+    while(i + 16 <= byteCount) {
+        __m128i acc{_mm_setzero_si128()};
+        for(std::size_t n = 0; n < simdFlushInterval && i + 16 <= byteCount; n++, i += 16) {
+            const __m128i a{_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i))};
+            const __m128i b{_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i))};
+            const __m128i dLo{_mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero))};
+            const __m128i dHi{_mm_sub_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero))};
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(dLo, dLo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(dHi, dHi));
+        }
+        total += horizontalSumSse2(acc);
+    }
+    return total + sumSquaredDifferencesScalar(first + i, second + i, byteCount - i);
+}
+
+GEOMETRIZE_TARGET_SSE2 void sumChannelsSse2(const std::uint8_t* pixels, const std::size_t pixelCount, ChannelSums& sums)
+{
+    const __m128i zero{_mm_setzero_si128()};
+    const __m128i maskR{_mm_set1_epi32(0x000000FF)};
+    const __m128i maskG{_mm_set1_epi32(0x0000FF00)};
+    const __m128i maskB{_mm_set1_epi32(0x00FF0000)};
+
+    __m128i accR{_mm_setzero_si128()};
+    __m128i accG{_mm_setzero_si128()};
+    __m128i accB{_mm_setzero_si128()};
+    std::size_t i{0};
+    for(; i + 4 <= pixelCount; i += 4) {
+        const __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 4))};
+        accR = _mm_add_epi64(accR, _mm_sad_epu8(_mm_and_si128(v, maskR), zero));
+        accG = _mm_add_epi64(accG, _mm_sad_epu8(_mm_and_si128(v, maskG), zero));
+        accB = _mm_add_epi64(accB, _mm_sad_epu8(_mm_and_si128(v, maskB), zero));
+    }
+
+    alignas(16) std::uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accR);
+    sums.r += lanes[0] + lanes[1];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accG);
+    sums.g += lanes[0] + lanes[1];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accB);
+    sums.b += lanes[0] + lanes[1];
+
+    sumChannelsScalar(pixels + i * 4, pixelCount - i, sums);
+}
+
+GEOMETRIZE_TARGET_AVX2 std::uint64_t sumSquaredDifferencesAvx2(const std::uint8_t* first, const std::uint8_t* second, const std::size_t byteCount)
+{
+    std::uint64_t total{0};
+    std::size_t i{0};
+    while(i + 32 <= byteCount) {
+        __m256i acc{_mm256_setzero_si256()};
+        for(std::size_t n = 0; n < simdFlushInterval && i + 32 <= byteCount; n++, i += 32) {
+            const __m256i aLo{_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i)))};
+            const __m256i bLo{_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i)))};
+            const __m256i aHi{_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i + 16)))};
+            const __m256i bHi{_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i + 16)))};
+            const __m256i dLo{_mm256_sub_epi16(aLo, bLo)};
+            const __m256i dHi{_mm256_sub_epi16(aHi, bHi)};
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(dLo, dLo));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(dHi, dHi));
+        }
+        alignas(32) std::uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for(const std::uint32_t lane : lanes) {
+            total += lane;
+        }
+    }
+    return total + sumSquaredDifferencesSse2(first + i, second + i, byteCount - i);
+}
+
+GEOMETRIZE_TARGET_AVX2 void sumChannelsAvx2(const std::uint8_t* pixels, const std::size_t pixelCount, ChannelSums& sums)
+{
+    const __m256i zero{_mm256_setzero_si256()};
+    const __m256i maskR{_mm256_set1_epi32(0x000000FF)};
+    const __m256i maskG{_mm256_set1_epi32(0x0000FF00)};
+    const __m256i maskB{_mm256_set1_epi32(0x00FF0000)};
+
+    __m256i accR{_mm256_setzero_si256()};
+    __m256i accG{_mm256_setzero_si256()};
+    __m256i accB{_mm256_setzero_si256()};
+    std::size_t i{0};
+    for(; i + 8 <= pixelCount; i += 8) {
+        const __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i * 4))};
+        accR = _mm256_add_epi64(accR, _mm256_sad_epu8(_mm256_and_si256(v, maskR), zero));
+        accG = _mm256_add_epi64(accG, _mm256_sad_epu8(_mm256_and_si256(v, maskG), zero));
+        accB = _mm256_add_epi64(accB, _mm256_sad_epu8(_mm256_and_si256(v, maskB), zero));
+    }
+
+    alignas(32) std::uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accR);
+    sums.r += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accG);
+    sums.g += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accB);
+    sums.b += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    sumChannelsSse2(pixels + i * 4, pixelCount - i, sums);
+}
+
+bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osUsesXsave{(info[2] & (1 << 27)) != 0};
+    const bool cpuHasAvx{(info[2] & (1 << 28)) != 0};
+    if(!osUsesXsave || !cpuHasAvx) {
+        return false;
+    }
+    if((_xgetbv(0) & 0x6) != 0x6) {
+        return false; // The OS does not save the YMM registers on context switches
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+KernelLevel detectKernelLevel()
+{
+#ifdef GEOMETRIZE_KERNELS_X86
+    if(cpuSupportsAvx2()) {
+        return KernelLevel::AVX2;
+    }
+#if defined(_M_IX86) || (defined(__i386__) && !defined(__SSE2__))
+    // SSE2 is not guaranteed on 32-bit x86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if(!__builtin_cpu_supports("sse2")) {
+        return KernelLevel::SCALAR;
+    }
+#endif
+#endif
+    return KernelLevel::SSE2;
+#else
+    return KernelLevel::SCALAR;
+#endif
+}
+
+// The kernel implementations currently in use
+struct KernelTable
+{
+    SumSquaredDifferencesFn sumSquaredDifferences;
+    SumChannelsFn sumChannels;
+};
+
+KernelTable makeKernelTable(const KernelLevel level)
+{
+    switch(level) {
+#ifdef GEOMETRIZE_KERNELS_X86
+    case KernelLevel::AVX2:
+        return { &sumSquaredDifferencesAvx2, &sumChannelsAvx2 };
+    case KernelLevel::SSE2:
+        return { &sumSquaredDifferencesSse2, &sumChannelsSse2 };
+#endif
+    default:
+        return { &sumSquaredDifferencesScalar, &sumChannelsScalar };
+    }
+}
+
+const KernelTable& getKernelTable()
+{
+    static const KernelTable table{makeKernelTable(detectKernelLevel())};
+    return table;
+}
+
+// Gets a pointer to the first byte of the given scanline in a bitmap
+const std::uint8_t* getLineData(const geometrize::Bitmap& bitmap, const geometrize::Scanline& line)
+{
+    return bitmap.getDataRef().data() + (static_cast<std::size_t>(line.y) * bitmap.getWidth() + static_cast<std::size_t>(line.x1)) * 4U;
+}
+
+std::uint8_t* getLineData(geometrize::Bitmap& bitmap, const geometrize::Scanline& line)
+{
+    return bitmap.getDataRef().data() + (static_cast<std::size_t>(line.y) * bitmap.getWidth() + static_cast<std::size_t>(line.x1)) * 4U;
+}
+
+std::size_t getLinePixelCount(const geometrize::Scanline& line)
+{
+    return static_cast<std::size_t>(line.x2 - line.x1 + 1);
+}
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+std::uint64_t sumSquaredDifferences(const std::uint8_t* first, const std::uint8_t* second, const std::size_t byteCount)
+{
+    return getKernelTable().sumSquaredDifferences(first, second, byteCount);
+}
+
+std::uint64_t sumSquaredDifferences(const geometrize::Bitmap& first, const geometrize::Bitmap& second, const std::vector<geometrize::Scanline>& lines)
+{
+    const SumSquaredDifferencesFn ssd{getKernelTable().sumSquaredDifferences};
+    std::uint64_t total{0};
+    for(const geometrize::Scanline& line : lines) {
+        total += ssd(getLineData(first, line), getLineData(second, line), getLinePixelCount(line) * 4U);
+    }
+    return total;
+}
+
+float scoreFromError(const std::uint64_t error, const std::uint32_t width, const std::uint32_t height)
+{
+    const std::uint64_t rgbaCount{static_cast<std::uint64_t>(width) * height * 4U};
+    if(rgbaCount == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(std::sqrt(error / static_cast<double>(rgbaCount))) / 255.0f;
+}
+
+void trimScanlines(std::vector<geometrize::Scanline>& lines, const std::uint32_t width, const std::uint32_t height)
+{
+    const std::int32_t w{static_cast<std::int32_t>(width)};
+    const std::int32_t h{static_cast<std::int32_t>(height)};
+    std::size_t count{0};
+    for(geometrize::Scanline line : lines) {
+        if(line.y < 0 || line.y >= h || line.x1 >= w || line.x2 < 0) {
+            continue;
+        }
+        line.x1 = std::max(line.x1, 0);
+        line.x2 = std::min(line.x2, w - 1);
+        if(line.x1 > line.x2) {
+            continue;
+        }
+        lines[count++] = line;
+    }
+    lines.erase(lines.begin() + count, lines.end());
+}
+
+geometrize::rgba computeColor(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines, const std::uint8_t alpha)
+{
+    const SumChannelsFn sumChannels{getKernelTable().sumChannels};
+
+    ChannelSums targetSums;
+    ChannelSums currentSums;
+    std::int64_t count{0};
+    for(const geometrize::Scanline& line : lines) {
+        const std::size_t pixelCount{getLinePixelCount(line)};
+        sumChannels(getLineData(target, line), pixelCount, targetSums);
+        sumChannels(getLineData(current, line), pixelCount, currentSums);
+        count += static_cast<std::int64_t>(pixelCount);
+    }
+
+    if(count == 0 || alpha == 0) {
+        return geometrize::rgba{0, 0, 0, 0};
+    }
+
+    // Sum of (t - c) * a + c * 257 over every pixel, rearranged so the per-channel sums can be accumulated independently
+    const std::int64_t a{257 * 255 / alpha};
+    const auto channel = [a, count](const std::uint64_t t, const std::uint64_t c) -> std::uint8_t {
+        const std::int64_t total{a * static_cast<std::int64_t>(t) + (257 - a) * static_cast<std::int64_t>(c)};
+        return static_cast<std::uint8_t>(std::min<std::int64_t>(std::max<std::int64_t>((total / count) >> 8, 0), 255));
+    };
+
+    return geometrize::rgba{channel(targetSums.r, currentSums.r), channel(targetSums.g, currentSums.g), channel(targetSums.b, currentSums.b), alpha};
+}
+
+void drawLines(geometrize::Bitmap& image, const geometrize::rgba color, const std::vector<geometrize::Scanline>& lines)
+{
+    // Convert the non-premultiplied color to alpha-premultiplied 16-bits per channel RGBA
+    const std::uint32_t m{UINT16_MAX};
+    const std::uint32_t sa{static_cast<std::uint32_t>(color.a) | (static_cast<std::uint32_t>(color.a) << 8)};
+    const std::uint32_t sr{((static_cast<std::uint32_t>(color.r) | (static_cast<std::uint32_t>(color.r) << 8)) * color.a) / UINT8_MAX};
+    const std::uint32_t sg{((static_cast<std::uint32_t>(color.g) | (static_cast<std::uint32_t>(color.g) << 8)) * color.a) / UINT8_MAX};
+    const std::uint32_t sb{((static_cast<std::uint32_t>(color.b) | (static_cast<std::uint32_t>(color.b) << 8)) * color.a) / UINT8_MAX};
+    const std::uint32_t as{(m - sa) * 257};
+
+    for(const geometrize::Scanline& line : lines) {
+        std::uint8_t* d{getLineData(image, line)};
+        const std::size_t pixelCount{getLinePixelCount(line)};
+        for(std::size_t i = 0; i < pixelCount; i++, d += 4) {
+            d[0] = static_cast<std::uint8_t>(((d[0] * as + sr * m) / m) >> 8);
+            d[1] = static_cast<std::uint8_t>(((d[1] * as + sg * m) / m) >> 8);
+            d[2] = static_cast<std::uint8_t>(((d[2] * as + sb * m) / m) >> 8);
+            d[3] = static_cast<std::uint8_t>(((d[3] * as + sa * m) / m) >> 8);
+        }
+    }
+}
+
+void copyLines(geometrize::Bitmap& destination, const geometrize::Bitmap& source, const std::vector<geometrize::Scanline>& lines)
+{
+    for(const geometrize::Scanline& line : lines) {
+        std::memcpy(getLineData(destination, line), getLineData(source, line), getLinePixelCount(line) * 4U);
+    }
+}
+
+std::int64_t energyDelta(const std::vector<geometrize::Scanline>& lines, const std::uint8_t alpha, const geometrize::Bitmap& target, const geometrize::Bitmap& current, geometrize::Bitmap& buffer)
+{
+    const geometrize::rgba color{computeColor(target, current, lines, alpha)};
+    copyLines(buffer, current, lines);
+    drawLines(buffer, color, lines);
+    return static_cast<std::int64_t>(sumSquaredDifferences(target, buffer, lines)) - static_cast<std::int64_t>(sumSquaredDifferences(target, current, lines));
+}
+
+std::int64_t energyDelta(const std::vector<geometrize::Scanline>& lines, const std::vector<std::uint8_t>& weights, const std::uint8_t alpha,
+                         const geometrize::Bitmap& target, const geometrize::Bitmap& current, geometrize::Bitmap& buffer)
+{
+    assert(lines.size() == weights.size());
+
+    const SumSquaredDifferencesFn ssd{getKernelTable().sumSquaredDifferences};
+    const geometrize::rgba color{computeColor(target, current, lines, alpha)};
+    copyLines(buffer, current, lines);
+    drawLines(buffer, color, lines);
+
+    std::int64_t total{0};
+    for(std::size_t i = 0; i < lines.size(); i++) {
+        const geometrize::Scanline& line{lines[i]};
+        const std::size_t byteCount{getLinePixelCount(line) * 4U};
+        const std::int64_t before{static_cast<std::int64_t>(ssd(getLineData(target, line), getLineData(current, line), byteCount))};
+        const std::int64_t after{static_cast<std::int64_t>(ssd(getLineData(target, line), getLineData(buffer, line), byteCount))};
+        total += (after - before) * weights[i];
+    }
+    return total / 255;
+}
+
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/rasterizer/scanline.h"
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief sumSquaredDifferences Sums the squared differences between two runs of bytes.
+ * @param first The first run of bytes.
+ * @param second The second run of bytes.
+ * @param byteCount The number of bytes in each run.
+ * @return The sum of the squared differences.
+ */
+std::uint64_t sumSquaredDifferences(const std::uint8_t* first, const std::uint8_t* second, std::size_t byteCount);
+
+/**
+ * @brief sumSquaredDifferences Sums the squared differences of every channel between two images, over the pixels covered by the scanlines only.
+ * @param first The first image.
+ * @param second The second image.
+ * @param lines The scanlines to visit.
+ * @return The sum of the squared differences.
+ */
+std::uint64_t sumSquaredDifferences(const geometrize::Bitmap& first, const geometrize::Bitmap& second, const std::vector<geometrize::Scanline>& lines);
+
+/**
+ * @brief scoreFromError Converts a total squared error into the normalized root-mean-square score used by the Geometrize library.
+ * @param error The sum of the squared differences of every channel of every pixel.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return The normalized difference, in the range [0, 1].
+ */
+float scoreFromError(std::uint64_t error, std::uint32_t width, std::uint32_t height);
+
+/**
+ * @brief trimScanlines Clips scanlines to the given image bounds, removing any that fall entirely outside them.
+ * @param lines The scanlines to trim.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ */
+void trimScanlines(std::vector<geometrize::Scanline>& lines, std::uint32_t width, std::uint32_t height);
+
+/**
+ * @brief computeColor Calculates the color of the scanlines that best approximates the target image.
+ * Equivalent to geometrize::core::computeColor.
+ * @param target The target image.
+ * @param current The current image.
+ * @param lines The scanlines.
+ * @param alpha The alpha of the color to calculate.
+ * @return The best color for the scanlines.
+ */
+geometrize::rgba computeColor(const geometrize::Bitmap& target, const geometrize::Bitmap& current, const std::vector<geometrize::Scanline>& lines, std::uint8_t alpha);
+
+/**
+ * @brief drawLines Alpha-blends the scanlines of the given color onto the image.
+ * Equivalent to geometrize::core::drawLines.
+ * @param image The image to draw to.
+ * @param color The color of the scanlines.
+ * @param lines The scanlines to draw.
+ */
+void drawLines(geometrize::Bitmap& image, geometrize::rgba color, const std::vector<geometrize::Scanline>& lines);
+
+/**
+ * @brief copyLines Copies the pixels covered by the scanlines from the source image to the destination image.
+ * @param destination The image to copy to.
+ * @param source The image to copy from.
+ * @param lines The scanlines to copy.
+ */
+void copyLines(geometrize::Bitmap& destination, const geometrize::Bitmap& source, const std::vector<geometrize::Scanline>& lines);
+
+/**
+ * @brief energyDelta Calculates how the total squared error between the target and current images would change if the scanlines were drawn with their optimal color.
+ * This only depends on the pixels covered by the scanlines, so it needs no knowledge of the error of the rest of the image.
+ * @param lines The scanlines of the candidate shape.
+ * @param alpha The alpha of the candidate shape.
+ * @param target The target image.
+ * @param current The current image.
+ * @param buffer Scratch image the same size as the current image, the pixels covered by the scanlines are overwritten.
+ * @return The change in the total squared error, negative if drawing the scanlines would improve the image.
+ */
+std::int64_t energyDelta(const std::vector<geometrize::Scanline>& lines, std::uint8_t alpha, const geometrize::Bitmap& target, const geometrize::Bitmap& current, geometrize::Bitmap& buffer);
+
+/**
+ * @brief energyDelta Like energyDelta, but the change in error under each scanline is scaled by the scanline's weight, so some pixels count for more than others.
+ * The color is the optimal color over every scanline regardless of weight.
+ * @param lines The scanlines of the candidate shape.
+ * @param weights The weight of each scanline, where 255 counts fully.
+ * @param alpha The alpha of the candidate shape.
+ * @param target The target image.
+ * @param current The current image.
+ * @param buffer Scratch image the same size as the current image, the pixels covered by the scanlines are overwritten.
+ * @return The weighted change in the total squared error, negative if drawing the scanlines would improve the image.
+ */
+std::int64_t energyDelta(const std::vector<geometrize::Scanline>& lines, const std::vector<std::uint8_t>& weights, std::uint8_t alpha,
+                         const geometrize::Bitmap& target, const geometrize::Bitmap& current, geometrize::Bitmap& buffer);
+
+}
+
+}
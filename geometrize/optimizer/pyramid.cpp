@@ -0,0 +1,65 @@
+#include "pyramid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+geometrize::Bitmap downsample(const geometrize::Bitmap& source, const std::uint32_t factor)
+{
+    assert(factor > 0);
+    const std::uint32_t width{std::max(1U, (source.getWidth() + factor - 1) / factor)};
+    const std::uint32_t height{std::max(1U, (source.getHeight() + factor - 1) / factor)};
+    geometrize::Bitmap destination(width, height, geometrize::rgba{0, 0, 0, 0});
+    downsampleRows(source, destination, factor, 0, height - 1);
+    return destination;
+}
+
+void downsampleRows(const geometrize::Bitmap& source, geometrize::Bitmap& destination, const std::uint32_t factor, const std::uint32_t firstRow, const std::uint32_t lastRow)
+{
+    const std::uint32_t sourceWidth{source.getWidth()};
+    const std::uint32_t sourceHeight{source.getHeight()};
+    const std::uint32_t width{destination.getWidth()};
+    const std::uint8_t* in{source.getDataRef().data()};
+    std::uint8_t* out{destination.getDataRef().data()};
+
+    const std::uint32_t end{std::min(lastRow, destination.getHeight() - 1)};
+    for(std::uint32_t y = firstRow; y <= end; y++) {
+        const std::uint32_t y1{y * factor};
+        const std::uint32_t y2{std::min(sourceHeight, y1 + factor)};
+        for(std::uint32_t x = 0; x < width; x++) {
+            const std::uint32_t x1{x * factor};
+            const std::uint32_t x2{std::min(sourceWidth, x1 + factor)};
+
+            std::uint32_t sum[4]{0, 0, 0, 0};
+            for(std::uint32_t sy = y1; sy < y2; sy++) {
+                const std::uint8_t* pixel{in + (static_cast<std::size_t>(sy) * sourceWidth + x1) * 4U};
+                for(std::uint32_t sx = x1; sx < x2; sx++, pixel += 4) {
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                    sum[3] += pixel[3];
+                }
+            }
+
+            const std::uint32_t count{(x2 - x1) * (y2 - y1)};
+            std::uint8_t* target{out + (static_cast<std::size_t>(y) * width + x) * 4U};
+            for(std::uint32_t c = 0; c < 4; c++) {
+                target[c] = static_cast<std::uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+}
+
+}
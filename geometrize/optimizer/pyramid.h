@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief downsample Shrinks an image by an integer factor, averaging each block of pixels into one pixel.
+ * @param source The image to shrink.
+ * @param factor The factor to shrink the image by. The result is rounded up, so partial blocks at the edges become pixels too.
+ * @return The shrunk image.
+ */
+geometrize::Bitmap downsample(const geometrize::Bitmap& source, std::uint32_t factor);
+
+/**
+ * @brief downsampleRows Updates a range of rows of an image previously produced by downsample, after the source image changed.
+ * @param source The full size image.
+ * @param destination The shrunk image to update.
+ * @param factor The factor the destination image was shrunk by.
+ * @param firstRow The first row of the destination image to update.
+ * @param lastRow The last row of the destination image to update, inclusive.
+ */
+void downsampleRows(const geometrize::Bitmap& source, geometrize::Bitmap& destination, std::uint32_t factor, std::uint32_t firstRow, std::uint32_t lastRow);
+
+}
+
+}
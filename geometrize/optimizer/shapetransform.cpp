@@ -0,0 +1,300 @@
+#include "shapetransform.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/model.h"
+#include "geometrize/shape/circle.h"
+#include "geometrize/shape/ellipse.h"
+#include "geometrize/shape/line.h"
+#include "geometrize/shape/polyline.h"
+#include "geometrize/shape/quadraticbezier.h"
+#include "geometrize/shape/rectangle.h"
+#include "geometrize/shape/rotatedellipse.h"
+#include "geometrize/shape/rotatedrectangle.h"
+#include "geometrize/shape/shape.h"
+#include "geometrize/shape/shapetypes.h"
+#include "geometrize/shape/triangle.h"
+
+namespace
+{
+
+// Maps coordinates from a shrunk or cropped image onto the full size image
+class ShapeScaler
+{
+public:
+    ShapeScaler(const geometrize::Model& model, const std::uint32_t factor, const std::int32_t offsetX, const std::int32_t offsetY) :
+        m_factor{static_cast<std::int32_t>(factor)},
+        m_offsetX{offsetX},
+        m_offsetY{offsetY},
+        m_maxX{static_cast<std::int32_t>(model.getTarget().getWidth()) - 1},
+        m_maxY{static_cast<std::int32_t>(model.getTarget().getHeight()) - 1}
+    {
+    }
+
+    template<typename T>
+    void point(T& x, T& y) const
+    {
+        x = static_cast<T>(std::min(m_maxX, std::max(0, static_cast<std::int32_t>(x) * m_factor + m_factor / 2 + m_offsetX)));
+        y = static_cast<T>(std::min(m_maxY, std::max(0, static_cast<std::int32_t>(y) * m_factor + m_factor / 2 + m_offsetY)));
+    }
+
+    template<typename T>
+    void length(T& value) const
+    {
+        value = static_cast<T>(std::max(1, static_cast<std::int32_t>(value) * m_factor));
+    }
+
+private:
+    const std::int32_t m_factor;
+    const std::int32_t m_offsetX;
+    const std::int32_t m_offsetY;
+    const std::int32_t m_maxX;
+    const std::int32_t m_maxY;
+};
+
+std::shared_ptr<geometrize::Shape> transformShape(const geometrize::Shape& shape, const geometrize::Model& model, const std::uint32_t factor, const std::int32_t offsetX, const std::int32_t offsetY)
+{
+    const ShapeScaler scale(model, factor, offsetX, offsetY);
+
+    switch(shape.getType()) {
+    case geometrize::RECTANGLE: {
+        const geometrize::Rectangle& s{static_cast<const geometrize::Rectangle&>(shape)};
+        std::shared_ptr<geometrize::Rectangle> r{std::make_shared<geometrize::Rectangle>(model)};
+        r->m_x1 = s.m_x1;
+        r->m_y1 = s.m_y1;
+        r->m_x2 = s.m_x2;
+        r->m_y2 = s.m_y2;
+        scale.point(r->m_x1, r->m_y1);
+        scale.point(r->m_x2, r->m_y2);
+        return r;
+    }
+    case geometrize::ROTATED_RECTANGLE: {
+        const geometrize::RotatedRectangle& s{static_cast<const geometrize::RotatedRectangle&>(shape)};
+        std::shared_ptr<geometrize::RotatedRectangle> r{std::make_shared<geometrize::RotatedRectangle>(model)};
+        r->m_x1 = s.m_x1;
+        r->m_y1 = s.m_y1;
+        r->m_x2 = s.m_x2;
+        r->m_y2 = s.m_y2;
+        r->m_angle = s.m_angle;
+        scale.point(r->m_x1, r->m_y1);
+        scale.point(r->m_x2, r->m_y2);
+        return r;
+    }
+    case geometrize::TRIANGLE: {
+        const geometrize::Triangle& s{static_cast<const geometrize::Triangle&>(shape)};
+        std::shared_ptr<geometrize::Triangle> r{std::make_shared<geometrize::Triangle>(model)};
+        r->m_x1 = s.m_x1;
+        r->m_y1 = s.m_y1;
+        r->m_x2 = s.m_x2;
+        r->m_y2 = s.m_y2;
+        r->m_x3 = s.m_x3;
+        r->m_y3 = s.m_y3;
+        scale.point(r->m_x1, r->m_y1);
+        scale.point(r->m_x2, r->m_y2);
+        scale.point(r->m_x3, r->m_y3);
+        return r;
+    }
+    case geometrize::ELLIPSE: {
+        const geometrize::Ellipse& s{static_cast<const geometrize::Ellipse&>(shape)};
+        std::shared_ptr<geometrize::Ellipse> r{std::make_shared<geometrize::Ellipse>(model)};
+        r->m_x = s.m_x;
+        r->m_y = s.m_y;
+        r->m_rx = s.m_rx;
+        r->m_ry = s.m_ry;
+        scale.point(r->m_x, r->m_y);
+        scale.length(r->m_rx);
+        scale.length(r->m_ry);
+        return r;
+    }
+    case geometrize::ROTATED_ELLIPSE: {
+        const geometrize::RotatedEllipse& s{static_cast<const geometrize::RotatedEllipse&>(shape)};
+        std::shared_ptr<geometrize::RotatedEllipse> r{std::make_shared<geometrize::RotatedEllipse>(model)};
+        r->m_x = s.m_x;
+        r->m_y = s.m_y;
+        r->m_rx = s.m_rx;
+        r->m_ry = s.m_ry;
+        r->m_angle = s.m_angle;
+        scale.point(r->m_x, r->m_y);
+        scale.length(r->m_rx);
+        scale.length(r->m_ry);
+        return r;
+    }
+    case geometrize::CIRCLE: {
+        const geometrize::Circle& s{static_cast<const geometrize::Circle&>(shape)};
+        std::shared_ptr<geometrize::Circle> r{std::make_shared<geometrize::Circle>(model)};
+        r->m_x = s.m_x;
+        r->m_y = s.m_y;
+        r->m_r = s.m_r;
+        scale.point(r->m_x, r->m_y);
+        scale.length(r->m_r);
+        return r;
+    }
+    case geometrize::LINE: {
+        const geometrize::Line& s{static_cast<const geometrize::Line&>(shape)};
+        std::shared_ptr<geometrize::Line> r{std::make_shared<geometrize::Line>(model)};
+        r->m_x1 = s.m_x1;
+        r->m_y1 = s.m_y1;
+        r->m_x2 = s.m_x2;
+        r->m_y2 = s.m_y2;
+        scale.point(r->m_x1, r->m_y1);
+        scale.point(r->m_x2, r->m_y2);
+        return r;
+    }
+    case geometrize::QUADRATIC_BEZIER: {
+        const geometrize::QuadraticBezier& s{static_cast<const geometrize::QuadraticBezier&>(shape)};
+        std::shared_ptr<geometrize::QuadraticBezier> r{std::make_shared<geometrize::QuadraticBezier>(model)};
+        r->m_cx = s.m_cx;
+        r->m_cy = s.m_cy;
+        r->m_x1 = s.m_x1;
+        r->m_y1 = s.m_y1;
+        r->m_x2 = s.m_x2;
+        r->m_y2 = s.m_y2;
+        scale.point(r->m_cx, r->m_cy);
+        scale.point(r->m_x1, r->m_y1);
+        scale.point(r->m_x2, r->m_y2);
+        return r;
+    }
+    case geometrize::POLYLINE: {
+        const geometrize::Polyline& s{static_cast<const geometrize::Polyline&>(shape)};
+        std::shared_ptr<geometrize::Polyline> r{std::make_shared<geometrize::Polyline>(model)};
+        r->m_points = s.m_points;
+        for(auto& point : r->m_points) {
+            scale.point(point.first, point.second);
+        }
+        return r;
+    }
+    default:
+        assert(0 && "Bad shape type passed to transformShape");
+        return nullptr;
+    }
+}
+
+// Offsets points in place, clamping them to the bounds of the model
+class ShapeMover
+{
+public:
+    ShapeMover(const geometrize::Model& model, const std::int32_t offsetX, const std::int32_t offsetY) :
+        m_offsetX{offsetX},
+        m_offsetY{offsetY},
+        m_maxX{static_cast<std::int32_t>(model.getTarget().getWidth()) - 1},
+        m_maxY{static_cast<std::int32_t>(model.getTarget().getHeight()) - 1}
+    {
+    }
+
+    template<typename T>
+    void point(T& x, T& y) const
+    {
+        x = static_cast<T>(std::min(m_maxX, std::max(0, static_cast<std::int32_t>(x) + m_offsetX)));
+        y = static_cast<T>(std::min(m_maxY, std::max(0, static_cast<std::int32_t>(y) + m_offsetY)));
+    }
+
+private:
+    const std::int32_t m_offsetX;
+    const std::int32_t m_offsetY;
+    const std::int32_t m_maxX;
+    const std::int32_t m_maxY;
+};
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+void moveShape(geometrize::Shape& shape, const geometrize::Model& model, const std::int32_t x, const std::int32_t y)
+{
+    const auto mover = [&model, x, y](const std::int32_t anchorX, const std::int32_t anchorY) {
+        return ShapeMover(model, x - anchorX, y - anchorY);
+    };
+
+    switch(shape.getType()) {
+    case geometrize::RECTANGLE: {
+        geometrize::Rectangle& s{static_cast<geometrize::Rectangle&>(shape)};
+        const ShapeMover move{mover(s.m_x1, s.m_y1)};
+        move.point(s.m_x1, s.m_y1);
+        move.point(s.m_x2, s.m_y2);
+        break;
+    }
+    case geometrize::ROTATED_RECTANGLE: {
+        geometrize::RotatedRectangle& s{static_cast<geometrize::RotatedRectangle&>(shape)};
+        const ShapeMover move{mover(s.m_x1, s.m_y1)};
+        move.point(s.m_x1, s.m_y1);
+        move.point(s.m_x2, s.m_y2);
+        break;
+    }
+    case geometrize::TRIANGLE: {
+        geometrize::Triangle& s{static_cast<geometrize::Triangle&>(shape)};
+        const ShapeMover move{mover(s.m_x1, s.m_y1)};
+        move.point(s.m_x1, s.m_y1);
+        move.point(s.m_x2, s.m_y2);
+        move.point(s.m_x3, s.m_y3);
+        break;
+    }
+    case geometrize::ELLIPSE: {
+        geometrize::Ellipse& s{static_cast<geometrize::Ellipse&>(shape)};
+        mover(s.m_x, s.m_y).point(s.m_x, s.m_y);
+        break;
+    }
+    case geometrize::ROTATED_ELLIPSE: {
+        geometrize::RotatedEllipse& s{static_cast<geometrize::RotatedEllipse&>(shape)};
+        mover(s.m_x, s.m_y).point(s.m_x, s.m_y);
+        break;
+    }
+    case geometrize::CIRCLE: {
+        geometrize::Circle& s{static_cast<geometrize::Circle&>(shape)};
+        mover(s.m_x, s.m_y).point(s.m_x, s.m_y);
+        break;
+    }
+    case geometrize::LINE: {
+        geometrize::Line& s{static_cast<geometrize::Line&>(shape)};
+        const ShapeMover move{mover(s.m_x1, s.m_y1)};
+        move.point(s.m_x1, s.m_y1);
+        move.point(s.m_x2, s.m_y2);
+        break;
+    }
+    case geometrize::QUADRATIC_BEZIER: {
+        geometrize::QuadraticBezier& s{static_cast<geometrize::QuadraticBezier&>(shape)};
+        const ShapeMover move{mover(s.m_x1, s.m_y1)};
+        move.point(s.m_cx, s.m_cy);
+        move.point(s.m_x1, s.m_y1);
+        move.point(s.m_x2, s.m_y2);
+        break;
+    }
+    case geometrize::POLYLINE: {
+        geometrize::Polyline& s{static_cast<geometrize::Polyline&>(shape)};
+        if(s.m_points.empty()) {
+            break;
+        }
+        const ShapeMover move{mover(s.m_points.front().first, s.m_points.front().second)};
+        for(auto& point : s.m_points) {
+            move.point(point.first, point.second);
+        }
+        break;
+    }
+    default:
+        assert(0 && "Bad shape type passed to moveShape");
+        break;
+    }
+}
+
+std::shared_ptr<geometrize::Shape> scaleShape(const geometrize::Shape& shape, const geometrize::Model& model, const std::uint32_t factor)
+{
+    return transformShape(shape, model, factor, 0, 0);
+}
+
+std::shared_ptr<geometrize::Shape> translateShape(const geometrize::Shape& shape, const geometrize::Model& model, const std::int32_t offsetX, const std::int32_t offsetY)
+{
+    return transformShape(shape, model, 1, offsetX, offsetY);
+}
+
+}
+
+}
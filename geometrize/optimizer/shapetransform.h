@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace geometrize
+{
+class Model;
+class Shape;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief scaleShape Creates a copy of a shape for another model, scaling its coordinates by an integer factor.
+ * Points map to the center of the block of pixels they cover, and are clamped to the bounds of the new model.
+ * @param shape The shape to scale.
+ * @param model The model the scaled shape will belong to.
+ * @param factor The factor to scale the shape by.
+ * @return The scaled shape.
+ */
+std::shared_ptr<geometrize::Shape> scaleShape(const geometrize::Shape& shape, const geometrize::Model& model, std::uint32_t factor);
+
+/**
+ * @brief translateShape Creates a copy of a shape for another model, offsetting its coordinates. Points are clamped to the bounds of the new model.
+ * @param shape The shape to translate.
+ * @param model The model the translated shape will belong to.
+ * @param offsetX The offset to add to the x coordinates.
+ * @param offsetY The offset to add to the y coordinates.
+ * @return The translated shape.
+ */
+std::shared_ptr<geometrize::Shape> translateShape(const geometrize::Shape& shape, const geometrize::Model& model, std::int32_t offsetX, std::int32_t offsetY);
+
+/**
+ * @brief moveShape Moves a shape in place so that its anchor lands on the given point, keeping its size and orientation where the image bounds allow.
+ * The anchor is the center of ellipses and circles, and the first point of every other shape. Points are clamped to the bounds of the model.
+ * @param shape The shape to move.
+ * @param model The model the shape belongs to.
+ * @param x The column to move the anchor to.
+ * @param y The row to move the anchor to.
+ */
+void moveShape(geometrize::Shape& shape, const geometrize::Model& model, std::int32_t x, std::int32_t y);
+
+}
+
+}
@@ -0,0 +1,1009 @@
+#include "stepper.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/commonutil.h"
+#include "geometrize/model.h"
+#include "geometrize/rasterizer/scanline.h"
+#include "geometrize/runner/imagerunneroptions.h"
+#include "geometrize/shape/circle.h"
+#include "geometrize/shape/ellipse.h"
+#include "geometrize/shape/line.h"
+#include "geometrize/shape/polyline.h"
+#include "geometrize/shape/quadraticbezier.h"
+#include "geometrize/shape/rectangle.h"
+#include "geometrize/shape/rotatedellipse.h"
+#include "geometrize/shape/rotatedrectangle.h"
+#include "geometrize/shape/shape.h"
+#include "geometrize/shape/shapetypes.h"
+#include "geometrize/shape/triangle.h"
+#include "geometrize/shaperesult.h"
+
+#include "optimizer/arena.h"
+#include "optimizer/batchmutator.h"
+#include "optimizer/cancellation.h"
+#include "optimizer/errormap.h"
+#include "optimizer/errorsampler.h"
+#include "optimizer/integralimages.h"
+#include "optimizer/kernels.h"
+#include "optimizer/pyramid.h"
+#include "optimizer/shapetransform.h"
+#include "optimizer/threadpool.h"
+#include "optimizer/tiling.h"
+#include "optimizer/weightmask.h"
+
+namespace
+{
+
+// A candidate shape and the change in the total squared error of the model if the shape were drawn
+struct Candidate
+{
+    std::shared_ptr<geometrize::Shape> shape;
+    std::int64_t delta;
+};
+
+const std::size_t candidatesPerTask{16}; // The number of random candidates sampled by each task
+const std::size_t mutationsPerBatch{16}; // The most mutations a hill climb hands to a batch mutator at once
+const std::uint32_t minPyramidSize{32}; // The smallest width or height that the images are shrunk to when searching a pyramid level
+const std::uint32_t tileOverlapDivisor{8}; // Tiles extend past their grid cell by this fraction of the tile size on every side, so shapes can straddle seams
+
+// The bounding box of a set of scanlines, inclusive
+struct Bounds
+{
+    std::int32_t x1;
+    std::int32_t y1;
+    std::int32_t x2;
+    std::int32_t y2;
+
+    bool overlaps(const Bounds& other) const
+    {
+        return x1 <= other.x2 && other.x1 <= x2 && y1 <= other.y2 && other.y1 <= y2;
+    }
+};
+
+Bounds getBounds(const std::vector<geometrize::Scanline>& lines)
+{
+    assert(!lines.empty());
+    Bounds bounds{lines.front().x1, lines.front().y, lines.front().x2, lines.front().y};
+    for(const geometrize::Scanline& line : lines) {
+        bounds.x1 = std::min(bounds.x1, line.x1);
+        bounds.y1 = std::min(bounds.y1, line.y);
+        bounds.x2 = std::max(bounds.x2, line.x2);
+        bounds.y2 = std::max(bounds.y2, line.y);
+    }
+    return bounds;
+}
+
+// A region of the image that is searched independently in tiled mode
+struct Tile
+{
+    geometrize::optimizer::TileRect rect; // The region of the full image covered by the tile, including its overlap
+    std::unique_ptr<geometrize::Model> model; // Cropped copies of the target and current images
+    std::unique_ptr<geometrize::Bitmap> buffer; // Scratch image for scoring candidates within the tile
+    geometrize::optimizer::IntegralImages integrals; // Summed-area tables of the cropped images, used to score rectangles
+    geometrize::optimizer::WeightMask mask; // The weight regions mapped onto the tile, used while weight regions are set
+    geometrize::optimizer::ErrorSampler sampler; // Places candidates by the error remaining within the tile, used while error-guided sampling is enabled
+};
+
+const std::vector<geometrize::ShapeTypes> allShapeTypes{
+    geometrize::RECTANGLE,
+    geometrize::ROTATED_RECTANGLE,
+    geometrize::TRIANGLE,
+    geometrize::ELLIPSE,
+    geometrize::ROTATED_ELLIPSE,
+    geometrize::CIRCLE,
+    geometrize::LINE,
+    geometrize::QUADRATIC_BEZIER,
+    geometrize::POLYLINE
+};
+
+std::vector<geometrize::ShapeTypes> getShapeTypes(const geometrize::ShapeTypes shapeTypes)
+{
+    std::vector<geometrize::ShapeTypes> types;
+    for(const geometrize::ShapeTypes type : allShapeTypes) {
+        if(static_cast<std::uint32_t>(shapeTypes) & static_cast<std::uint32_t>(type)) {
+            types.push_back(type);
+        }
+    }
+    return types;
+}
+
+// Mixes a 64-bit value, the finalizer of the SplitMix64 generator
+std::uint64_t mix(std::uint64_t z)
+{
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Derives the seed of a random number stream from the user's seed, the step number and the index of the stream within the step
+// Every candidate and hill climb gets its own stream, so the shapes found do not depend on which thread does the work or in what order
+std::uint32_t getStreamSeed(const std::uint32_t seed, const std::uint64_t step, const std::uint64_t stream)
+{
+    return static_cast<std::uint32_t>(mix(mix(mix(seed) ^ step) ^ stream));
+}
+
+// Names a concrete shape type, so that generic lambdas can be instantiated once per type
+template<typename T>
+struct ShapeTag
+{
+    using type = T;
+};
+
+// Calls the function with the tag of the concrete shape type. Each instantiation of the function sees a concrete type,
+// so the calls it makes to shape methods are direct rather than virtual, and the compiler can inline the scoring code around them
+template<typename F>
+auto dispatchShapeType(const geometrize::ShapeTypes type, F&& f) -> decltype(f(ShapeTag<geometrize::Rectangle>{}))
+{
+    switch(type) {
+    case geometrize::RECTANGLE:
+        return f(ShapeTag<geometrize::Rectangle>{});
+    case geometrize::ROTATED_RECTANGLE:
+        return f(ShapeTag<geometrize::RotatedRectangle>{});
+    case geometrize::TRIANGLE:
+        return f(ShapeTag<geometrize::Triangle>{});
+    case geometrize::ELLIPSE:
+        return f(ShapeTag<geometrize::Ellipse>{});
+    case geometrize::ROTATED_ELLIPSE:
+        return f(ShapeTag<geometrize::RotatedEllipse>{});
+    case geometrize::CIRCLE:
+        return f(ShapeTag<geometrize::Circle>{});
+    case geometrize::LINE:
+        return f(ShapeTag<geometrize::Line>{});
+    case geometrize::QUADRATIC_BEZIER:
+        return f(ShapeTag<geometrize::QuadraticBezier>{});
+    case geometrize::POLYLINE:
+        return f(ShapeTag<geometrize::Polyline>{});
+    default:
+        assert(0 && "Bad shape type requested");
+        return f(ShapeTag<geometrize::Rectangle>{});
+    }
+}
+
+// Candidate shapes only live for the duration of a step, so they are allocated from the arena of the task that creates them
+template<typename T>
+std::shared_ptr<T> createShape(const geometrize::Model& model, geometrize::optimizer::Arena& arena)
+{
+    std::shared_ptr<T> shape{std::allocate_shared<T>(geometrize::optimizer::ArenaAllocator<T>(arena), model)};
+    shape->T::setup();
+    return shape;
+}
+
+// Copies a shape into an arena, in place of Shape::clone which always goes to the heap
+template<typename T>
+std::shared_ptr<T> cloneShape(const T& shape, geometrize::optimizer::Arena& arena)
+{
+    return std::allocate_shared<T>(geometrize::optimizer::ArenaAllocator<T>(arena), shape);
+}
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+class Stepper::StepperImpl
+{
+public:
+    StepperImpl(geometrize::Model& model) : m_model{model}, m_pool{getSharedThreadPool()}, m_stepIndex{0U}, m_pyramidDepth{0U}, m_pyramidFactor{1U}, m_tileSize{0U}, m_tiledSize{0U}, m_errorGuided{false}, m_searchesPerStep{4U}, m_batchMutator{nullptr}
+    {
+    }
+    ~StepperImpl() = default;
+    StepperImpl& operator=(const StepperImpl&) = delete;
+    StepperImpl(const StepperImpl&) = delete;
+
+    std::vector<geometrize::ShapeResult> step(const geometrize::ImageRunnerOptions& options, const CancellationToken& token)
+    {
+        const std::vector<geometrize::ShapeTypes> types{getShapeTypes(options.shapeTypes)};
+        if(types.empty() || token.isCancelled()) {
+            return {};
+        }
+        m_cancellation = token;
+
+        ensureErrorMap();
+        ensureTiles();
+        ensurePyramid();
+        ensureMasks();
+        ensureSamplers();
+        ensureIntegrals(options.shapeTypes);
+
+        if(!m_tiles.empty()) {
+            return stepTiles(options, types);
+        }
+
+        // When a pyramid level is in use the search runs on the shrunk images, and only the final refinement runs at full resolution
+        const geometrize::Model& searchModel{m_pyramidModel ? *m_pyramidModel : m_model};
+        const IntegralImages& searchIntegrals{m_pyramidModel ? m_pyramidIntegrals : m_integrals};
+        const WeightMask& searchMask{m_pyramidModel ? m_pyramidMask : m_mask};
+        const ErrorSampler& searchSampler{m_pyramidModel ? m_pyramidSampler : m_sampler};
+
+        // Each search is a random sample of candidates followed by a hill climb from the best of them
+        // The samples are split into small tasks and the climbs run one per task, so the pool can balance uneven work
+        // The amount of work and the random streams are fixed by the options alone, so results are identical for any thread count
+        const std::size_t shapeCount{std::max(1U, options.shapeCount)};
+        const std::size_t searchesPerStep{m_searchesPerStep};
+        const std::size_t candidateCount{searchesPerStep * shapeCount};
+        const std::size_t tasksPerSearch{(shapeCount + candidatesPerTask - 1) / candidatesPerTask};
+        const std::size_t sampleTaskCount{searchesPerStep * tasksPerSearch};
+        const std::size_t concurrency{std::max(1U, options.maxThreads)};
+        const std::uint32_t seed{options.seed};
+        const std::uint64_t step{m_stepIndex};
+
+        prepareBuffers(m_buffers, concurrency, searchModel);
+        prepareArenas(concurrency);
+
+        std::vector<Candidate> samples(sampleTaskCount);
+        m_pool.parallelFor(sampleTaskCount, concurrency, [&](const std::size_t task, const std::size_t slot) {
+            const std::size_t search{task / tasksPerSearch};
+            const std::size_t offset{(task % tasksPerSearch) * candidatesPerTask};
+            const std::size_t first{search * shapeCount + offset};
+            const std::size_t count{std::min(candidatesPerTask, shapeCount - offset)};
+            samples[task] = bestRandomCandidate(searchModel, searchIntegrals, searchMask, searchSampler, types, options.alpha, seed, step, first, count, *m_buffers[slot], *m_arenas[slot]);
+        });
+        if(m_cancellation.isCancelled()) {
+            return {};
+        }
+
+        std::vector<Candidate> candidates(searchesPerStep);
+        m_pool.parallelFor(searchesPerStep, concurrency, [&](const std::size_t search, const std::size_t slot) {
+            // Ties go to the earliest task, so the starting point of the climb never depends on scheduling
+            const auto first = samples.begin() + static_cast<std::ptrdiff_t>(search * tasksPerSearch);
+            const auto start = std::min_element(first, first + static_cast<std::ptrdiff_t>(tasksPerSearch), [](const Candidate& a, const Candidate& b) {
+                return a.delta < b.delta;
+            });
+            geometrize::commonutil::seedRandomGenerator(getStreamSeed(seed, step, candidateCount + search));
+            candidates[search] = hillClimb(searchModel, searchIntegrals, searchMask, *start, options, *m_buffers[slot], *m_arenas[slot]);
+        });
+        if(m_cancellation.isCancelled()) {
+            return {};
+        }
+
+        const auto best = std::min_element(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.delta < b.delta;
+        });
+
+        Candidate chosen{*best};
+        if(m_pyramidModel) {
+            geometrize::commonutil::seedRandomGenerator(getStreamSeed(seed, step, candidateCount + searchesPerStep));
+            chosen = refine(*best, options);
+            if(m_cancellation.isCancelled()) {
+                return {};
+            }
+        }
+
+        // The chosen shape outlives the step, so it is moved out of the arenas before they are reused
+        const std::shared_ptr<geometrize::Shape> shape{chosen.shape->clone()};
+        const std::vector<geometrize::Scanline> lines{rasterize(m_model, *shape)};
+        const geometrize::rgba color{computeShapeColor(m_model, m_integrals, m_mask, *shape, lines, options.alpha)};
+
+        // Only steps that draw use up a step index, so cancelled steps leave the random streams where a resumed run expects them
+        m_stepIndex++;
+        return { drawShape(shape, color, lines) };
+    }
+
+    geometrize::ShapeResult drawShape(std::shared_ptr<geometrize::Shape> shape, const geometrize::rgba color)
+    {
+        ensureErrorMap();
+        ensureTiles();
+        ensurePyramid();
+        return drawShape(shape, color, rasterize(m_model, *shape));
+    }
+
+    float getScore()
+    {
+        ensureErrorMap();
+        return m_errorMap.getScore();
+    }
+
+    const ErrorMap& getErrorMap()
+    {
+        ensureErrorMap();
+        return m_errorMap;
+    }
+
+    void reset()
+    {
+        m_errorMap.invalidate();
+        m_integrals.invalidate();
+        m_pyramidIntegrals.invalidate();
+        m_mask.invalidate();
+        m_pyramidMask.invalidate();
+        m_pyramidModel.reset();
+        m_tiles.clear();
+    }
+
+    void setPyramidDepth(const std::uint32_t depth)
+    {
+        m_pyramidDepth = depth;
+    }
+
+    std::uint32_t getPyramidDepth() const
+    {
+        return m_pyramidDepth;
+    }
+
+    void setTileSize(const std::uint32_t tileSize)
+    {
+        m_tileSize = tileSize;
+    }
+
+    std::uint32_t getTileSize() const
+    {
+        return m_tileSize;
+    }
+
+    void setWeightRegions(const std::vector<WeightRegion>& regions)
+    {
+        if(regions == m_weightRegions) {
+            return;
+        }
+        m_weightRegions = regions;
+        m_mask.invalidate();
+        m_pyramidMask.invalidate();
+        for(Tile& tile : m_tiles) {
+            tile.mask.invalidate();
+        }
+    }
+
+    const std::vector<WeightRegion>& getWeightRegions() const
+    {
+        return m_weightRegions;
+    }
+
+    void setErrorGuidedSamplingEnabled(const bool enabled)
+    {
+        m_errorGuided = enabled;
+    }
+
+    bool isErrorGuidedSamplingEnabled() const
+    {
+        return m_errorGuided;
+    }
+
+    void setSearchesPerStep(const std::uint32_t searches)
+    {
+        m_searchesPerStep = std::max(1U, searches);
+    }
+
+    std::uint32_t getSearchesPerStep() const
+    {
+        return m_searchesPerStep;
+    }
+
+    void setBatchMutator(BatchMutator* mutator)
+    {
+        m_batchMutator = mutator;
+    }
+
+    BatchMutator* getBatchMutator() const
+    {
+        return m_batchMutator;
+    }
+
+    std::uint64_t getStepIndex() const
+    {
+        return m_stepIndex;
+    }
+
+    void setStepIndex(const std::uint64_t stepIndex)
+    {
+        m_stepIndex = stepIndex;
+    }
+
+    Arena::Statistics getAllocationStatistics() const
+    {
+        Arena::Statistics total;
+        for(const std::unique_ptr<Arena>& arena : m_arenas) {
+            const Arena::Statistics stats{arena->getStatistics()};
+            total.allocations += stats.allocations;
+            total.blockAllocations += stats.blockAllocations;
+            total.resets += stats.resets;
+            total.bytesReserved += stats.bytesReserved;
+        }
+        return total;
+    }
+
+private:
+    void ensureErrorMap()
+    {
+        if(!m_errorMap.isValid()) {
+            m_errorMap.reset(m_model.getTarget(), m_model.getCurrent());
+        }
+    }
+
+    void ensureTiles()
+    {
+        // Tiling only pays off when the image spans more than one tile
+        const std::uint32_t width{m_model.getTarget().getWidth()};
+        const std::uint32_t height{m_model.getTarget().getHeight()};
+        if(m_tileSize == 0 || (width <= m_tileSize && height <= m_tileSize)) {
+            m_tiles.clear();
+            return;
+        }
+        if(!m_tiles.empty() && m_tiledSize == m_tileSize) {
+            return;
+        }
+
+        m_tiles.clear();
+        m_tiledSize = m_tileSize;
+        for(const TileRect& rect : createTiles(width, height, m_tileSize, m_tileSize / tileOverlapDivisor)) {
+            Tile tile;
+            tile.rect = rect;
+            tile.model = std::make_unique<geometrize::Model>(crop(m_model.getTarget(), rect), crop(m_model.getCurrent(), rect));
+            tile.buffer = std::make_unique<geometrize::Bitmap>(rect.width, rect.height, geometrize::rgba{0, 0, 0, 0});
+            m_tiles.push_back(std::move(tile));
+        }
+    }
+
+    void ensurePyramid()
+    {
+        // Go as deep as requested, but stop before the images get so small that shapes lose all detail
+        const std::uint32_t width{m_model.getTarget().getWidth()};
+        const std::uint32_t height{m_model.getTarget().getHeight()};
+        std::uint32_t level{0};
+        while(m_tiles.empty() && level < m_pyramidDepth && std::min(width, height) >> (level + 1) >= minPyramidSize) {
+            level++;
+        }
+
+        const std::uint32_t factor{1U << level};
+        if(factor == 1) {
+            m_pyramidModel.reset();
+            m_pyramidIntegrals.invalidate();
+            m_pyramidMask.invalidate();
+        } else if(!m_pyramidModel || factor != m_pyramidFactor) {
+            m_pyramidModel = std::make_unique<geometrize::Model>(downsample(m_model.getTarget(), factor), downsample(m_model.getCurrent(), factor));
+            m_pyramidIntegrals.invalidate();
+            m_pyramidMask.invalidate();
+        }
+        m_pyramidFactor = factor;
+    }
+
+    void ensureMasks()
+    {
+        if(m_weightRegions.empty()) {
+            m_mask.invalidate();
+            m_pyramidMask.invalidate();
+            for(Tile& tile : m_tiles) {
+                tile.mask.invalidate();
+            }
+            return;
+        }
+
+        // Every image that is searched gets the regions mapped onto it, the full size mask is also needed to refine and color the chosen shape
+        if(!m_mask.isValid()) {
+            m_mask.reset(m_model.getTarget().getWidth(), m_model.getTarget().getHeight(), m_weightRegions);
+        }
+        if(m_pyramidModel && !m_pyramidMask.isValid()) {
+            m_pyramidMask.reset(m_pyramidModel->getTarget().getWidth(), m_pyramidModel->getTarget().getHeight(), m_weightRegions, m_pyramidFactor);
+        }
+        for(Tile& tile : m_tiles) {
+            if(!tile.mask.isValid()) {
+                tile.mask.reset(tile.rect.width, tile.rect.height, m_weightRegions, 1, static_cast<std::int32_t>(tile.rect.x), static_cast<std::int32_t>(tile.rect.y));
+            }
+        }
+    }
+
+    void ensureSamplers()
+    {
+        // The error changes with every shape drawn, so the samplers are rebuilt each step, which only visits the error map tiles
+        if(!m_errorGuided) {
+            m_sampler.invalidate();
+            m_pyramidSampler.invalidate();
+            for(Tile& tile : m_tiles) {
+                tile.sampler.invalidate();
+            }
+            return;
+        }
+
+        m_sampler.reset(m_errorMap, m_model.getTarget().getWidth(), m_model.getTarget().getHeight());
+        if(m_pyramidModel) {
+            m_pyramidSampler.reset(m_errorMap, m_pyramidModel->getTarget().getWidth(), m_pyramidModel->getTarget().getHeight(), m_pyramidFactor);
+        } else {
+            m_pyramidSampler.invalidate();
+        }
+        for(Tile& tile : m_tiles) {
+            tile.sampler.reset(m_errorMap, tile.rect.width, tile.rect.height, 1, tile.rect.x, tile.rect.y);
+        }
+    }
+
+    void ensureIntegrals(const geometrize::ShapeTypes shapeTypes)
+    {
+        // The tables are only worth their memory and upkeep when rectangles are being searched for, and they cannot see weight regions
+        if(!(static_cast<std::uint32_t>(shapeTypes) & static_cast<std::uint32_t>(geometrize::RECTANGLE)) || !m_weightRegions.empty()) {
+            m_integrals.invalidate();
+            m_pyramidIntegrals.invalidate();
+            for(Tile& tile : m_tiles) {
+                tile.integrals.invalidate();
+            }
+            return;
+        }
+
+        // Tiles and pyramid levels search their own images, the full size tables are still needed to refine and color the chosen shape
+        if(!m_integrals.isValid()) {
+            m_integrals.reset(m_model.getTarget(), m_model.getCurrent());
+        }
+        if(m_pyramidModel && !m_pyramidIntegrals.isValid()) {
+            m_pyramidIntegrals.reset(m_pyramidModel->getTarget(), m_pyramidModel->getCurrent());
+        }
+        for(Tile& tile : m_tiles) {
+            if(!tile.integrals.isValid()) {
+                tile.integrals.reset(tile.model->getTarget(), tile.model->getCurrent());
+            }
+        }
+    }
+
+    std::vector<geometrize::Scanline> rasterize(const geometrize::Model& model, const geometrize::Shape& shape) const
+    {
+        std::vector<geometrize::Scanline> lines{shape.rasterize()};
+        trimScanlines(lines, model.getCurrent().getWidth(), model.getCurrent().getHeight());
+        return lines;
+    }
+
+    geometrize::ShapeResult drawShape(std::shared_ptr<geometrize::Shape> shape, const geometrize::rgba color, const std::vector<geometrize::Scanline>& lines)
+    {
+        // Only the pixels under the shape change, so only their contribution to the error needs recalculating
+        // The shape is blended from the scanlines already in hand rather than through Model::drawShape, which copies the whole image and rescores it
+        m_errorMap.removeLines(m_model.getTarget(), m_model.getCurrent(), lines);
+        drawLines(m_model.getCurrent(), color, lines);
+        m_errorMap.addLines(m_model.getTarget(), m_model.getCurrent(), lines);
+
+        // Likewise only the parts of the shrunk and cropped current images that lie under the shape need to be refreshed
+        if(!lines.empty()) {
+            const Bounds bounds{getBounds(lines)};
+            m_integrals.update(m_model.getTarget(), m_model.getCurrent(), bounds.x1, bounds.y1, bounds.x2, bounds.y2);
+            if(m_pyramidModel) {
+                const std::uint32_t firstRow{static_cast<std::uint32_t>(bounds.y1) / m_pyramidFactor};
+                const std::uint32_t lastRow{static_cast<std::uint32_t>(bounds.y2) / m_pyramidFactor};
+                downsampleRows(m_model.getCurrent(), m_pyramidModel->getCurrent(), m_pyramidFactor, firstRow, lastRow);
+                const std::int32_t factor{static_cast<std::int32_t>(m_pyramidFactor)};
+                m_pyramidIntegrals.update(m_pyramidModel->getTarget(), m_pyramidModel->getCurrent(), bounds.x1 / factor, bounds.y1 / factor, bounds.x2 / factor, bounds.y2 / factor);
+            }
+            for(Tile& tile : m_tiles) {
+                updateCrop(m_model.getCurrent(), tile.model->getCurrent(), tile.rect, bounds.x1, bounds.y1, bounds.x2, bounds.y2);
+                const std::int32_t tileX{static_cast<std::int32_t>(tile.rect.x)};
+                const std::int32_t tileY{static_cast<std::int32_t>(tile.rect.y)};
+                tile.integrals.update(tile.model->getTarget(), tile.model->getCurrent(), bounds.x1 - tileX, bounds.y1 - tileY, bounds.x2 - tileX, bounds.y2 - tileY);
+            }
+        }
+
+        return geometrize::ShapeResult{m_errorMap.getScore(), color, shape};
+    }
+
+    std::int64_t scoreShape(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, const geometrize::Shape& shape, const std::uint8_t alpha, geometrize::Bitmap& buffer) const
+    {
+        return dispatchShapeType(shape.getType(), [&](const auto tag) {
+            using T = typename decltype(tag)::type;
+            return scoreShape<T>(model, integrals, mask, static_cast<const T&>(shape), alpha, buffer);
+        });
+    }
+
+    template<typename T>
+    std::int64_t scoreShape(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, const T& shape, const std::uint8_t alpha, geometrize::Bitmap& buffer) const
+    {
+        std::vector<geometrize::Scanline> lines{shape.T::rasterize()};
+        trimScanlines(lines, model.getCurrent().getWidth(), model.getCurrent().getHeight());
+        if(mask.isValid()) {
+            return scoreLines(model, mask, lines, alpha, buffer);
+        }
+        if(std::is_same<T, geometrize::Rectangle>::value && integrals.isValid()) {
+            // Rectangles are scored from the summed-area tables without touching their pixels
+            if(lines.empty()) {
+                return 0;
+            }
+            const Bounds bounds{getBounds(lines)};
+            return integrals.energyDelta(bounds.x1, bounds.y1, bounds.x2, bounds.y2, alpha);
+        }
+        return energyDelta(lines, alpha, model.getTarget(), model.getCurrent(), buffer);
+    }
+
+    // Scores scanlines against the pixels of the mask alone, so the work done is proportional to the part of the shape that lies within the weight regions
+    std::int64_t scoreLines(const geometrize::Model& model, const WeightMask& mask, const std::vector<geometrize::Scanline>& lines, const std::uint8_t alpha, geometrize::Bitmap& buffer) const
+    {
+        if(!mask.isValid()) {
+            return energyDelta(lines, alpha, model.getTarget(), model.getCurrent(), buffer);
+        }
+        std::vector<geometrize::Scanline> clipped;
+        std::vector<std::uint8_t> weights;
+        mask.clip(lines, clipped, weights);
+        if(clipped.empty()) {
+            return 0;
+        }
+        if(mask.isUniform()) {
+            return energyDelta(clipped, alpha, model.getTarget(), model.getCurrent(), buffer);
+        }
+        return energyDelta(clipped, weights, alpha, model.getTarget(), model.getCurrent(), buffer);
+    }
+
+    geometrize::rgba computeShapeColor(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, const geometrize::Shape& shape,
+                                       const std::vector<geometrize::Scanline>& lines, const std::uint8_t alpha) const
+    {
+        // Shapes are colored to match the weight regions they cover, falling back to the whole shape when it lies entirely outside them
+        if(mask.isValid()) {
+            std::vector<geometrize::Scanline> clipped;
+            std::vector<std::uint8_t> weights;
+            mask.clip(lines, clipped, weights);
+            if(!clipped.empty()) {
+                return computeColor(model.getTarget(), model.getCurrent(), clipped, alpha);
+            }
+        }
+        if(integrals.isValid() && shape.getType() == geometrize::RECTANGLE && !lines.empty()) {
+            const Bounds bounds{getBounds(lines)};
+            return integrals.computeColor(bounds.x1, bounds.y1, bounds.x2, bounds.y2, alpha);
+        }
+        return computeColor(model.getTarget(), model.getCurrent(), lines, alpha);
+    }
+
+    void prepareArenas(const std::size_t count)
+    {
+        // Every shape allocated during the last step has been released by now, so the arenas can start over
+        while(m_arenas.size() < count) {
+            m_arenas.push_back(std::make_unique<Arena>());
+        }
+        for(std::unique_ptr<Arena>& arena : m_arenas) {
+            arena->reset();
+        }
+    }
+
+    void prepareBuffers(std::vector<std::unique_ptr<geometrize::Bitmap>>& buffers, const std::size_t count, const geometrize::Model& model) const
+    {
+        // Scratch images only need the right dimensions, energyDelta copies the pixels it needs from the current image
+        const geometrize::Bitmap& current{model.getCurrent()};
+        if(buffers.size() < count) {
+            buffers.resize(count);
+        }
+        for(std::unique_ptr<geometrize::Bitmap>& buffer : buffers) {
+            if(!buffer || buffer->getWidth() != current.getWidth() || buffer->getHeight() != current.getHeight()) {
+                buffer = std::make_unique<geometrize::Bitmap>(current.getWidth(), current.getHeight(), geometrize::rgba{0, 0, 0, 0});
+            }
+        }
+    }
+
+    std::vector<geometrize::ShapeResult> stepTiles(const geometrize::ImageRunnerOptions& options, const std::vector<geometrize::ShapeTypes>& types)
+    {
+        // Every tile runs one search of its own against a snapshot of its region, one task per tile
+        const std::size_t shapeCount{std::max(1U, options.shapeCount)};
+        const std::size_t concurrency{std::max(1U, options.maxThreads)};
+        const std::uint64_t streamsPerTile{shapeCount + 1};
+        const std::uint32_t seed{options.seed};
+        const std::uint64_t step{m_stepIndex};
+
+        prepareArenas(concurrency);
+
+        std::vector<Candidate> found(m_tiles.size());
+        m_pool.parallelFor(m_tiles.size(), concurrency, [&](const std::size_t index, const std::size_t slot) {
+            Tile& tile{m_tiles[index]};
+            if(tile.mask.isValid() && tile.mask.getPixelCount() == 0) {
+                return; // Tiles outside every weight region have nothing to search
+            }
+            const std::uint64_t firstStream{index * streamsPerTile};
+            const Candidate sample{bestRandomCandidate(*tile.model, tile.integrals, tile.mask, tile.sampler, types, options.alpha, seed, step, firstStream, shapeCount, *tile.buffer, *m_arenas[slot])};
+            if(!sample.shape) {
+                return;
+            }
+            geometrize::commonutil::seedRandomGenerator(getStreamSeed(seed, step, firstStream + shapeCount));
+            found[index] = hillClimb(*tile.model, tile.integrals, tile.mask, sample, options, *tile.buffer, *m_arenas[slot]);
+        });
+        if(m_cancellation.isCancelled()) {
+            return {};
+        }
+
+        std::vector<std::size_t> order(found.size());
+        for(std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&found](const std::size_t a, const std::size_t b) {
+            return found[a].delta < found[b].delta;
+        });
+
+        // Stitch the tile results together, best first. The tiles were searched independently, so a shape that overlaps one drawn earlier in
+        // this step is dropped rather than drawn over it, and each shape is rescored on the full image because its overlap may reach past its tile
+        prepareBuffers(m_refineBuffers, 1, m_model);
+        geometrize::Bitmap& buffer{*m_refineBuffers.front()};
+        std::vector<Bounds> drawn;
+        std::vector<geometrize::ShapeResult> results;
+        for(const std::size_t index : order) {
+            if(!found[index].shape) {
+                continue; // Skipped for lying outside every weight region
+            }
+            const Tile& tile{m_tiles[index]};
+            std::shared_ptr<geometrize::Shape> shape{translateShape(*found[index].shape, m_model, static_cast<std::int32_t>(tile.rect.x), static_cast<std::int32_t>(tile.rect.y))};
+            const std::vector<geometrize::Scanline> lines{rasterize(m_model, *shape)};
+            if(lines.empty()) {
+                continue;
+            }
+
+            const Bounds bounds{getBounds(lines)};
+            const bool overlapsDrawn{std::any_of(drawn.begin(), drawn.end(), [&bounds](const Bounds& other) { return bounds.overlaps(other); })};
+            if(overlapsDrawn) {
+                continue;
+            }
+
+            // Always draw at least one shape per step, like the untiled search does
+            if(!results.empty() && scoreLines(m_model, m_mask, lines, options.alpha, buffer) >= 0) {
+                continue;
+            }
+
+            const geometrize::rgba color{computeShapeColor(m_model, m_integrals, m_mask, *shape, lines, options.alpha)};
+            results.push_back(drawShape(shape, color, lines));
+            drawn.push_back(bounds);
+        }
+        if(!results.empty()) {
+            m_stepIndex++;
+        }
+        return results;
+    }
+
+    Candidate refine(const Candidate& candidate, const geometrize::ImageRunnerOptions& options)
+    {
+        // Carry the shape found on the shrunk images up to full resolution and hill climb it there
+        prepareBuffers(m_refineBuffers, 1, m_model);
+        geometrize::Bitmap& buffer{*m_refineBuffers.front()};
+        std::shared_ptr<geometrize::Shape> shape{scaleShape(*candidate.shape, m_model, m_pyramidFactor)};
+        const Candidate scaled{shape, scoreShape(m_model, m_integrals, m_mask, *shape, options.alpha, buffer)};
+        return hillClimb(m_model, m_integrals, m_mask, scaled, options, buffer, *m_arenas.front());
+    }
+
+    Candidate bestRandomCandidate(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, const ErrorSampler& sampler, const std::vector<geometrize::ShapeTypes>& types, const std::uint8_t alpha,
+                                  const std::uint32_t seed, const std::uint64_t step, const std::size_t first, const std::size_t count, geometrize::Bitmap& buffer, Arena& arena) const
+    {
+        // A cancelled search stops early, possibly before any candidate was made, and its result is thrown away by the caller
+        Candidate best{nullptr, 0};
+        for(std::size_t i = 0; i < count && !m_cancellation.isCancelled(); i++) {
+            geometrize::commonutil::seedRandomGenerator(getStreamSeed(seed, step, first + i));
+            const geometrize::ShapeTypes type{types[geometrize::commonutil::randomRange(0, static_cast<std::int32_t>(types.size()) - 1)]};
+            const Candidate candidate{dispatchShapeType(type, [&](const auto tag) {
+                using T = typename decltype(tag)::type;
+                const std::shared_ptr<T> shape{createShape<T>(model, arena)};
+                placeShape(*shape, model, mask, sampler);
+                return Candidate{shape, scoreShape<T>(model, integrals, mask, *shape, alpha, buffer)};
+            })};
+            if(!best.shape || candidate.delta < best.delta) {
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    // Random shapes are spread over the whole image, so with weight regions set each one is moved onto a random pixel within them,
+    // and with error-guided sampling enabled each one is moved onto a pixel picked in proportion to the error remaining around it
+    // The point is drawn from the candidate's own random stream, so placement is as reproducible as the rest of the search
+    void placeShape(geometrize::Shape& shape, const geometrize::Model& model, const WeightMask& mask, const ErrorSampler& sampler) const
+    {
+        std::int32_t x{0};
+        std::int32_t y{0};
+        if(mask.isValid()) {
+            if(mask.randomPoint(x, y)) {
+                moveShape(shape, model, x, y);
+            }
+        } else if(sampler.isValid() && sampler.randomPoint(x, y)) {
+            moveShape(shape, model, x, y);
+        }
+    }
+
+    Candidate hillClimb(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, const Candidate& candidate, const geometrize::ImageRunnerOptions& options, geometrize::Bitmap& buffer, Arena& arena) const
+    {
+        // A climb never changes the type of its shape, so the type is looked up once and the whole loop is compiled for it
+        return dispatchShapeType(candidate.shape->getType(), [&](const auto tag) {
+            using T = typename decltype(tag)::type;
+            // Tile and pyramid models mutate with their own default mutators, so they never mix in a batch mutator meant for the full image
+            if(m_batchMutator && &model == &m_model && m_batchMutator->canMutate(candidate.shape->getType())) {
+                return batchHillClimb<T>(model, integrals, mask, std::static_pointer_cast<T>(candidate.shape), candidate.delta, options, buffer, arena);
+            }
+            return hillClimb<T>(model, integrals, mask, std::static_pointer_cast<T>(candidate.shape), candidate.delta, options, buffer, arena);
+        });
+    }
+
+    template<typename T>
+    Candidate hillClimb(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, std::shared_ptr<T> best, std::int64_t bestDelta,
+                        const geometrize::ImageRunnerOptions& options, geometrize::Bitmap& buffer, Arena& arena) const
+    {
+        std::uint32_t age{0};
+        while(age < options.maxShapeMutations && !m_cancellation.isCancelled()) {
+            std::shared_ptr<T> shape{cloneShape(*best, arena)};
+            shape->T::mutate();
+            const std::int64_t delta{scoreShape<T>(model, integrals, mask, *shape, options.alpha, buffer)};
+            if(delta < bestDelta) {
+                best = std::move(shape);
+                bestDelta = delta;
+                age = 0;
+            } else {
+                age++;
+            }
+        }
+        return Candidate{best, bestDelta};
+    }
+
+    // Like hillClimb, but every mutation in a batch starts from the best shape found before the batch, so the whole batch can be mutated in one call
+    // The climb takes the best improvement of each batch, and gives up after the same number of mutations in a row fail to improve on it
+    // Batch mutators may be scripts that keep or replace the shapes they are given, so they get shapes of their own on the heap rather than arena memory,
+    // returned shapes of another type are skipped, and the climb only ever keeps its own copies of the shapes it accepts
+    template<typename T>
+    Candidate batchHillClimb(const geometrize::Model& model, const IntegralImages& integrals, const WeightMask& mask, std::shared_ptr<T> best, std::int64_t bestDelta,
+                             const geometrize::ImageRunnerOptions& options, geometrize::Bitmap& buffer, Arena& arena) const
+    {
+        const geometrize::ShapeTypes type{best->getType()};
+        std::vector<std::shared_ptr<geometrize::Shape>> batch;
+        batch.reserve(mutationsPerBatch);
+
+        std::uint32_t age{0};
+        while(age < options.maxShapeMutations && !m_cancellation.isCancelled()) {
+            const std::size_t count{std::min<std::size_t>(mutationsPerBatch, options.maxShapeMutations - age)};
+            batch.clear();
+            for(std::size_t i = 0; i < count; i++) {
+                batch.push_back(std::make_shared<T>(*best));
+            }
+            m_batchMutator->mutate(batch);
+
+            std::shared_ptr<geometrize::Shape> batchBest;
+            std::int64_t batchBestDelta{bestDelta};
+            for(const std::shared_ptr<geometrize::Shape>& mutated : batch) {
+                if(!mutated || mutated->getType() != type) {
+                    continue;
+                }
+                const std::int64_t delta{scoreShape<T>(model, integrals, mask, static_cast<const T&>(*mutated), options.alpha, buffer)};
+                if(delta < batchBestDelta) {
+                    batchBest = mutated;
+                    batchBestDelta = delta;
+                }
+            }
+
+            if(batchBest) {
+                best = cloneShape(static_cast<const T&>(*batchBest), arena);
+                bestDelta = batchBestDelta;
+                age = 0;
+            } else {
+                age += static_cast<std::uint32_t>(count);
+            }
+        }
+        return Candidate{best, bestDelta};
+    }
+
+    geometrize::Model& m_model; ///> The model that the stepper adds shapes to
+    ThreadPool& m_pool; ///> The pool that candidate sampling and hill climbing run on
+    std::vector<std::unique_ptr<geometrize::Bitmap>> m_buffers; ///> Scratch images for scoring candidates, one per concurrent task
+    std::vector<std::unique_ptr<Arena>> m_arenas; ///> Memory for the candidate shapes of the current step, one arena per concurrent task
+    CancellationToken m_cancellation; ///> The token of the step in progress, checked between candidates and between mutations
+    std::vector<std::unique_ptr<geometrize::Bitmap>> m_refineBuffers; ///> Full resolution scratch image for refining shapes found on a pyramid level
+    ErrorMap m_errorMap; ///> Running per-row and per-tile squared error between the target and current images of the model
+    IntegralImages m_integrals; ///> Summed-area tables of the target and current images of the model, kept while rectangles are being searched for
+    IntegralImages m_pyramidIntegrals; ///> Summed-area tables of the images of the pyramid model, kept while rectangles are being searched for
+    std::uint64_t m_stepIndex; ///> The number of steps that have drawn shapes so far, mixed into the random streams so that consecutive steps do not repeat
+    std::uint32_t m_pyramidDepth; ///> The requested number of times to halve the images before searching, zero searches at full resolution
+    std::uint32_t m_pyramidFactor; ///> The factor the images of the pyramid model are shrunk by, one when no pyramid level is in use
+    std::uint32_t m_tileSize; ///> The requested spacing of the tile grid in tiled mode, zero disables tiling
+    std::uint32_t m_tiledSize; ///> The tile size the current tiles were created with
+    std::vector<Tile> m_tiles; ///> The tiles searched in tiled mode, empty when tiling is not in use
+    std::vector<WeightRegion> m_weightRegions; ///> The regions the search is restricted to and weighted by, empty to search the whole image
+    WeightMask m_mask; ///> The weight regions mapped onto the full size image, valid while weight regions are set
+    WeightMask m_pyramidMask; ///> The weight regions mapped onto the images of the pyramid model, valid while weight regions are set and a pyramid level is in use
+    bool m_errorGuided; ///> Whether random candidates are placed in proportion to the remaining error rather than uniformly
+    std::uint32_t m_searchesPerStep; ///> The number of independent searches per step, each sampling and then hill climbing its own candidate
+    ErrorSampler m_sampler; ///> Places candidates on the full size image by the remaining error, valid while error-guided sampling is enabled
+    ErrorSampler m_pyramidSampler; ///> Places candidates on the images of the pyramid model by the remaining error, valid while error-guided sampling is enabled and a pyramid level is in use
+    BatchMutator* m_batchMutator; ///> Mutates hill climbing candidates in batches for the shape types it supports, null to have every candidate mutate itself
+    std::unique_ptr<geometrize::Model> m_pyramidModel; ///> Model holding shrunk copies of the target and current images, searched instead of the full model when a pyramid level is in use
+};
+
+Stepper::Stepper(geometrize::Model& model) : d{std::make_unique<Stepper::StepperImpl>(model)}
+{
+}
+
+Stepper::~Stepper()
+{
+}
+
+std::vector<geometrize::ShapeResult> Stepper::step(const geometrize::ImageRunnerOptions& options, const CancellationToken& token)
+{
+    return d->step(options, token);
+}
+
+geometrize::ShapeResult Stepper::drawShape(std::shared_ptr<geometrize::Shape> shape, const geometrize::rgba color)
+{
+    return d->drawShape(shape, color);
+}
+
+float Stepper::getScore()
+{
+    return d->getScore();
+}
+
+const ErrorMap& Stepper::getErrorMap()
+{
+    return d->getErrorMap();
+}
+
+void Stepper::reset()
+{
+    d->reset();
+}
+
+void Stepper::setPyramidDepth(const std::uint32_t depth)
+{
+    d->setPyramidDepth(depth);
+}
+
+std::uint32_t Stepper::getPyramidDepth() const
+{
+    return d->getPyramidDepth();
+}
+
+void Stepper::setTileSize(const std::uint32_t tileSize)
+{
+    d->setTileSize(tileSize);
+}
+
+std::uint32_t Stepper::getTileSize() const
+{
+    return d->getTileSize();
+}
+
+void Stepper::setWeightRegions(const std::vector<WeightRegion>& regions)
+{
+    d->setWeightRegions(regions);
+}
+
+const std::vector<WeightRegion>& Stepper::getWeightRegions() const
+{
+    return d->getWeightRegions();
+}
+
+void Stepper::setErrorGuidedSamplingEnabled(const bool enabled)
+{
+    d->setErrorGuidedSamplingEnabled(enabled);
+}
+
+bool Stepper::isErrorGuidedSamplingEnabled() const
+{
+    return d->isErrorGuidedSamplingEnabled();
+}
+
+void Stepper::setSearchesPerStep(const std::uint32_t searches)
+{
+    d->setSearchesPerStep(searches);
+}
+
+std::uint32_t Stepper::getSearchesPerStep() const
+{
+    return d->getSearchesPerStep();
+}
+
+void Stepper::setBatchMutator(BatchMutator* mutator)
+{
+    d->setBatchMutator(mutator);
+}
+
+BatchMutator* Stepper::getBatchMutator() const
+{
+    return d->getBatchMutator();
+}
+
+std::uint64_t Stepper::getStepIndex() const
+{
+    return d->getStepIndex();
+}
+
+void Stepper::setStepIndex(const std::uint64_t stepIndex)
+{
+    d->setStepIndex(stepIndex);
+}
+
+Arena::Statistics Stepper::getAllocationStatistics() const
+{
+    return d->getAllocationStatistics();
+}
+
+}
+
+}
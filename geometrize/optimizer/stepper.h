@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/runner/imagerunneroptions.h"
+#include "geometrize/shaperesult.h"
+
+#include "optimizer/arena.h"
+#include "optimizer/cancellation.h"
+#include "optimizer/weightmask.h"
+
+namespace geometrize
+{
+class Model;
+class Shape;
+
+namespace optimizer
+{
+class BatchMutator;
+class ErrorMap;
+}
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The Stepper class finds and adds shapes to a Geometrize model. It is a drop-in replacement for geometrize::ImageRunner::step.
+ * It follows the same random search and hill climbing algorithm, but scores candidates using the SIMD kernels in optimizer/kernels.h.
+ * Candidates are ranked by how much they change the squared error under their own scanlines, and the error of the whole image is tracked incrementally by an ErrorMap.
+ * While rectangles are among the shape types searched for, summed-area tables of the images let rectangles be colored and scored without visiting their pixels.
+ * Candidate sampling and hill climbing are split into small tasks that run on the process-wide thread pool, see optimizer/threadpool.h.
+ * Every candidate draws from its own random stream, derived from the seed, the step number and the candidate index, so the shapes found are the same for any thread count.
+ * Sampling and hill climbing are compiled separately for each concrete shape type, chosen at runtime from the requested shape types, so the inner loops make direct calls to the shape methods.
+ * Candidate shapes are allocated from per-task arenas that are recycled every step, so sampling and hill climbing do not contend on the heap.
+ * With a pyramid depth set, the search runs on shrunk copies of the images and only the chosen shape is refined at full resolution.
+ * With a tile size set, large images are split into overlapping tiles that are searched in parallel, and each step may add one shape per tile.
+ * With weight regions set, candidates are placed within the regions and only the pixels inside them are scored, each weighted by its importance.
+ * With a batch mutator set, hill climbs for the shape types it supports mutate their candidates in batches, see optimizer/batchmutator.h.
+ */
+class Stepper
+{
+public:
+    /**
+     * @brief Stepper Creates a new stepper.
+     * @param model The model the stepper will add shapes to. The stepper does not take ownership of the model.
+     */
+    explicit Stepper(geometrize::Model& model);
+    Stepper& operator=(const Stepper&) = delete;
+    Stepper(const Stepper&) = delete;
+    ~Stepper();
+
+    /**
+     * @brief step Finds the best shape for the current state of the model and draws it to the model.
+     * @param options The options to use when finding the shape. The maximum thread count only limits how many threads work on the step, it does not change the result.
+     * @param token A token that aborts the search when cancelled. It is checked between candidates and between mutations, so a step stops within milliseconds.
+     * @return The shapes that were added to the model, or nothing if the step was cancelled, in which case the model is left unchanged.
+     */
+    std::vector<geometrize::ShapeResult> step(const geometrize::ImageRunnerOptions& options, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief drawShape Draws a shape with the given color to the model.
+     * @param shape The shape to draw.
+     * @param color The color of the shape.
+     * @return The result of drawing the shape.
+     */
+    geometrize::ShapeResult drawShape(std::shared_ptr<geometrize::Shape> shape, geometrize::rgba color);
+
+    /**
+     * @brief getScore Gets the current difference between the target and current images of the model.
+     * This is read from the error map, so it does not need a pass over the images.
+     * @return The normalized difference between the images, in the range [0, 1].
+     */
+    float getScore();
+
+    /**
+     * @brief getErrorMap Gets the running squared error between the target and current images of the model.
+     * @return The error map.
+     */
+    const ErrorMap& getErrorMap();
+
+    /**
+     * @brief reset Discards the error map, so it is recalculated on next use. Call this after the target or current images are replaced.
+     */
+    void reset();
+
+    /**
+     * @brief setPyramidDepth Sets how many times the images are halved in size before searching for shapes.
+     * The stepper stops halving early if the images would become too small to search. Zero searches at full resolution.
+     * @param depth The pyramid depth.
+     */
+    void setPyramidDepth(std::uint32_t depth);
+
+    /**
+     * @brief getPyramidDepth Gets how many times the images are halved in size before searching for shapes.
+     * @return The pyramid depth.
+     */
+    std::uint32_t getPyramidDepth() const;
+
+    /**
+     * @brief setTileSize Sets the spacing of the tile grid used to search large images in parallel.
+     * Tiling takes precedence over the pyramid search, and has no effect on images that fit within a single tile. Zero disables tiling.
+     * @param tileSize The tile size, in pixels.
+     */
+    void setTileSize(std::uint32_t tileSize);
+
+    /**
+     * @brief getTileSize Gets the spacing of the tile grid used to search large images in parallel.
+     * @return The tile size, in pixels.
+     */
+    std::uint32_t getTileSize() const;
+
+    /**
+     * @brief setWeightRegions Sets the regions of the image that the search is restricted to and weighted by.
+     * Pixels outside every region are ignored when scoring shapes, so the search work shrinks with the area the regions cover.
+     * The error of the whole image is still tracked, so scores remain comparable with unrestricted searches. Rectangles lose their summed-area table scoring while regions are set.
+     * @param regions The weight regions, empty to search the whole image.
+     */
+    void setWeightRegions(const std::vector<WeightRegion>& regions);
+
+    /**
+     * @brief getWeightRegions Gets the regions of the image that the search is restricted to and weighted by.
+     * @return The weight regions, empty if the whole image is searched.
+     */
+    const std::vector<WeightRegion>& getWeightRegions() const;
+
+    /**
+     * @brief setErrorGuidedSamplingEnabled Sets whether random candidates are placed in proportion to the error that remains around them, rather than anywhere in the image.
+     * The error is read from the ErrorMap tiles, so it costs one visit per tile each step. Weight regions take precedence when they are set.
+     * @param enabled Whether candidate placement follows the remaining error.
+     */
+    void setErrorGuidedSamplingEnabled(bool enabled);
+
+    /**
+     * @brief isErrorGuidedSamplingEnabled Returns true if random candidates are placed in proportion to the error that remains around them.
+     * @return True if candidate placement follows the remaining error, else false.
+     */
+    bool isErrorGuidedSamplingEnabled() const;
+
+    /**
+     * @brief setSearchesPerStep Sets the number of independent searches per step, each sampling candidates and hill climbing the best of them.
+     * The searches run in parallel, so this bounds how many threads the hill climbs can use. It is not tied to the thread count, so a seed gives the same shapes on any machine.
+     * @param searches The number of searches per step, raised to one if zero.
+     */
+    void setSearchesPerStep(std::uint32_t searches);
+
+    /**
+     * @brief getSearchesPerStep Gets the number of independent searches per step.
+     * @return The number of searches per step.
+     */
+    std::uint32_t getSearchesPerStep() const;
+
+    /**
+     * @brief setBatchMutator Sets the mutator that hill climbs hand batches of candidates to, for the shape types it supports.
+     * Each batch of mutations starts from the best shape found before it, so results differ from those of a climb that mutates one candidate at a time.
+     * Only climbs on the full image use it, climbs on tiles and pyramid levels always mutate one candidate at a time.
+     * @param mutator The batch mutator, or null to have every candidate mutate itself. The stepper does not take ownership of the mutator.
+     */
+    void setBatchMutator(BatchMutator* mutator);
+
+    /**
+     * @brief getBatchMutator Gets the mutator that hill climbs hand batches of candidates to.
+     * @return The batch mutator, or null if every candidate mutates itself.
+     */
+    BatchMutator* getBatchMutator() const;
+
+    /**
+     * @brief getStepIndex Gets the number of steps that have drawn shapes so far, cancelled steps are not counted. The random numbers a step uses are derived from this and the seed alone.
+     * @return The step index.
+     */
+    std::uint64_t getStepIndex() const;
+
+    /**
+     * @brief setStepIndex Sets the number of steps taken so far, so that a model restored from a checkpoint continues with the same random numbers.
+     * @param stepIndex The step index.
+     */
+    void setStepIndex(std::uint64_t stepIndex);
+
+    /**
+     * @brief getAllocationStatistics Gets the combined allocation counters of the arenas that candidate shapes are allocated from.
+     * @return The allocation counters.
+     */
+    Arena::Statistics getAllocationStatistics() const;
+
+private:
+    class StepperImpl;
+    std::unique_ptr<StepperImpl> d;
+};
+
+}
+
+}
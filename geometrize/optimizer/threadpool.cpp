@@ -0,0 +1,329 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// A worker thread's queues of tasks and the counters used to report its utilization
+struct Worker
+{
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks; // Tasks that help run parallel loops
+    std::deque<std::function<void()>> detachedTasks; // Tasks queued by submit, which may run for as long as they like
+    std::atomic<std::uint64_t> tasksRun{0};
+    std::atomic<std::uint64_t> tasksStolen{0};
+    std::atomic<std::int64_t> busyNanoseconds{0};
+};
+
+// A parallel loop in progress
+struct Job
+{
+    Job(const std::size_t count, const std::function<void(std::size_t, std::size_t)>& f) : count{count}, f{f}
+    {
+    }
+
+    // Claims and runs iterations until there are none left
+    void run(const std::size_t slot)
+    {
+        for(std::size_t i = next++; i < count; i = next++) {
+            try {
+                f(i, slot);
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(!exception) {
+                    exception = std::current_exception();
+                }
+            }
+        }
+    }
+
+    const std::size_t count;
+    const std::function<void(std::size_t, std::size_t)>& f;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> remaining{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr exception;
+};
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+class ThreadPool::ThreadPoolImpl
+{
+public:
+    ThreadPoolImpl(const std::size_t threadCount) : m_startTime{std::chrono::steady_clock::now()}, m_stopping{false}, m_pending{0}, m_nextQueue{0}
+    {
+        const std::size_t count{std::max<std::size_t>(1U, threadCount)};
+        for(std::size_t i = 0; i < count; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+        for(std::size_t i = 0; i < count; i++) {
+            m_threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPoolImpl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for(std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    ThreadPoolImpl& operator=(const ThreadPoolImpl&) = delete;
+    ThreadPoolImpl(const ThreadPoolImpl&) = delete;
+
+    std::size_t getThreadCount() const
+    {
+        return m_workers.size();
+    }
+
+    void parallelFor(const std::size_t count, const std::size_t maxConcurrency, const std::function<void(std::size_t, std::size_t)>& f)
+    {
+        if(count == 0) {
+            return;
+        }
+
+        Job job(count, f);
+        const std::size_t helpers{std::min({ count, std::max<std::size_t>(1U, maxConcurrency), m_workers.size() + 1 }) - 1};
+        job.remaining = helpers;
+
+        for(std::size_t slot = 1; slot <= helpers; slot++) {
+            push([&job, slot]() {
+                job.run(slot);
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if(--job.remaining == 0) {
+                    job.done.notify_all();
+                }
+            });
+        }
+
+        job.run(0);
+
+        if(tl_pool == this) {
+            // Nested loop on a worker thread: keep running queued loop tasks instead of blocking, so the pool cannot deadlock on itself
+            // Detached tasks are left alone, as one that never returns would keep this loop from ever finishing
+            while(job.remaining != 0) {
+                if(!runOneTask(tl_workerIndex, false)) {
+                    std::this_thread::yield();
+                }
+            }
+            std::lock_guard<std::mutex> lock(job.mutex); // Wait for the last helper to let go of the job before it goes out of scope
+        } else {
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.done.wait(lock, [&job]() { return job.remaining == 0; });
+        }
+
+        if(job.exception) {
+            std::rethrow_exception(job.exception);
+        }
+    }
+
+    void submitTask(std::function<void()> task)
+    {
+        push(std::move(task), true);
+    }
+
+    ThreadPool::Statistics getStatistics() const
+    {
+        ThreadPool::Statistics stats;
+        stats.uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime);
+        for(const std::unique_ptr<Worker>& worker : m_workers) {
+            ThreadPool::WorkerStatistics w;
+            w.tasksRun = worker->tasksRun;
+            w.tasksStolen = worker->tasksStolen;
+            w.busyTime = std::chrono::nanoseconds(worker->busyNanoseconds.load());
+            stats.workers.push_back(w);
+        }
+        return stats;
+    }
+
+private:
+    void push(std::function<void()> task, const bool detached = false)
+    {
+        // Workers push to their own queue so related tasks stay on the same core, other threads spread tasks round-robin
+        const std::size_t queue{tl_pool == this ? tl_workerIndex : m_nextQueue++ % m_workers.size()};
+        {
+            std::lock_guard<std::mutex> lock(m_workers[queue]->mutex);
+            (detached ? m_workers[queue]->detachedTasks : m_workers[queue]->tasks).push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_pending++;
+        }
+        m_wake.notify_one();
+    }
+
+    bool popTask(const std::size_t index, std::function<void()>& task, bool& stolen, const bool includeDetached)
+    {
+        // Take the newest loop task from our own queue, else steal the oldest loop task from another worker
+        // Loop tasks go first, so loops that have started finish before detached tasks start more of them
+        {
+            Worker& own{*m_workers[index]};
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                stolen = false;
+                return true;
+            }
+        }
+        for(std::size_t i = 1; i < m_workers.size(); i++) {
+            Worker& victim{*m_workers[(index + i) % m_workers.size()]};
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                stolen = true;
+                return true;
+            }
+        }
+        if(!includeDetached) {
+            return false;
+        }
+
+        // Detached tasks run in the order they were queued
+        for(std::size_t i = 0; i < m_workers.size(); i++) {
+            Worker& victim{*m_workers[(index + i) % m_workers.size()]};
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.detachedTasks.empty()) {
+                task = std::move(victim.detachedTasks.front());
+                victim.detachedTasks.pop_front();
+                stolen = i != 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runOneTask(const std::size_t index, const bool includeDetached)
+    {
+        std::function<void()> task;
+        bool stolen{false};
+        if(!popTask(index, task, stolen, includeDetached)) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_pending--;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        task();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        Worker& worker{*m_workers[index]};
+        worker.tasksRun++;
+        if(stolen) {
+            worker.tasksStolen++;
+        }
+        worker.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        return true;
+    }
+
+    void workerLoop(const std::size_t index)
+    {
+        tl_pool = this;
+        tl_workerIndex = index;
+
+        while(true) {
+            if(runOneTask(index, true)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait(lock, [this]() { return m_stopping || m_pending != 0; });
+            if(m_stopping && m_pending == 0) {
+                return;
+            }
+        }
+    }
+
+    static thread_local ThreadPoolImpl* tl_pool; ///> The pool that owns the current thread, if any
+    static thread_local std::size_t tl_workerIndex; ///> The index of the current thread within its pool
+
+    const std::chrono::steady_clock::time_point m_startTime; ///> When the pool was created
+    std::vector<std::unique_ptr<Worker>> m_workers; ///> Task queues and counters for each worker thread
+    std::vector<std::thread> m_threads; ///> The worker threads
+    std::mutex m_wakeMutex; ///> Guards the pending task count and the stopping flag
+    std::condition_variable m_wake; ///> Wakes idle workers when tasks are submitted
+    bool m_stopping; ///> Whether the pool is shutting down
+    std::size_t m_pending; ///> The number of tasks queued but not yet started
+    std::atomic<std::size_t> m_nextQueue; ///> Round-robin counter for tasks submitted from outside the pool
+};
+
+thread_local ThreadPool::ThreadPoolImpl* ThreadPool::ThreadPoolImpl::tl_pool{nullptr};
+thread_local std::size_t ThreadPool::ThreadPoolImpl::tl_workerIndex{0};
+
+ThreadPool::ThreadPool(const std::size_t threadCount) : d{std::make_unique<ThreadPool::ThreadPoolImpl>(threadCount)}
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+}
+
+std::size_t ThreadPool::getThreadCount() const
+{
+    return d->getThreadCount();
+}
+
+void ThreadPool::parallelFor(const std::size_t count, const std::size_t maxConcurrency, const std::function<void(std::size_t, std::size_t)>& f)
+{
+    d->parallelFor(count, maxConcurrency, f);
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    d->submitTask(std::move(task));
+}
+
+ThreadPool::Statistics ThreadPool::getStatistics() const
+{
+    return d->getStatistics();
+}
+
+std::vector<float> computeUtilization(const ThreadPool::Statistics& earlier, const ThreadPool::Statistics& later)
+{
+    std::vector<float> utilization;
+    const double elapsed{static_cast<double>((later.uptime - earlier.uptime).count())};
+    for(std::size_t i = 0; i < later.workers.size(); i++) {
+        const std::chrono::nanoseconds before{i < earlier.workers.size() ? earlier.workers[i].busyTime : std::chrono::nanoseconds(0)};
+        const double busy{static_cast<double>((later.workers[i].busyTime - before).count())};
+        utilization.push_back(elapsed <= 0.0 ? 0.0f : static_cast<float>(std::min(1.0, std::max(0.0, busy / elapsed))));
+    }
+    return utilization;
+}
+
+ThreadPool& getSharedThreadPool()
+{
+    static ThreadPool pool(std::max(1U, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The ThreadPool class is a persistent pool of worker threads that share work by stealing tasks from each other's queues.
+ * Work is submitted as parallel loops whose iterations are claimed one at a time, so uneven iterations balance themselves across the pool.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief The WorkerStatistics struct records how much work a worker thread has done since the pool was created.
+     */
+    struct WorkerStatistics
+    {
+        std::uint64_t tasksRun{0}; ///< The number of tasks the worker has run.
+        std::uint64_t tasksStolen{0}; ///< The number of those tasks that were taken from another worker's queue.
+        std::chrono::nanoseconds busyTime{0}; ///< The total time the worker has spent running tasks.
+    };
+
+    /**
+     * @brief The Statistics struct is a snapshot of the work done by every worker thread in the pool.
+     */
+    struct Statistics
+    {
+        std::chrono::nanoseconds uptime{0}; ///< The time since the pool was created.
+        std::vector<WorkerStatistics> workers; ///< Statistics for each worker thread.
+    };
+
+    /**
+     * @brief ThreadPool Creates a thread pool and starts its worker threads.
+     * @param threadCount The number of worker threads, at least one thread is always created.
+     */
+    explicit ThreadPool(std::size_t threadCount);
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    /**
+     * @brief getThreadCount Gets the number of worker threads in the pool.
+     * @return The number of worker threads.
+     */
+    std::size_t getThreadCount() const;
+
+    /**
+     * @brief parallelFor Calls a function once for every index in [0, count), spreading the calls over the pool, and blocks until they have all returned.
+     * The calling thread takes part in the loop. If any call throws, the first exception is rethrown on the calling thread once the loop finishes.
+     * When called from a worker thread, the worker helps with queued loop iterations while it waits, but never with tasks queued by submit.
+     * @param count The number of iterations.
+     * @param maxConcurrency The maximum number of threads, including the calling thread, that may run iterations of this loop at the same time.
+     * @param f The function to call, with the iteration index and a slot index in [0, maxConcurrency) that is unique among the threads running the loop.
+     */
+    void parallelFor(std::size_t count, std::size_t maxConcurrency, const std::function<void(std::size_t index, std::size_t slot)>& f);
+
+    /**
+     * @brief submit Queues a function to run once on the pool, and returns without waiting for it.
+     * Exceptions must not escape the function. Submitting from a worker thread queues the function on that worker, where other workers may steal it.
+     * Submitted functions only run from a worker's own loop, never inline while a parallelFor waits, so they may run for as long as they like.
+     * @param task The function to run.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief getStatistics Gets a snapshot of the work done by the worker threads.
+     * @return The statistics for the pool.
+     */
+    Statistics getStatistics() const;
+
+private:
+    class ThreadPoolImpl;
+    std::unique_ptr<ThreadPoolImpl> d;
+};
+
+/**
+ * @brief computeUtilization Calculates the fraction of time each worker thread spent busy between two snapshots of a pool's statistics.
+ * @param earlier The earlier snapshot.
+ * @param later The later snapshot.
+ * @return The utilization of each worker thread, in the range [0, 1].
+ */
+std::vector<float> computeUtilization(const ThreadPool::Statistics& earlier, const ThreadPool::Statistics& later);
+
+/**
+ * @brief getSharedThreadPool Gets the process-wide thread pool that image tasks use to search for shapes, sized to the hardware.
+ * @return The shared thread pool.
+ */
+ThreadPool& getSharedThreadPool();
+
+}
+
+}
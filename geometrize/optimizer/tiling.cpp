@@ -0,0 +1,66 @@
+#include "tiling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+std::vector<TileRect> createTiles(const std::uint32_t width, const std::uint32_t height, const std::uint32_t tileSize, const std::uint32_t overlap)
+{
+    assert(tileSize > 0);
+    std::vector<TileRect> tiles;
+    for(std::uint32_t y = 0; y < height; y += tileSize) {
+        for(std::uint32_t x = 0; x < width; x += tileSize) {
+            const std::uint32_t x1{x > overlap ? x - overlap : 0};
+            const std::uint32_t y1{y > overlap ? y - overlap : 0};
+            const std::uint32_t x2{std::min(width, x + tileSize + overlap)};
+            const std::uint32_t y2{std::min(height, y + tileSize + overlap)};
+            tiles.push_back(TileRect{x1, y1, x2 - x1, y2 - y1});
+        }
+    }
+    return tiles;
+}
+
+geometrize::Bitmap crop(const geometrize::Bitmap& source, const TileRect& region)
+{
+    assert(region.x + region.width <= source.getWidth() && region.y + region.height <= source.getHeight());
+    geometrize::Bitmap destination(region.width, region.height, geometrize::rgba{0, 0, 0, 0});
+    updateCrop(source, destination, region, region.x, region.y, region.x + region.width - 1, region.y + region.height - 1);
+    return destination;
+}
+
+void updateCrop(const geometrize::Bitmap& source, geometrize::Bitmap& destination, const TileRect& region, const std::int32_t x1, const std::int32_t y1, const std::int32_t x2, const std::int32_t y2)
+{
+    // Clip the changed rectangle to the region
+    const std::int32_t left{std::max(x1, static_cast<std::int32_t>(region.x))};
+    const std::int32_t top{std::max(y1, static_cast<std::int32_t>(region.y))};
+    const std::int32_t right{std::min(x2, static_cast<std::int32_t>(region.x + region.width) - 1)};
+    const std::int32_t bottom{std::min(y2, static_cast<std::int32_t>(region.y + region.height) - 1)};
+    if(left > right || top > bottom) {
+        return;
+    }
+
+    const std::uint32_t sourceWidth{source.getWidth()};
+    const std::size_t rowBytes{static_cast<std::size_t>(right - left + 1) * 4U};
+    const std::uint8_t* in{source.getDataRef().data()};
+    std::uint8_t* out{destination.getDataRef().data()};
+    for(std::int32_t y = top; y <= bottom; y++) {
+        const std::size_t from{(static_cast<std::size_t>(y) * sourceWidth + static_cast<std::size_t>(left)) * 4U};
+        const std::size_t to{(static_cast<std::size_t>(y - region.y) * region.width + static_cast<std::size_t>(left - region.x)) * 4U};
+        std::memcpy(out + to, in + from, rowBytes);
+    }
+}
+
+}
+
+}
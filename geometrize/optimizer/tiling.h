@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The TileRect struct is a rectangular region of an image, in pixels.
+ */
+struct TileRect
+{
+    std::uint32_t x; ///< The left edge of the region.
+    std::uint32_t y; ///< The top edge of the region.
+    std::uint32_t width; ///< The width of the region.
+    std::uint32_t height; ///< The height of the region.
+};
+
+/**
+ * @brief createTiles Splits an image into a grid of tiles that overlap their neighbors.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param tileSize The spacing of the grid. Tiles at the right and bottom edges may be smaller.
+ * @param overlap The number of pixels each tile extends past the grid on every side, clamped to the image.
+ * @return The tiles, in row-major order.
+ */
+std::vector<TileRect> createTiles(std::uint32_t width, std::uint32_t height, std::uint32_t tileSize, std::uint32_t overlap);
+
+/**
+ * @brief crop Copies a region of an image into a new image.
+ * @param source The image to copy from.
+ * @param region The region to copy, which must lie within the image.
+ * @return The copied region.
+ */
+geometrize::Bitmap crop(const geometrize::Bitmap& source, const TileRect& region);
+
+/**
+ * @brief updateCrop Recopies the part of a cropped image that lies within a rectangle of the source image.
+ * @param source The full size image.
+ * @param destination An image previously created by cropping the source image.
+ * @param region The region of the source image the destination was cropped from.
+ * @param x1 The left edge of the rectangle that changed, in source image coordinates.
+ * @param y1 The top edge of the rectangle that changed, in source image coordinates.
+ * @param x2 The right edge of the rectangle that changed, inclusive.
+ * @param y2 The bottom edge of the rectangle that changed, inclusive.
+ */
+void updateCrop(const geometrize::Bitmap& source, geometrize::Bitmap& destination, const TileRect& region, std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2);
+
+}
+
+}
@@ -0,0 +1,187 @@
+#include "weightmask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "geometrize/commonutil.h"
+#include "geometrize/rasterizer/scanline.h"
+
+namespace
+{
+
+// Maps a full size image coordinate onto a shrunk or cropped image, rounding towards negative infinity so regions left of the image stay left of it
+std::int32_t mapCoordinate(const std::int32_t value, const std::int32_t offset, const std::int32_t factor)
+{
+    const std::int32_t shifted{value - offset};
+    return shifted >= 0 ? shifted / factor : -((-shifted + factor - 1) / factor);
+}
+
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+bool WeightRegion::operator==(const WeightRegion& other) const
+{
+    return shape == other.shape && x1 == other.x1 && y1 == other.y1 && x2 == other.x2 && y2 == other.y2 && weight == other.weight;
+}
+
+bool WeightRegion::operator!=(const WeightRegion& other) const
+{
+    return !(*this == other);
+}
+
+WeightMask::WeightMask() : m_width{0}, m_height{0}, m_valid{false}, m_uniform{true}
+{
+}
+
+void WeightMask::reset(const std::uint32_t width, const std::uint32_t height, const std::vector<WeightRegion>& regions,
+                       const std::uint32_t factor, const std::int32_t offsetX, const std::int32_t offsetY)
+{
+    m_width = width;
+    m_height = height;
+    m_valid = true;
+    m_uniform = true;
+    m_runs.clear();
+    m_rowRuns.assign(1, 0);
+    m_rowPixels.assign(1, 0);
+
+    const std::int32_t scale{static_cast<std::int32_t>(std::max(factor, 1U))};
+    const std::int32_t w{static_cast<std::int32_t>(width)};
+    std::vector<WeightRegion> mapped;
+    for(const WeightRegion& region : regions) {
+        WeightRegion m{region};
+        m.x1 = mapCoordinate(std::min(region.x1, region.x2), offsetX, scale);
+        m.y1 = mapCoordinate(std::min(region.y1, region.y2), offsetY, scale);
+        m.x2 = mapCoordinate(std::max(region.x1, region.x2), offsetX, scale);
+        m.y2 = mapCoordinate(std::max(region.y1, region.y2), offsetY, scale);
+        if(m.weight != 0) {
+            mapped.push_back(m);
+        }
+    }
+
+    // Each row is painted at full resolution and then run-length encoded, it is only done when the regions or images change
+    std::vector<std::uint8_t> row(width);
+    for(std::int32_t y = 0; y < static_cast<std::int32_t>(height); y++) {
+        std::fill(row.begin(), row.end(), 0);
+        for(const WeightRegion& region : mapped) {
+            if(y < region.y1 || y > region.y2) {
+                continue;
+            }
+            std::int32_t left{region.x1};
+            std::int32_t right{region.x2};
+            if(region.shape == WeightRegion::Shape::ELLIPSE) {
+                // The span of the ellipse through the middle of the row, measured from pixel centers
+                const double cx{(region.x1 + region.x2 + 1) * 0.5};
+                const double cy{(region.y1 + region.y2 + 1) * 0.5};
+                const double rx{(region.x2 - region.x1 + 1) * 0.5};
+                const double ry{(region.y2 - region.y1 + 1) * 0.5};
+                const double t{(y + 0.5 - cy) / ry};
+                const double half{rx * std::sqrt(std::max(0.0, 1.0 - t * t))};
+                left = static_cast<std::int32_t>(std::ceil(cx - half - 0.5));
+                right = static_cast<std::int32_t>(std::floor(cx + half - 0.5));
+            }
+            left = std::max(left, 0);
+            right = std::min(right, w - 1);
+            for(std::int32_t x = left; x <= right; x++) {
+                row[static_cast<std::size_t>(x)] = std::max(row[static_cast<std::size_t>(x)], region.weight);
+            }
+        }
+
+        std::uint64_t pixels{0};
+        std::int32_t x{0};
+        while(x < w) {
+            const std::uint8_t weight{row[static_cast<std::size_t>(x)]};
+            std::int32_t end{x};
+            while(end + 1 < w && row[static_cast<std::size_t>(end + 1)] == weight) {
+                end++;
+            }
+            if(weight != 0) {
+                m_runs.push_back(Run{x, end, weight});
+                m_uniform = m_uniform && weight == 255;
+                pixels += static_cast<std::uint64_t>(end - x + 1);
+            }
+            x = end + 1;
+        }
+        m_rowRuns.push_back(m_runs.size());
+        m_rowPixels.push_back(m_rowPixels.back() + pixels);
+    }
+}
+
+bool WeightMask::isValid() const
+{
+    return m_valid;
+}
+
+void WeightMask::invalidate()
+{
+    m_valid = false;
+}
+
+bool WeightMask::isUniform() const
+{
+    return m_uniform;
+}
+
+std::uint64_t WeightMask::getPixelCount() const
+{
+    return m_rowPixels.empty() ? 0 : m_rowPixels.back();
+}
+
+void WeightMask::clip(const std::vector<geometrize::Scanline>& lines, std::vector<geometrize::Scanline>& clipped, std::vector<std::uint8_t>& weights) const
+{
+    clipped.clear();
+    weights.clear();
+    for(const geometrize::Scanline& line : lines) {
+        if(line.y < 0 || line.y >= static_cast<std::int32_t>(m_height)) {
+            continue;
+        }
+        const auto first = m_runs.begin() + static_cast<std::ptrdiff_t>(m_rowRuns[static_cast<std::size_t>(line.y)]);
+        const auto last = m_runs.begin() + static_cast<std::ptrdiff_t>(m_rowRuns[static_cast<std::size_t>(line.y) + 1]);
+
+        // Runs are in order of column, so the first run that could overlap the line is found by its right edge
+        auto run = std::lower_bound(first, last, line.x1, [](const Run& r, const std::int32_t x) { return r.x2 < x; });
+        for(; run != last && run->x1 <= line.x2; ++run) {
+            clipped.push_back(geometrize::Scanline(line.y, std::max(run->x1, line.x1), std::min(run->x2, line.x2)));
+            weights.push_back(run->weight);
+        }
+    }
+}
+
+bool WeightMask::randomPoint(std::int32_t& x, std::int32_t& y) const
+{
+    const std::uint64_t total{getPixelCount()};
+    if(total == 0) {
+        return false;
+    }
+
+    const std::uint64_t limit{std::min<std::uint64_t>(total, static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max()))};
+    const std::uint64_t index{static_cast<std::uint64_t>(geometrize::commonutil::randomRange(0, static_cast<std::int32_t>(limit - 1)))};
+
+    // The row is the last one whose count of earlier pixels does not exceed the index, then the runs of that row are walked to the pixel
+    const auto rowEnd = std::upper_bound(m_rowPixels.begin(), m_rowPixels.end(), index);
+    const std::size_t row{static_cast<std::size_t>(rowEnd - m_rowPixels.begin()) - 1};
+    std::uint64_t remaining{index - m_rowPixels[row]};
+    for(std::size_t i = m_rowRuns[row]; i < m_rowRuns[row + 1]; i++) {
+        const Run& run{m_runs[i]};
+        const std::uint64_t length{static_cast<std::uint64_t>(run.x2 - run.x1 + 1)};
+        if(remaining < length) {
+            x = run.x1 + static_cast<std::int32_t>(remaining);
+            y = static_cast<std::int32_t>(row);
+            return true;
+        }
+        remaining -= length;
+    }
+    return false;
+}
+
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometrize
+{
+class Scanline;
+}
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+
+/**
+ * @brief The WeightRegion struct is an area of an image that matters to the user, with how much it matters.
+ */
+struct WeightRegion
+{
+    /**
+     * @brief The Shape enum specifies the outline of a region.
+     */
+    enum class Shape
+    {
+        RECTANGLE, ///< The region fills its bounds.
+        ELLIPSE ///< The region is the ellipse that fits its bounds.
+    };
+
+    Shape shape{Shape::ELLIPSE}; ///< The outline of the region.
+    std::int32_t x1{0}; ///< The left edge of the bounds of the region, in pixels of the full size image.
+    std::int32_t y1{0}; ///< The top edge of the bounds of the region.
+    std::int32_t x2{0}; ///< The right edge of the bounds of the region, inclusive.
+    std::int32_t y2{0}; ///< The bottom edge of the bounds of the region, inclusive.
+    std::uint8_t weight{255}; ///< The importance of the pixels in the region, where 255 counts fully.
+
+    bool operator==(const WeightRegion& other) const;
+    bool operator!=(const WeightRegion& other) const;
+};
+
+/**
+ * @brief The WeightMask class holds the per-pixel importance of an image, built from a set of weight regions.
+ * Pixels outside every region weigh nothing. Where regions overlap, the highest weight wins.
+ * The weights are stored as runs of equal weight per row, so clipping scanlines to the mask costs in proportion to the runs they cross rather than their pixels.
+ */
+class WeightMask
+{
+public:
+    WeightMask();
+    WeightMask& operator=(const WeightMask&) = default;
+    WeightMask(const WeightMask&) = default;
+    ~WeightMask() = default;
+
+    /**
+     * @brief reset Rebuilds the mask from the given regions, for an image that may be a shrunk or cropped copy of the full size image.
+     * Region coordinates are mapped to the image by subtracting the offset and then dividing by the factor.
+     * @param width The width of the image.
+     * @param height The height of the image.
+     * @param regions The regions, in full size image coordinates.
+     * @param factor The factor the image was shrunk by, one for full size images.
+     * @param offsetX The left edge of the image within the full size image.
+     * @param offsetY The top edge of the image within the full size image.
+     */
+    void reset(std::uint32_t width, std::uint32_t height, const std::vector<WeightRegion>& regions, std::uint32_t factor = 1, std::int32_t offsetX = 0, std::int32_t offsetY = 0);
+
+    /**
+     * @brief isValid Returns true if the mask has been built. A mask that is not valid restricts nothing.
+     * @return True if the mask has been built, else false.
+     */
+    bool isValid() const;
+
+    /**
+     * @brief invalidate Marks the mask as out of date, e.g. after the regions or the images change.
+     */
+    void invalidate();
+
+    /**
+     * @brief isUniform Returns true if every pixel in the mask counts fully, so scanlines clipped to the mask need no weighting.
+     * @return True if every weight in the mask is 255, else false.
+     */
+    bool isUniform() const;
+
+    /**
+     * @brief getPixelCount Gets the number of pixels with a weight above zero.
+     * @return The number of pixels in the mask.
+     */
+    std::uint64_t getPixelCount() const;
+
+    /**
+     * @brief clip Clips scanlines to the mask, splitting them wherever the weight changes.
+     * @param lines The scanlines to clip, which must lie within the image.
+     * @param clipped The parts of the scanlines that lie within the mask, replacing its contents.
+     * @param weights The weight of each clipped scanline, replacing its contents.
+     */
+    void clip(const std::vector<geometrize::Scanline>& lines, std::vector<geometrize::Scanline>& clipped, std::vector<std::uint8_t>& weights) const;
+
+    /**
+     * @brief randomPoint Picks a pixel within the mask at random, every pixel being equally likely, using the random generator of the calling thread.
+     * @param x The column of the pixel.
+     * @param y The row of the pixel.
+     * @return True if a pixel was picked, false if the mask is empty.
+     */
+    bool randomPoint(std::int32_t& x, std::int32_t& y) const;
+
+private:
+    struct Run
+    {
+        std::int32_t x1; ///> The first column of the run
+        std::int32_t x2; ///> The last column of the run, inclusive
+        std::uint8_t weight; ///> The weight of every pixel in the run
+    };
+
+    std::uint32_t m_width; ///> The width of the image the mask was built for
+    std::uint32_t m_height; ///> The height of the image the mask was built for
+    bool m_valid; ///> Whether the mask has been built
+    bool m_uniform; ///> Whether every run has full weight
+    std::vector<Run> m_runs; ///> The runs of pixels with a weight above zero, row by row, in order of column
+    std::vector<std::size_t> m_rowRuns; ///> The index of the first run of each row, with one extra entry for the end of the last row
+    std::vector<std::uint64_t> m_rowPixels; ///> The number of pixels in the mask before each row, with one extra entry for the total
+};
+
+}
+
+}
@@ -1,14 +1,31 @@
 #include "imagetaskpreferences.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <ostream>
+#include <sstream>
+#include <vector>
 
 #include "cereal/archives/json.hpp"
 
 #include "serialization/imagetaskpreferencesdata.h"
 #include "serialization/streamview.h"
 
+namespace
+{
+
+// Script revisions come from one counter shared by every preferences object, so a revision identifies the same scripts even after the preferences are replaced
+std::uint64_t nextScriptsRevision()
+{
+    static std::atomic<std::uint64_t> revision{0};
+    return ++revision;
+}
+
+}
+
 namespace geometrize
 {
 
@@ -18,11 +35,11 @@ namespace preferences
 class ImageTaskPreferences::ImageTaskPreferencesImpl
 {
 public:
-    ImageTaskPreferencesImpl()
+    ImageTaskPreferencesImpl() : m_scriptsRevision{nextScriptsRevision()}
     {
     }
 
-    ImageTaskPreferencesImpl(const std::string& filePath)
+    ImageTaskPreferencesImpl(const std::string& filePath) : m_scriptsRevision{nextScriptsRevision()}
     {
         load(filePath);
     }
@@ -38,10 +55,11 @@ public:
         std::istream input(&streamView);
         try {
             cereal::JSONInputArchive archive{input};
-            m_data.archive(archive, m_options, m_scriptsEnabled, m_scripts);
+            m_data.archive(archive, m_options, m_pyramidDepth, m_tileSize, m_targetSimilarity, m_timeLimit, m_shapeLimit, m_regionOfInterestEnabled, m_weightRegions, m_errorGuidedSampling, m_searchesPerStep, m_scriptsEnabled, m_scripts);
         } catch(...) {
             assert(0 && "Failed to read image preferences");
         }
+        m_scriptsRevision = nextScriptsRevision();
     }
 
     void save(const std::string& filePath)
@@ -49,10 +67,35 @@ public:
         std::ofstream output(filePath);
         try {
             cereal::JSONOutputArchive archive{output};
-            m_data.archive(archive, m_options, m_scriptsEnabled, m_scripts);
+            m_data.archive(archive, m_options, m_pyramidDepth, m_tileSize, m_targetSimilarity, m_timeLimit, m_shapeLimit, m_regionOfInterestEnabled, m_weightRegions, m_errorGuidedSampling, m_searchesPerStep, m_scriptsEnabled, m_scripts);
+        } catch(...) {
+            assert(0 && "Failed to write image preferences");
+        }
+    }
+
+    void loadFromString(const std::string& data)
+    {
+        std::istringstream input(data);
+        try {
+            cereal::JSONInputArchive archive{input};
+            m_data.archive(archive, m_options, m_pyramidDepth, m_tileSize, m_targetSimilarity, m_timeLimit, m_shapeLimit, m_regionOfInterestEnabled, m_weightRegions, m_errorGuidedSampling, m_searchesPerStep, m_scriptsEnabled, m_scripts);
+        } catch(...) {
+            assert(0 && "Failed to read image preferences");
+        }
+        m_scriptsRevision = nextScriptsRevision();
+    }
+
+    std::string saveToString()
+    {
+        std::ostringstream output;
+        try {
+            // The archive only finishes writing the JSON when it is destroyed
+            cereal::JSONOutputArchive archive{output};
+            m_data.archive(archive, m_options, m_pyramidDepth, m_tileSize, m_targetSimilarity, m_timeLimit, m_shapeLimit, m_regionOfInterestEnabled, m_weightRegions, m_errorGuidedSampling, m_searchesPerStep, m_scriptsEnabled, m_scripts);
         } catch(...) {
             assert(0 && "Failed to write image preferences");
         }
+        return output.str();
     }
 
     geometrize::ImageRunnerOptions getImageRunnerOptions() const
@@ -100,6 +143,106 @@ public:
         m_options.maxThreads = maxThreads;
     }
 
+    std::uint32_t getPyramidDepth() const
+    {
+        return m_pyramidDepth;
+    }
+
+    void setPyramidDepth(const std::uint32_t depth)
+    {
+        m_pyramidDepth = depth;
+    }
+
+    std::uint32_t getTileSize() const
+    {
+        return m_tileSize;
+    }
+
+    void setTileSize(const std::uint32_t tileSize)
+    {
+        m_tileSize = tileSize;
+    }
+
+    float getTargetSimilarity() const
+    {
+        return m_targetSimilarity;
+    }
+
+    void setTargetSimilarity(const float similarity)
+    {
+        m_targetSimilarity = similarity;
+    }
+
+    std::uint32_t getTimeLimit() const
+    {
+        return m_timeLimit;
+    }
+
+    void setTimeLimit(const std::uint32_t seconds)
+    {
+        m_timeLimit = seconds;
+    }
+
+    std::uint32_t getShapeLimit() const
+    {
+        return m_shapeLimit;
+    }
+
+    void setShapeLimit(const std::uint32_t shapeLimit)
+    {
+        m_shapeLimit = shapeLimit;
+    }
+
+    bool isRegionOfInterestEnabled() const
+    {
+        return m_regionOfInterestEnabled;
+    }
+
+    void setRegionOfInterestEnabled(const bool enabled)
+    {
+        m_regionOfInterestEnabled = enabled;
+    }
+
+    std::vector<geometrize::optimizer::WeightRegion> getWeightRegions() const
+    {
+        return m_weightRegions;
+    }
+
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+    {
+        m_weightRegions = regions;
+    }
+
+    void addWeightRegion(const geometrize::optimizer::WeightRegion& region)
+    {
+        m_weightRegions.push_back(region);
+    }
+
+    void clearWeightRegions()
+    {
+        m_weightRegions.clear();
+    }
+
+    bool isErrorGuidedSamplingEnabled() const
+    {
+        return m_errorGuidedSampling;
+    }
+
+    void setErrorGuidedSamplingEnabled(const bool enabled)
+    {
+        m_errorGuidedSampling = enabled;
+    }
+
+    std::uint32_t getSearchesPerStep() const
+    {
+        return m_searchesPerStep;
+    }
+
+    void setSearchesPerStep(const std::uint32_t searches)
+    {
+        m_searchesPerStep = std::max(1U, searches);
+    }
+
     void setScriptModeEnabled(const bool enabled)
     {
         m_scriptsEnabled = enabled;
@@ -112,12 +255,21 @@ public:
 
     void setScript(const std::string& scriptName, const std::string& code)
     {
+        const auto it = m_scripts.find(scriptName);
+        if(it != m_scripts.end() && it->second == code) {
+            return;
+        }
         m_scripts[scriptName] = code;
+        m_scriptsRevision = nextScriptsRevision();
     }
 
     void setScripts(const std::map<std::string, std::string>& scripts)
     {
+        if(scripts == m_scripts) {
+            return;
+        }
         m_scripts = scripts;
+        m_scriptsRevision = nextScriptsRevision();
     }
 
     std::map<std::string, std::string> getScripts() const
@@ -125,12 +277,27 @@ public:
         return m_scripts;
     }
 
+    std::uint64_t getScriptsRevision() const
+    {
+        return m_scriptsRevision;
+    }
+
 private:
     serialization::ImageTaskPreferencesData m_data; ///> The data that will be serialized/deserialized
     geometrize::ImageRunnerOptions m_options; ///> The Geometrize library-level image runner options
+    std::uint32_t m_pyramidDepth{0}; ///> The number of times the images are halved in size before searching for shapes, zero searches at full resolution
+    std::uint32_t m_tileSize{0}; ///> The spacing of the tile grid used to search large images in parallel, zero disables tiling
+    float m_targetSimilarity{0.0f}; ///> The percentage similarity to the target image at which a run stops, zero disables the limit
+    std::uint32_t m_timeLimit{0}; ///> The number of seconds of stepping after which a run stops, zero disables the limit
+    std::uint32_t m_shapeLimit{0}; ///> The number of shapes after which a run stops, zero disables the limit
+    bool m_regionOfInterestEnabled{false}; ///> Whether the search is restricted to and weighted by the weight regions
+    std::vector<geometrize::optimizer::WeightRegion> m_weightRegions; ///> The regions of the image that matter, with how much they matter
+    bool m_errorGuidedSampling{false}; ///> Whether random candidate shapes are placed where the most error remains rather than anywhere
+    std::uint32_t m_searchesPerStep{4}; ///> The number of independent searches per step, each hill climbing its own candidate
 
     bool m_scriptsEnabled{false}; ///> Whether the custom Chaiscript scripts are enabled or not
     std::map<std::string, std::string> m_scripts; ///> Custom Chaiscript scripts that override the default Geometrize functionality
+    std::uint64_t m_scriptsRevision; ///> Changes whenever the scripts change, so script engines can tell when they need to evaluate them again
 };
 
 ImageTaskPreferences::ImageTaskPreferences() : d{std::make_shared<ImageTaskPreferences::ImageTaskPreferencesImpl>()}
@@ -165,6 +332,16 @@ void ImageTaskPreferences::save(const std::string& filePath)
     d->save(filePath);
 }
 
+void ImageTaskPreferences::loadFromString(const std::string& data)
+{
+    d->loadFromString(data);
+}
+
+std::string ImageTaskPreferences::saveToString() const
+{
+    return d->saveToString();
+}
+
 geometrize::ImageRunnerOptions ImageTaskPreferences::getImageRunnerOptions() const
 {
     return d->getImageRunnerOptions();
@@ -210,6 +387,106 @@ void ImageTaskPreferences::setMaxThreads(const std::uint32_t maxThreads)
     d->setMaxThreads(maxThreads);
 }
 
+std::uint32_t ImageTaskPreferences::getPyramidDepth() const
+{
+    return d->getPyramidDepth();
+}
+
+void ImageTaskPreferences::setPyramidDepth(const std::uint32_t depth)
+{
+    d->setPyramidDepth(depth);
+}
+
+std::uint32_t ImageTaskPreferences::getTileSize() const
+{
+    return d->getTileSize();
+}
+
+void ImageTaskPreferences::setTileSize(const std::uint32_t tileSize)
+{
+    d->setTileSize(tileSize);
+}
+
+float ImageTaskPreferences::getTargetSimilarity() const
+{
+    return d->getTargetSimilarity();
+}
+
+void ImageTaskPreferences::setTargetSimilarity(const float similarity)
+{
+    d->setTargetSimilarity(similarity);
+}
+
+std::uint32_t ImageTaskPreferences::getTimeLimit() const
+{
+    return d->getTimeLimit();
+}
+
+void ImageTaskPreferences::setTimeLimit(const std::uint32_t seconds)
+{
+    d->setTimeLimit(seconds);
+}
+
+std::uint32_t ImageTaskPreferences::getShapeLimit() const
+{
+    return d->getShapeLimit();
+}
+
+void ImageTaskPreferences::setShapeLimit(const std::uint32_t shapeLimit)
+{
+    d->setShapeLimit(shapeLimit);
+}
+
+bool ImageTaskPreferences::isRegionOfInterestEnabled() const
+{
+    return d->isRegionOfInterestEnabled();
+}
+
+void ImageTaskPreferences::setRegionOfInterestEnabled(const bool enabled)
+{
+    d->setRegionOfInterestEnabled(enabled);
+}
+
+std::vector<geometrize::optimizer::WeightRegion> ImageTaskPreferences::getWeightRegions() const
+{
+    return d->getWeightRegions();
+}
+
+void ImageTaskPreferences::setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+{
+    d->setWeightRegions(regions);
+}
+
+void ImageTaskPreferences::addWeightRegion(const geometrize::optimizer::WeightRegion& region)
+{
+    d->addWeightRegion(region);
+}
+
+void ImageTaskPreferences::clearWeightRegions()
+{
+    d->clearWeightRegions();
+}
+
+bool ImageTaskPreferences::isErrorGuidedSamplingEnabled() const
+{
+    return d->isErrorGuidedSamplingEnabled();
+}
+
+void ImageTaskPreferences::setErrorGuidedSamplingEnabled(const bool enabled)
+{
+    d->setErrorGuidedSamplingEnabled(enabled);
+}
+
+std::uint32_t ImageTaskPreferences::getSearchesPerStep() const
+{
+    return d->getSearchesPerStep();
+}
+
+void ImageTaskPreferences::setSearchesPerStep(const std::uint32_t searches)
+{
+    d->setSearchesPerStep(searches);
+}
+
 void ImageTaskPreferences::setScriptModeEnabled(const bool enabled)
 {
     d->setScriptModeEnabled(enabled);
@@ -235,6 +512,11 @@ std::map<std::string, std::string> ImageTaskPreferences::getScripts() const
     return d->getScripts();
 }
 
+std::uint64_t ImageTaskPreferences::getScriptsRevision() const
+{
+    return d->getScriptsRevision();
+}
+
 }
 
 }
@@ -4,9 +4,12 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "geometrize/runner/imagerunneroptions.h"
 
+#include "optimizer/weightmask.h"
+
 namespace geometrize
 {
 
@@ -37,6 +40,18 @@ public:
      */
     void save(const std::string& filePath);
 
+    /**
+     * @brief loadFromString Loads the image task preferences from a string, in the same format as preferences files.
+     * @param data The image task preferences data.
+     */
+    void loadFromString(const std::string& data);
+
+    /**
+     * @brief saveToString Saves the image task preferences to a string, in the same format as preferences files.
+     * @return The image task preferences data.
+     */
+    std::string saveToString() const;
+
     /**
      * @brief getImageRunnerOptions Gets a copy of the image runner options.
      * @return The image runner options.
@@ -52,12 +67,142 @@ public:
     void setSeed(std::uint32_t seed);
     void setMaxThreads(std::uint32_t maxThreads);
 
+    /**
+     * @brief getPyramidDepth Gets the number of times the images are halved in size before searching for shapes. Zero searches at full resolution.
+     * Ignored while script mode is enabled, since the scripted shape functions only apply to the full resolution image.
+     * @return The pyramid depth.
+     */
+    std::uint32_t getPyramidDepth() const;
+
+    /**
+     * @brief setPyramidDepth Sets the number of times the images are halved in size before searching for shapes. Zero searches at full resolution.
+     * @param depth The pyramid depth.
+     */
+    void setPyramidDepth(std::uint32_t depth);
+
+    /**
+     * @brief getTileSize Gets the spacing of the tile grid used to search large images in parallel. Zero disables tiling.
+     * Ignored while script mode is enabled, since the scripted shape functions only apply to the whole image.
+     * @return The tile size, in pixels.
+     */
+    std::uint32_t getTileSize() const;
+
+    /**
+     * @brief setTileSize Sets the spacing of the tile grid used to search large images in parallel. Zero disables tiling.
+     * @param tileSize The tile size, in pixels.
+     */
+    void setTileSize(std::uint32_t tileSize);
+
+    /**
+     * @brief getTargetSimilarity Gets the similarity to the target image at which running tasks stop. Zero disables the limit.
+     * @return The target similarity, as a percentage.
+     */
+    float getTargetSimilarity() const;
+
+    /**
+     * @brief setTargetSimilarity Sets the similarity to the target image at which running tasks stop. Zero disables the limit.
+     * @param similarity The target similarity, as a percentage.
+     */
+    void setTargetSimilarity(float similarity);
+
+    /**
+     * @brief getTimeLimit Gets the time each run of a task may spend stepping before it stops. Zero disables the limit.
+     * @return The time limit, in seconds.
+     */
+    std::uint32_t getTimeLimit() const;
+
+    /**
+     * @brief setTimeLimit Sets the time each run of a task may spend stepping before it stops. Zero disables the limit.
+     * @param seconds The time limit, in seconds.
+     */
+    void setTimeLimit(std::uint32_t seconds);
+
+    /**
+     * @brief getShapeLimit Gets the number of shapes a task's model may hold before running stops. Zero disables the limit.
+     * @return The shape limit.
+     */
+    std::uint32_t getShapeLimit() const;
+
+    /**
+     * @brief setShapeLimit Sets the number of shapes a task's model may hold before running stops. Zero disables the limit.
+     * @param shapeLimit The shape limit.
+     */
+    void setShapeLimit(std::uint32_t shapeLimit);
+
+    /**
+     * @brief isRegionOfInterestEnabled Returns true if the search for shapes is restricted to and weighted by the weight regions.
+     * @return True if the weight regions are in use, else false.
+     */
+    bool isRegionOfInterestEnabled() const;
+
+    /**
+     * @brief setRegionOfInterestEnabled Sets whether the search for shapes is restricted to and weighted by the weight regions.
+     * @param enabled Whether the weight regions are in use. The whole image is searched while there are no regions.
+     */
+    void setRegionOfInterestEnabled(bool enabled);
+
+    /**
+     * @brief getWeightRegions Gets the regions of the image that matter, with how much they matter.
+     * @return The weight regions, in pixels of the target image.
+     */
+    std::vector<geometrize::optimizer::WeightRegion> getWeightRegions() const;
+
+    /**
+     * @brief setWeightRegions Sets the regions of the image that matter, with how much they matter.
+     * @param regions The weight regions, in pixels of the target image.
+     */
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions);
+
+    /**
+     * @brief addWeightRegion Adds a region of the image that matters.
+     * @param region The weight region, in pixels of the target image.
+     */
+    void addWeightRegion(const geometrize::optimizer::WeightRegion& region);
+
+    /**
+     * @brief clearWeightRegions Removes every weight region.
+     */
+    void clearWeightRegions();
+
+    /**
+     * @brief isErrorGuidedSamplingEnabled Returns true if random candidate shapes are placed in proportion to the error that remains around them.
+     * @return True if candidate placement follows the remaining error, else false.
+     */
+    bool isErrorGuidedSamplingEnabled() const;
+
+    /**
+     * @brief setErrorGuidedSamplingEnabled Sets whether random candidate shapes are placed in proportion to the error that remains around them, rather than anywhere in the image.
+     * @param enabled Whether candidate placement follows the remaining error.
+     */
+    void setErrorGuidedSamplingEnabled(bool enabled);
+
+    /**
+     * @brief getSearchesPerStep Gets the number of independent searches per step, each sampling candidates and hill climbing the best of them.
+     * More searches find better shapes and keep more threads busy. The count is part of the work a step does, so it never depends on the thread count.
+     * @return The number of searches per step, at least one.
+     */
+    std::uint32_t getSearchesPerStep() const;
+
+    /**
+     * @brief setSearchesPerStep Sets the number of independent searches per step, each sampling candidates and hill climbing the best of them.
+     * Changing it changes the shapes that a given seed produces.
+     * @param searches The number of searches per step, raised to one if zero.
+     */
+    void setSearchesPerStep(std::uint32_t searches);
+
     bool isScriptModeEnabled() const;
     void setScriptModeEnabled(bool enabled);
     void setScript(const std::string& scriptName, const std::string& code);
     void setScripts(const std::map<std::string, std::string>& scripts);
     std::map<std::string, std::string> getScripts() const;
 
+    /**
+     * @brief getScriptsRevision Gets a number that changes whenever the scripts change, and only then.
+     * Script engines compare this with the revision they last evaluated, instead of evaluating the scripts again before every step.
+     * @return The revision of the scripts, unique among all preferences.
+     */
+    std::uint64_t getScriptsRevision() const;
+
 private:
     class ImageTaskPreferencesImpl;
     std::shared_ptr<ImageTaskPreferencesImpl> d;
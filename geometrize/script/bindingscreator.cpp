@@ -1,6 +1,8 @@
 #include "script/bindingscreator.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
@@ -38,10 +40,12 @@
 #include "dialog/launchwindow.h"
 #include "exporter/imageexporter.h"
 #include "image/imageloader.h"
+#include "optimizer/weightmask.h"
 #include "script/bindingswrapper.h"
 #include "script/chaiscriptmathextras.h"
 #include "script/scriptutil.h"
 #include "task/imagetask.h"
+#include "task/shapelog.h"
 #include "task/synchronousimagetask.h"
 
 #define ADD_CONST_VAR(Class, Name) try { module->add(chaiscript::const_var(&Class::Name), #Name); } catch(...) { assert(0 && #Name); }
@@ -113,6 +117,12 @@ std::shared_ptr<chaiscript::Module> createDefaultBindings()
 
     ADD_FREE_FUN(setTranslatorsForLocale);
 
+    ADD_FREE_FUN(setScriptProfilingEnabled);
+    ADD_FREE_FUN(isScriptProfilingEnabled);
+    ADD_FREE_FUN(resetScriptProfiles);
+    ADD_FREE_FUN(getScriptProfilesText);
+    ADD_FREE_FUN(writeScriptProfilesToFile);
+
     return module;
 }
 
@@ -177,14 +187,43 @@ std::shared_ptr<chaiscript::Module> createImageTaskBindings()
     ADD_TYPE(SynchronousImageTask);
 
     ADD_CONSTRUCTOR(SynchronousImageTask, SynchronousImageTask(Bitmap&));
+    ADD_CONSTRUCTOR(SynchronousImageTask, SynchronousImageTask(const Bitmap&, const Bitmap&));
+    try { module->add(chaiscript::fun(&SynchronousImageTask::resume), "resumeImageTask"); } catch(...) { assert(0 && "resumeImageTask"); }
 
     ADD_MEMBER(SynchronousImageTask, stepModel);
+    ADD_MEMBER(SynchronousImageTask, run);
     ADD_MEMBER(SynchronousImageTask, drawBackgroundRectangle);
     ADD_MEMBER(SynchronousImageTask, getTarget);
     ADD_MEMBER(SynchronousImageTask, getCurrent);
     ADD_MEMBER(SynchronousImageTask, getPreferences);
     ADD_MEMBER(SynchronousImageTask, setPreferences);
     ADD_MEMBER(SynchronousImageTask, getShapes);
+    ADD_MEMBER(SynchronousImageTask, setCheckpointFile);
+    ADD_MEMBER(SynchronousImageTask, saveCheckpoint);
+
+    ADD_TYPE(ShapeLogView);
+
+    ADD_MEMBER(ShapeLogView, size);
+    ADD_MEMBER(ShapeLogView, empty);
+    ADD_MEMBER(ShapeLogView, at);
+    ADD_MEMBER(ShapeLogView, back);
+    ADD_MEMBER(ShapeLogView, slice);
+    ADD_MEMBER(ShapeLogView, toVector);
+    try { module->add(chaiscript::fun(&ShapeLogView::at), "[]"); } catch(...) { assert(0 && "[]"); }
+
+    // Lets scripts pass shape log views straight to the exporters, which take vectors of shapes
+    module->add(chaiscript::type_conversion<ShapeLogView, std::vector<geometrize::ShapeResult>>([](const ShapeLogView& shapes) { return shapes.toVector(); }));
+
+    chaiscript::utility::add_class<StopReason>(*module,
+      "StopReason",
+    {
+      { StopReason::NONE, "NONE" },
+      { StopReason::STEP_LIMIT, "STEP_LIMIT" },
+      { StopReason::TARGET_SIMILARITY, "TARGET_SIMILARITY" },
+      { StopReason::TIME_LIMIT, "TIME_LIMIT" },
+      { StopReason::SHAPE_LIMIT, "SHAPE_LIMIT" },
+      { StopReason::STEP_FAILED, "STEP_FAILED" }
+    });
 
     ADD_TYPE(ImageTaskPreferences);
 
@@ -198,9 +237,39 @@ std::shared_ptr<chaiscript::Module> createImageTaskBindings()
     ADD_MEMBER(ImageTaskPreferences, setShapeAlpha);
     ADD_MEMBER(ImageTaskPreferences, setCandidateShapeCount);
     ADD_MEMBER(ImageTaskPreferences, setMaxShapeMutations);
+    ADD_MEMBER(ImageTaskPreferences, setTargetSimilarity);
+    ADD_MEMBER(ImageTaskPreferences, setTimeLimit);
+    ADD_MEMBER(ImageTaskPreferences, setShapeLimit);
     ADD_MEMBER(ImageTaskPreferences, setSeed);
     ADD_MEMBER(ImageTaskPreferences, setMaxThreads);
 
+    ADD_MEMBER(ImageTaskPreferences, isRegionOfInterestEnabled);
+    ADD_MEMBER(ImageTaskPreferences, setRegionOfInterestEnabled);
+    ADD_MEMBER(ImageTaskPreferences, clearWeightRegions);
+    ADD_MEMBER(ImageTaskPreferences, isErrorGuidedSamplingEnabled);
+    ADD_MEMBER(ImageTaskPreferences, setErrorGuidedSamplingEnabled);
+    ADD_MEMBER(ImageTaskPreferences, getSearchesPerStep);
+    ADD_MEMBER(ImageTaskPreferences, setSearchesPerStep);
+
+    // Regions are added by shape rather than exposing the region struct, bounds are inclusive pixel coordinates and weight is 1-255
+    const auto addRegion = [](ImageTaskPreferences& prefs, const geometrize::optimizer::WeightRegion::Shape shape,
+            const int x1, const int y1, const int x2, const int y2, const int weight) {
+        geometrize::optimizer::WeightRegion region;
+        region.shape = shape;
+        region.x1 = std::min(x1, x2);
+        region.y1 = std::min(y1, y2);
+        region.x2 = std::max(x1, x2);
+        region.y2 = std::max(y1, y2);
+        region.weight = static_cast<std::uint8_t>(std::max(1, std::min(weight, 255)));
+        prefs.addWeightRegion(region);
+    };
+    try { module->add(chaiscript::fun([addRegion](ImageTaskPreferences& prefs, const int x1, const int y1, const int x2, const int y2, const int weight) {
+        addRegion(prefs, geometrize::optimizer::WeightRegion::Shape::ELLIPSE, x1, y1, x2, y2, weight);
+    }), "addEllipseRegion"); } catch(...) { assert(0 && "addEllipseRegion"); }
+    try { module->add(chaiscript::fun([addRegion](ImageTaskPreferences& prefs, const int x1, const int y1, const int x2, const int y2, const int weight) {
+        addRegion(prefs, geometrize::optimizer::WeightRegion::Shape::RECTANGLE, x1, y1, x2, y2, weight);
+    }), "addRectangleRegion"); } catch(...) { assert(0 && "addRectangleRegion"); }
+
     ADD_MEMBER(ImageTaskPreferences, isScriptModeEnabled);
     ADD_MEMBER(ImageTaskPreferences, setScriptModeEnabled);
     ADD_MEMBER(ImageTaskPreferences, setScript);
@@ -331,6 +400,17 @@ std::shared_ptr<chaiscript::Module> createGeometrizeLibraryBindings()
 
     ADD_TYPE(ShapeMutator);
 
+    // Make the vectors of shapes passed to batch mutation functions accessible from scripts
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Circle>>>("CircleVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Ellipse>>>("EllipseVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Line>>>("LineVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Polyline>>>("PolylineVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<QuadraticBezier>>>("QuadraticBezierVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Rectangle>>>("RectangleVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<RotatedEllipse>>>("RotatedEllipseVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<RotatedRectangle>>>("RotatedRectangleVector", *module);
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<std::shared_ptr<Triangle>>>("TriangleVector", *module);
+
     chaiscript::utility::add_class<geometrize::ShapeTypes>(*module,
       "ShapeTypes",
     {
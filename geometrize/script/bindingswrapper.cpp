@@ -8,6 +8,7 @@
 #include "common/searchpaths.h"
 #include "common/util.h"
 #include "localization/localization.h"
+#include "script/scriptprofiler.h"
 #include "task/taskutil.h"
 
 namespace geometrize
@@ -191,6 +192,31 @@ void setTranslatorsForLocale(const std::string& locale)
     geometrize::setTranslatorsForLocale(QString::fromStdString(locale));
 }
 
+void setScriptProfilingEnabled(const bool enabled)
+{
+    getSharedScriptProfiler().setEnabled(enabled);
+}
+
+bool isScriptProfilingEnabled()
+{
+    return getSharedScriptProfiler().isEnabled();
+}
+
+void resetScriptProfiles()
+{
+    getSharedScriptProfiler().reset();
+}
+
+std::string getScriptProfilesText()
+{
+    return formatScriptProfiles(getSharedScriptProfiler().getProfiles());
+}
+
+bool writeScriptProfilesToFile(const std::string& path)
+{
+    return writeScriptProfiles(getSharedScriptProfiler().getProfiles(), path);
+}
+
 }
 
 }
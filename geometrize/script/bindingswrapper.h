@@ -75,6 +75,16 @@ std::vector<std::string> split(const std::string& s, const char delimiter);
 
 void setTranslatorsForLocale(const std::string& locale);
 
+void setScriptProfilingEnabled(bool enabled);
+
+bool isScriptProfilingEnabled();
+
+void resetScriptProfiles();
+
+std::string getScriptProfilesText();
+
+bool writeScriptProfilesToFile(const std::string& path);
+
 }
 
 }
@@ -1,7 +1,18 @@
 #include "geometrizerengine.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <utility>
 
@@ -20,13 +31,143 @@
 #include "geometrize/shape/rotatedellipse.h"
 #include "geometrize/shape/rotatedrectangle.h"
 #include "geometrize/shape/triangle.h"
+#include "geometrize/shape/shape.h"
 #include "geometrize/shape/shapemutator.h"
+#include "geometrize/shape/shapetypes.h"
 
 #include "common/util.h"
 #include "script/chaiscriptcreator.h"
+#include "script/scriptprofiler.h"
 #include "script/scriptrunner.h"
 #include "script/scriptutil.h"
 
+namespace
+{
+
+// Names a shape type, so the list of script functions can be walked by a generic lambda
+template<typename T>
+struct ShapeTag
+{
+    using type = T;
+};
+
+// Calls the visitor with the shape type and name of every setup and mutation function that the engine provides to the shape mutator
+template<typename Visitor>
+void visitShapeFunctions(Visitor&& visit)
+{
+    visit(ShapeTag<geometrize::Circle>{}, "setupCircle");
+    visit(ShapeTag<geometrize::Ellipse>{}, "setupEllipse");
+    visit(ShapeTag<geometrize::Line>{}, "setupLine");
+    visit(ShapeTag<geometrize::Polyline>{}, "setupPolyline");
+    visit(ShapeTag<geometrize::QuadraticBezier>{}, "setupQuadraticBezier");
+    visit(ShapeTag<geometrize::Rectangle>{}, "setupRectangle");
+    visit(ShapeTag<geometrize::RotatedEllipse>{}, "setupRotatedEllipse");
+    visit(ShapeTag<geometrize::RotatedRectangle>{}, "setupRotatedRectangle");
+    visit(ShapeTag<geometrize::Triangle>{}, "setupTriangle");
+
+    visit(ShapeTag<geometrize::Circle>{}, "mutateCircle");
+    visit(ShapeTag<geometrize::Ellipse>{}, "mutateEllipse");
+    visit(ShapeTag<geometrize::Line>{}, "mutateLine");
+    visit(ShapeTag<geometrize::Polyline>{}, "mutatePolyline");
+    visit(ShapeTag<geometrize::QuadraticBezier>{}, "mutateQuadraticBezier");
+    visit(ShapeTag<geometrize::Rectangle>{}, "mutateRectangle");
+    visit(ShapeTag<geometrize::RotatedEllipse>{}, "mutateRotatedEllipse");
+    visit(ShapeTag<geometrize::RotatedRectangle>{}, "mutateRotatedRectangle");
+    visit(ShapeTag<geometrize::Triangle>{}, "mutateTriangle");
+}
+
+bool isSetupFunction(const std::string& functionName)
+{
+    return functionName.find("setup") == 0;
+}
+
+// Collapses each run of whitespace to a single space, so a script that was only reformatted or re-saved with different line endings still matches its default
+std::string normalizeScript(const std::string& script)
+{
+    std::istringstream in(script);
+    std::string normalized;
+    std::string word;
+    while(in >> word) {
+        if(!normalized.empty()) {
+            normalized += ' ';
+        }
+        normalized += word;
+    }
+    return normalized;
+}
+
+// Calls the visitor with the shape type, its type flag and the name of every batch mutation function that scripts may define
+template<typename Visitor>
+void visitBatchFunctions(Visitor&& visit)
+{
+    visit(ShapeTag<geometrize::Circle>{}, geometrize::CIRCLE, "mutateCircleBatch");
+    visit(ShapeTag<geometrize::Ellipse>{}, geometrize::ELLIPSE, "mutateEllipseBatch");
+    visit(ShapeTag<geometrize::Line>{}, geometrize::LINE, "mutateLineBatch");
+    visit(ShapeTag<geometrize::Polyline>{}, geometrize::POLYLINE, "mutatePolylineBatch");
+    visit(ShapeTag<geometrize::QuadraticBezier>{}, geometrize::QUADRATIC_BEZIER, "mutateQuadraticBezierBatch");
+    visit(ShapeTag<geometrize::Rectangle>{}, geometrize::RECTANGLE, "mutateRectangleBatch");
+    visit(ShapeTag<geometrize::RotatedEllipse>{}, geometrize::ROTATED_ELLIPSE, "mutateRotatedEllipseBatch");
+    visit(ShapeTag<geometrize::RotatedRectangle>{}, geometrize::ROTATED_RECTANGLE, "mutateRotatedRectangleBatch");
+    visit(ShapeTag<geometrize::Triangle>{}, geometrize::TRIANGLE, "mutateTriangleBatch");
+}
+
+// Sets up or mutates a single shape
+template<typename S>
+using ShapeFunction = std::function<void(S&)>;
+
+// Mutates each of the given number of shapes at the front of a vector once
+template<typename S>
+using ShapeBatchFunction = std::function<void(std::vector<std::shared_ptr<S>>&, int)>;
+
+// One function per shape type, looked up by type so calls need no name lookup or cast
+template<template<typename> class Function, typename... T>
+class ShapeFunctionTable
+{
+public:
+    template<typename S>
+    Function<S>& get()
+    {
+        return std::get<Function<S>>(m_functions);
+    }
+
+private:
+    std::tuple<Function<T>...> m_functions;
+};
+
+using ShapeFunctions = ShapeFunctionTable<ShapeFunction, geometrize::Circle, geometrize::Ellipse, geometrize::Line, geometrize::Polyline, geometrize::QuadraticBezier,
+                                          geometrize::Rectangle, geometrize::RotatedEllipse, geometrize::RotatedRectangle, geometrize::Triangle>;
+using ShapeBatchFunctions = ShapeFunctionTable<ShapeBatchFunction, geometrize::Circle, geometrize::Ellipse, geometrize::Line, geometrize::Polyline, geometrize::QuadraticBezier,
+                                               geometrize::Rectangle, geometrize::RotatedEllipse, geometrize::RotatedRectangle, geometrize::Triangle>;
+
+// A script engine used by one thread alone, holding its own copy of the scripts
+struct ThreadEngine
+{
+    std::unique_ptr<chaiscript::ChaiScript> engine; // The engine, created the first time the thread runs a script function
+    chaiscript::ChaiScript::State baseState; // The state of the engine before any scripts were evaluated
+    std::uint64_t generation{0}; // The generation of the scripts the engine holds, zero if it holds none yet
+    ShapeFunctions setupFunctions; // The setup functions of the engine
+    ShapeFunctions mutateFunctions; // The mutation functions of the engine
+    ShapeBatchFunctions batchFunctions; // The batch mutation functions of the engine, empty for shape types the scripts define none for
+};
+
+// The engine most recently used by a thread, so most calls find their engine without locking
+struct ThreadEngineCache
+{
+    std::uint64_t owner{0}; // The id of the geometrizer engine the cached engine belongs to
+    ThreadEngine* engine{nullptr}; // The cached engine
+};
+
+thread_local ThreadEngineCache threadEngineCache;
+
+// Every geometrizer engine gets an id that is never reused, so a stale cache entry can never be mistaken for a live one
+std::uint64_t nextEngineId()
+{
+    static std::atomic<std::uint64_t> id{0};
+    return ++id;
+}
+
+}
+
 namespace geometrize
 {
 
@@ -36,14 +177,18 @@ namespace script
 class GeometrizerEngine::GeometrizerEngineImpl
 {
 public:
-    GeometrizerEngineImpl(GeometrizerEngine* pQ) : q{pQ}, m_engine{script::createShapeMutatorEngine()}, m_defaultScripts{script::getDefaultScripts()}, m_mutator{nullptr}
+    GeometrizerEngineImpl(GeometrizerEngine* pQ) : q{pQ}, m_engine{script::createShapeMutatorEngine()}, m_defaultScripts{script::getDefaultScripts()}, m_mutator{nullptr},
+        m_id{nextEngineId()}, m_generation{1}, m_scripts{std::make_shared<const std::map<std::string, std::string>>()}
     {
+        for(const auto& entry : m_defaultScripts) {
+            m_normalizedDefaultScripts[entry.first] = normalizeScript(entry.second);
+        }
         setupGlobals();
         m_state = m_engine->get_state();
     }
     ~GeometrizerEngineImpl() = default;
-    GeometrizerEngineImpl& operator=(const GeometrizerEngineImpl&) = default;
-    GeometrizerEngineImpl(const GeometrizerEngineImpl&) = default;
+    GeometrizerEngineImpl& operator=(const GeometrizerEngineImpl&) = delete;
+    GeometrizerEngineImpl(const GeometrizerEngineImpl&) = delete;
 
     chaiscript::ChaiScript* getEngine()
     {
@@ -61,9 +206,43 @@ public:
             installDefaults();
         } else {
             m_mutator->setDefaults();
+            m_batchShapeTypes = 0;
         }
     }
 
+    bool canMutate(const geometrize::ShapeTypes type) const
+    {
+        return (m_batchShapeTypes & static_cast<std::uint32_t>(type)) != 0;
+    }
+
+    void mutate(std::vector<std::shared_ptr<geometrize::Shape>>& shapes)
+    {
+        if(shapes.empty()) {
+            return;
+        }
+        const geometrize::ShapeTypes shapeType{shapes.front()->getType()};
+        visitBatchFunctions([this, &shapes, shapeType](const auto tag, const geometrize::ShapeTypes type, const std::string&) {
+            using T = typename decltype(tag)::type;
+            if(type != shapeType) {
+                return;
+            }
+            ScriptProfiler::Counter& counter{*m_batchCounters.at(type)};
+            std::vector<std::shared_ptr<T>> batch;
+            batch.reserve(shapes.size());
+            for(const std::shared_ptr<geometrize::Shape>& shape : shapes) {
+                batch.push_back(std::static_pointer_cast<T>(shape));
+            }
+            getSharedScriptProfiler().profile(counter, [this, &batch]() {
+                getThreadEngine().batchFunctions.template get<T>()(batch, static_cast<int>(batch.size()));
+            });
+
+            // Scripts may replace shapes rather than mutate them in place
+            if(batch.size() == shapes.size()) {
+                std::copy(batch.begin(), batch.end(), shapes.begin());
+            }
+        });
+    }
+
     void setupScripts(const std::map<std::string, std::string>& functions)
     {
         resetFunctions(functions);
@@ -82,13 +261,25 @@ private:
 
     void resetFunctions(const std::map<std::string, std::string>& customFunctions)
     {
+        // The per-thread engines pick up the new scripts the next time each of their threads calls a script function
+        {
+            std::lock_guard<std::mutex> lock(m_threadEnginesMutex);
+            m_scripts = std::make_shared<const std::map<std::string, std::string>>(customFunctions);
+            m_generation++;
+        }
+
+        findScriptedFunctions(customFunctions);
+
         m_engine->set_state(m_state); // Restore to the original engine state, this wipes out the function(s) we need to redefine.
 
         // Starting from the base state, re-add custom functions, then attempt to add missing required ones with defaults.
         // This is an ugly workaround, seems to be no choice because Chaiscript does not let us reload/redefine functions easily.
+        ScriptProfiler& profiler{getSharedScriptProfiler()};
         for(const auto& entry : customFunctions) {
             try {
-                m_engine->eval(entry.second);
+                profiler.profile(profiler.getCounter(entry.first + " (evaluation)"), [this, &entry]() {
+                    m_engine->eval(entry.second);
+                });
                 q->signal_scriptEvaluationSucceeded(entry.first, entry.second);
             } catch(const chaiscript::exception::eval_error& e) {
                 q->signal_scriptEvaluationFailed(entry.first, entry.second, e.pretty_print());
@@ -101,65 +292,185 @@ private:
         installDefaults();
     }
 
+    // Works out which shape functions must run in the script engine, the rest are left as the library's native functions
+    // A function is scripted if its script differs from the default, or if another custom script mentions it and so might redefine it
+    void findScriptedFunctions(const std::map<std::string, std::string>& customFunctions)
+    {
+        std::map<std::string, std::string> modifiedFunctions;
+        for(const auto& entry : customFunctions) {
+            const auto it{m_normalizedDefaultScripts.find(entry.first)};
+            if(it == m_normalizedDefaultScripts.end() || it->second != normalizeScript(entry.second)) {
+                modifiedFunctions.insert(entry);
+            }
+        }
+
+        m_scriptedFunctions.clear();
+        visitShapeFunctions([this, &modifiedFunctions](const auto, const std::string& functionName) {
+            for(const auto& entry : modifiedFunctions) {
+                if(entry.first == functionName || entry.second.find(functionName) != std::string::npos) {
+                    m_scriptedFunctions.insert(functionName);
+                    return;
+                }
+            }
+        });
+    }
+
+    // The default scripts are ports of the library's own setup and mutation functions, so unmodified ones keep the native versions
     void installDefaults()
     {
-        installDefault<geometrize::Circle>("setupCircle");
-        installDefault<geometrize::Ellipse>("setupEllipse");
-        installDefault<geometrize::Line>("setupLine");
-        installDefault<geometrize::Polyline>("setupPolyline");
-        installDefault<geometrize::QuadraticBezier>("setupQuadraticBezier");
-        installDefault<geometrize::Rectangle>("setupRectangle");
-        installDefault<geometrize::RotatedEllipse>("setupRotatedEllipse");
-        installDefault<geometrize::RotatedRectangle>("setupRotatedRectangle");
-        installDefault<geometrize::Triangle>("setupTriangle");
-
-        installDefault<geometrize::Circle>("mutateCircle");
-        installDefault<geometrize::Ellipse>("mutateEllipse");
-        installDefault<geometrize::Line>("mutateLine");
-        installDefault<geometrize::Polyline>("mutatePolyline");
-        installDefault<geometrize::QuadraticBezier>("mutateQuadraticBezier");
-        installDefault<geometrize::Rectangle>("mutateRectangle");
-        installDefault<geometrize::RotatedEllipse>("mutateRotatedEllipse");
-        installDefault<geometrize::RotatedRectangle>("mutateRotatedRectangle");
-        installDefault<geometrize::Triangle>("mutateTriangle");
+        m_mutator->setDefaults();
+        visitShapeFunctions([this](const auto tag, const std::string& functionName) {
+            if(m_scriptedFunctions.find(functionName) != m_scriptedFunctions.end()) {
+                installDefault<typename decltype(tag)::type>(functionName);
+            } else {
+                defineDefault(*m_engine, functionName);
+            }
+        });
+        findBatchFunctions();
+    }
+
+    // Batch mutation functions are optional and have no defaults, so they are only used for the shape types the scripts define them for
+    void findBatchFunctions()
+    {
+        m_batchShapeTypes = 0;
+        visitBatchFunctions([this](const auto tag, const geometrize::ShapeTypes type, const std::string& functionName) {
+            using T = typename decltype(tag)::type;
+            if(getBatchFunction<T>(*m_engine, functionName)) {
+                m_batchShapeTypes |= static_cast<std::uint32_t>(type);
+                m_batchCounters[type] = &getSharedScriptProfiler().getCounter(functionName);
+            }
+        });
     }
 
+    template<class T>
+    ShapeBatchFunction<T> getBatchFunction(chaiscript::ChaiScript& engine, const std::string& functionName) const
+    {
+        try {
+            return engine.eval<ShapeBatchFunction<T>>(functionName);
+        } catch(...) {
+            return nullptr; // The scripts do not define the function
+        }
+    }
+
+    // Makes sure the main engine defines the function, so the console sees the same functions as the shapes,
+    // then points the shape mutator at a function that calls the engine of whichever thread is running the shape
     template<class T>
     void installDefault(const std::string& functionName)
+    {
+        defineDefault(*m_engine, functionName);
+
+        // The counter is looked up once here, so calls only pay for the profiler when it is enabled
+        ScriptProfiler::Counter* counter{&getSharedScriptProfiler().getCounter(functionName)};
+        if(isSetupFunction(functionName)) {
+            m_mutator->setSetupFunction(std::function<void(T&)>([this, counter](T& shape) {
+                getSharedScriptProfiler().profile(*counter, [this, &shape]() {
+                    getThreadEngine().setupFunctions.template get<T>()(shape);
+                });
+            }));
+        } else {
+            m_mutator->setMutatorFunction(std::function<void(T&)>([this, counter](T& shape) {
+                getSharedScriptProfiler().profile(*counter, [this, &shape]() {
+                    getThreadEngine().mutateFunctions.template get<T>()(shape);
+                });
+            }));
+        }
+    }
+
+    void defineDefault(chaiscript::ChaiScript& engine, const std::string& functionName) const
     {
         try {
             const auto it{m_defaultScripts.find(functionName)};
             assert(it != m_defaultScripts.end());
-            m_engine->eval(it->second);
+            engine.eval(it->second);
         } catch(...) {
             // Either syntax error or the function was already defined
             //assert(0 && "Encountered script error when adding default shape function");
         }
+    }
 
-        const auto f{m_engine->eval<std::function<void(T&)>>(functionName)};
+    // Gets the engine of the calling thread, creating it or bringing its scripts up to date as needed
+    // Shapes are set up and mutated on many threads at once, and each thread running its own engine lets them do so without sharing interpreter state
+    ThreadEngine& getThreadEngine()
+    {
+        ThreadEngineCache& cache{threadEngineCache};
+        if(cache.owner == m_id && cache.engine->generation == m_generation.load(std::memory_order_acquire)) {
+            return *cache.engine;
+        }
 
-        const std::string setupPrefix{"setup"};
-        const std::string mutatePrefix{"mutate"};
-        if(functionName.find(setupPrefix) == 0) {
-            m_mutator->setSetupFunction(f);
-            return;
-        } else if(functionName.find(mutatePrefix) == 0) {
-            m_mutator->setMutatorFunction(f);
-            return;
+        ThreadEngine* engine{nullptr};
+        std::shared_ptr<const std::map<std::string, std::string>> scripts;
+        std::uint64_t generation{0};
+        {
+            std::lock_guard<std::mutex> lock(m_threadEnginesMutex);
+            std::unique_ptr<ThreadEngine>& slot{m_threadEngines[std::this_thread::get_id()]};
+            if(!slot) {
+                slot = std::make_unique<ThreadEngine>();
+            }
+            engine = slot.get();
+            scripts = m_scripts;
+            generation = m_generation.load(std::memory_order_relaxed);
         }
 
-        assert(0 && "Checking for unrecognized required function, will ignore it");
+        // Only this thread uses its engine, so it is built outside the lock and other threads can build theirs at the same time
+        if(engine->generation != generation) {
+            buildThreadEngine(*engine, *scripts, generation);
+        }
+        cache.owner = m_id;
+        cache.engine = engine;
+        return *engine;
+    }
+
+    // Evaluates the same scripts as the main engine, falling back to the defaults for any function the scripts leave out
+    // Errors are not reported again, the main engine already reported them when the scripts were set up
+    void buildThreadEngine(ThreadEngine& engine, const std::map<std::string, std::string>& customFunctions, const std::uint64_t generation) const
+    {
+        if(!engine.engine) {
+            engine.engine = script::createShapeMutatorEngine();
+            engine.baseState = engine.engine->get_state();
+        } else {
+            engine.engine->set_state(engine.baseState);
+        }
+
+        for(const auto& entry : customFunctions) {
+            try {
+                engine.engine->eval(entry.second);
+            } catch(...) {
+            }
+        }
+
+        visitShapeFunctions([this, &engine](const auto tag, const std::string& functionName) {
+            using T = typename decltype(tag)::type;
+            defineDefault(*engine.engine, functionName);
+            ShapeFunctions& functions{isSetupFunction(functionName) ? engine.setupFunctions : engine.mutateFunctions};
+            functions.template get<T>() = engine.engine->eval<std::function<void(T&)>>(functionName);
+        });
+        visitBatchFunctions([this, &engine](const auto tag, const geometrize::ShapeTypes, const std::string& functionName) {
+            using T = typename decltype(tag)::type;
+            engine.batchFunctions.template get<T>() = getBatchFunction<T>(*engine.engine, functionName);
+        });
+        engine.generation = generation;
     }
 
     GeometrizerEngine* q;
     const std::map<std::string, std::string> m_defaultScripts; ///< The default/fallbacks scripts loaded from the resources folder (function name and fields).
+    std::map<std::string, std::string> m_normalizedDefaultScripts; ///< The default scripts with whitespace normalized, for spotting custom scripts that match them.
+    std::set<std::string> m_scriptedFunctions; ///< The names of the shape functions that run in the script engine, all others run natively.
+    std::uint32_t m_batchShapeTypes{0}; ///< The flags of the shape types the scripts define batch mutation functions for, zero while the engine is disabled.
+    std::map<geometrize::ShapeTypes, ScriptProfiler::Counter*> m_batchCounters; ///< The profiler counters of the batch mutation functions, by shape type.
     std::unique_ptr<chaiscript::ChaiScript> m_engine;
     chaiscript::ChaiScript::State m_state;
     geometrize::ShapeMutator* m_mutator;
+
+    const std::uint64_t m_id; ///< Identifies this engine in the per-thread caches.
+    std::atomic<std::uint64_t> m_generation; ///< Counts the times the scripts have been set up, per-thread engines holding an older generation are rebuilt.
+    std::mutex m_threadEnginesMutex; ///< Guards the per-thread engines and the scripts they are built from.
+    std::map<std::thread::id, std::unique_ptr<ThreadEngine>> m_threadEngines; ///< The script engine of each thread that has set up or mutated shapes.
+    std::shared_ptr<const std::map<std::string, std::string>> m_scripts; ///< The custom scripts the per-thread engines are built from.
 };
 
 GeometrizerEngine::GeometrizerEngine() : d{std::make_unique<GeometrizerEngine::GeometrizerEngineImpl>(this)}
 {
+    qRegisterMetaType<std::string>();
 }
 
 GeometrizerEngine::~GeometrizerEngine()
@@ -191,6 +502,16 @@ void GeometrizerEngine::resetEngine(const std::map<std::string, std::string>& fu
     d->resetEngine(functions);
 }
 
+bool GeometrizerEngine::canMutate(const geometrize::ShapeTypes type) const
+{
+    return d->canMutate(type);
+}
+
+void GeometrizerEngine::mutate(std::vector<std::shared_ptr<geometrize::Shape>>& shapes)
+{
+    d->mutate(shapes);
+}
+
 }
 
 }
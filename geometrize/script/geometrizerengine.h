@@ -3,9 +3,12 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <QObject>
 
+#include "optimizer/batchmutator.h"
+
 namespace chaiscript
 {
 class ChaiScript;
@@ -13,9 +16,12 @@ class ChaiScript;
 
 namespace geometrize
 {
+class Shape;
 class ShapeMutator;
 }
 
+Q_DECLARE_METATYPE(std::string) ///< Script names, code and error messages passed from the image task worker thread to the UI.
+
 namespace geometrize
 {
 
@@ -24,8 +30,14 @@ namespace script
 
 /**
  * @brief The GeometrizerEngine class encapsulates setup and mutation methods for geometrizing shapes.
+ * Scripts are set up on the thread that runs the image task's steps, so listeners in other threads should connect with a context object.
+ * Each thread that sets up or mutates shapes gets a script engine of its own, built from the same scripts, so scripted shapes can be searched for on many threads at once.
+ * Shape functions whose scripts are unchanged from the defaults run as the equivalent native functions, so only customized functions pay for interpretation.
+ * The engine returned by getEngine is the one scripts are checked against and that the console uses, shapes are never set up or mutated with it.
+ * Scripts may also define batch mutation functions, such as mutateTriangleBatch(shapes, count), which the stepper prefers to mutating candidates one at a time.
+ * Evaluating the scripts and calling the scripted functions are recorded by the shared script profiler while it is enabled, see script/scriptprofiler.h.
  */
-class GeometrizerEngine : public QObject
+class GeometrizerEngine : public QObject, public geometrize::optimizer::BatchMutator
 {
     Q_OBJECT
 
@@ -55,6 +67,7 @@ public:
 
     /**
      * @brief setupScripts Sets the scripted setup and mutation rules on the current shape mutator.
+     * The per-thread engines evaluate the new scripts the next time each of their threads sets up or mutates a shape.
      * @param functions A map of function identifiers to Chaiscript code that will be added to the engine.
      * Note that this is not threadsafe. It must only be called when nothing is using the functions i.e. when related tasks are stopped.
      */
@@ -67,6 +80,19 @@ public:
      */
     void resetEngine(const std::map<std::string, std::string>& functions);
 
+    /**
+     * @brief canMutate Checks whether the scripts define a batch mutation function for the shape type, such as mutateTriangleBatch for triangles.
+     * @param type The shape type.
+     * @return True if the engine is enabled and the scripts define a batch mutation function for the type, else false.
+     */
+    bool canMutate(geometrize::ShapeTypes type) const override;
+
+    /**
+     * @brief mutate Passes the shapes to the batch mutation function for their type, running on the engine of the calling thread.
+     * @param shapes The shapes to mutate, all of a type for which canMutate returned true.
+     */
+    void mutate(std::vector<std::shared_ptr<geometrize::Shape>>& shapes) override;
+
     //void setPermittedShapeRegion() {}
     //void setIntProperty(const std::string& propName, int value);
 
@@ -0,0 +1,233 @@
+#include "scriptprofiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cereal/archives/json.hpp"
+#include "cereal/types/vector.hpp"
+
+#include "serialization/scriptprofiledata.h"
+
+namespace
+{
+
+// Gets the index of the highest set bit of a non-zero value
+std::uint32_t getHighestBit(std::uint64_t value)
+{
+    std::uint32_t bit{0};
+    while(value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+// Durations below four nanoseconds get a bucket each, longer ones are split into four buckets per power of two
+std::size_t getBucketIndex(const std::uint64_t nanoseconds)
+{
+    if(nanoseconds < 4) {
+        return static_cast<std::size_t>(nanoseconds);
+    }
+    const std::uint32_t bit{getHighestBit(nanoseconds)};
+    const std::uint64_t quarter{(nanoseconds >> (bit - 2)) & 3};
+    return static_cast<std::size_t>((bit - 1) * 4 + quarter);
+}
+
+// Gets the duration in the middle of a bucket
+double getBucketMidpoint(const std::size_t index)
+{
+    if(index < 4) {
+        return static_cast<double>(index);
+    }
+    const std::uint32_t bit{static_cast<std::uint32_t>(index / 4 + 1)};
+    const double lower{std::ldexp(static_cast<double>(4 + index % 4), static_cast<int>(bit) - 2)};
+    const double width{std::ldexp(1.0, static_cast<int>(bit) - 2)};
+    return lower + width / 2.0;
+}
+
+double toMilliseconds(const double nanoseconds)
+{
+    return nanoseconds / 1e6;
+}
+
+}
+
+namespace geometrize
+{
+
+namespace script
+{
+
+ScriptProfiler::Counter::Counter(const std::string& name) : m_name{name}, m_calls{0}, m_exceptions{0}, m_totalNanoseconds{0}, m_maxNanoseconds{0}
+{
+    for(std::atomic<std::uint64_t>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ScriptProfiler::Counter::record(const std::chrono::nanoseconds elapsed, const bool failed)
+{
+    const std::uint64_t nanoseconds{static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(0, elapsed.count()))};
+
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    if(failed) {
+        m_exceptions.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    m_buckets[getBucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+    std::uint64_t max{m_maxNanoseconds.load(std::memory_order_relaxed)};
+    while(nanoseconds > max && !m_maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+ScriptFunctionProfile ScriptProfiler::Counter::getProfile() const
+{
+    ScriptFunctionProfile profile;
+    profile.name = m_name;
+    profile.calls = m_calls.load(std::memory_order_relaxed);
+    profile.exceptions = m_exceptions.load(std::memory_order_relaxed);
+    profile.totalMilliseconds = toMilliseconds(static_cast<double>(m_totalNanoseconds.load(std::memory_order_relaxed)));
+    profile.maxMilliseconds = toMilliseconds(static_cast<double>(m_maxNanoseconds.load(std::memory_order_relaxed)));
+    if(profile.calls != 0) {
+        profile.meanMilliseconds = profile.totalMilliseconds / static_cast<double>(profile.calls);
+    }
+
+    // Calls may be recorded while the buckets are read, so the percentiles are taken from the bucket counts alone
+    std::array<std::uint64_t, bucketCount> buckets;
+    std::uint64_t count{0};
+    for(std::size_t i = 0; i < bucketCount; i++) {
+        buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    const auto getPercentile = [&buckets, count, &profile](const double fraction) {
+        const std::uint64_t rank{std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count))))};
+        std::uint64_t seen{0};
+        for(std::size_t i = 0; i < bucketCount; i++) {
+            seen += buckets[i];
+            if(seen >= rank) {
+                return std::min(toMilliseconds(getBucketMidpoint(i)), profile.maxMilliseconds);
+            }
+        }
+        return profile.maxMilliseconds;
+    };
+    if(count != 0) {
+        profile.p50Milliseconds = getPercentile(0.5);
+        profile.p90Milliseconds = getPercentile(0.9);
+        profile.p99Milliseconds = getPercentile(0.99);
+    }
+    return profile;
+}
+
+void ScriptProfiler::Counter::reset()
+{
+    m_calls.store(0, std::memory_order_relaxed);
+    m_exceptions.store(0, std::memory_order_relaxed);
+    m_totalNanoseconds.store(0, std::memory_order_relaxed);
+    m_maxNanoseconds.store(0, std::memory_order_relaxed);
+    for(std::atomic<std::uint64_t>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+ScriptProfiler::ScriptProfiler() : m_enabled{false}
+{
+}
+
+void ScriptProfiler::setEnabled(const bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool ScriptProfiler::isEnabled() const
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+ScriptProfiler::Counter& ScriptProfiler::getCounter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_countersMutex);
+    std::unique_ptr<Counter>& counter{m_counters[name]};
+    if(!counter) {
+        counter = std::make_unique<Counter>(name);
+    }
+    return *counter;
+}
+
+std::vector<ScriptFunctionProfile> ScriptProfiler::getProfiles() const
+{
+    std::vector<ScriptFunctionProfile> profiles;
+    {
+        std::lock_guard<std::mutex> lock(m_countersMutex);
+        for(const auto& entry : m_counters) {
+            ScriptFunctionProfile profile{entry.second->getProfile()};
+            if(profile.calls != 0) {
+                profiles.push_back(profile);
+            }
+        }
+    }
+
+    std::stable_sort(profiles.begin(), profiles.end(), [](const ScriptFunctionProfile& a, const ScriptFunctionProfile& b) {
+        return a.totalMilliseconds > b.totalMilliseconds;
+    });
+    return profiles;
+}
+
+void ScriptProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(m_countersMutex);
+    for(const auto& entry : m_counters) {
+        entry.second->reset();
+    }
+}
+
+ScriptProfiler& getSharedScriptProfiler()
+{
+    static ScriptProfiler profiler;
+    return profiler;
+}
+
+std::string formatScriptProfiles(const std::vector<ScriptFunctionProfile>& profiles)
+{
+    std::string text{"function, calls, exceptions, total ms, mean ms, p50 ms, p90 ms, p99 ms, max ms"};
+    for(const ScriptFunctionProfile& profile : profiles) {
+        char numbers[256];
+        std::snprintf(numbers, sizeof(numbers), ", %llu, %llu, %.3f, %.4f, %.4f, %.4f, %.4f, %.4f",
+                      static_cast<unsigned long long>(profile.calls), static_cast<unsigned long long>(profile.exceptions),
+                      profile.totalMilliseconds, profile.meanMilliseconds, profile.p50Milliseconds, profile.p90Milliseconds, profile.p99Milliseconds, profile.maxMilliseconds);
+        text += "\n" + profile.name + numbers;
+    }
+    return text;
+}
+
+bool writeScriptProfiles(const std::vector<ScriptFunctionProfile>& profiles, const std::string& filePath)
+{
+    std::ofstream file(filePath);
+    if(!file) {
+        return false;
+    }
+
+    try {
+        cereal::JSONOutputArchive archive(file);
+        archive(cereal::make_nvp("scriptProfiles", profiles));
+    } catch(...) {
+        return false;
+    }
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace geometrize
+{
+
+namespace script
+{
+
+/**
+ * @brief The ScriptFunctionProfile struct summarizes the calls made to one script function while profiling was enabled.
+ * Percentiles are read from a histogram with four buckets per power of two, so they are within about 12% of the true latencies.
+ */
+struct ScriptFunctionProfile
+{
+    std::string name; ///< The name of the script function, or of the script that was run.
+    std::uint64_t calls{0}; ///< The number of calls made.
+    std::uint64_t exceptions{0}; ///< The number of calls that ended by throwing an exception.
+    double totalMilliseconds{0.0}; ///< The time spent in all of the calls.
+    double meanMilliseconds{0.0}; ///< The mean time spent per call.
+    double p50Milliseconds{0.0}; ///< The median time spent per call.
+    double p90Milliseconds{0.0}; ///< The time that 90% of the calls took at most.
+    double p99Milliseconds{0.0}; ///< The time that 99% of the calls took at most.
+    double maxMilliseconds{0.0}; ///< The longest time spent in a single call.
+};
+
+/**
+ * @brief The ScriptProfiler class records how often script functions are called, how long the calls take and how many of them fail.
+ * Profiling is opt-in. While it is disabled, a profiled call costs a single relaxed atomic load on top of the call itself.
+ * Calls may be recorded from any thread at once, counters are updated without locking.
+ */
+class ScriptProfiler
+{
+public:
+    /**
+     * @brief The Counter class accumulates the calls made to one script function. Counters are never destroyed, so references to them stay valid.
+     */
+    class Counter
+    {
+    public:
+        explicit Counter(const std::string& name);
+        Counter& operator=(const Counter&) = delete;
+        Counter(const Counter&) = delete;
+        ~Counter() = default;
+
+        /**
+         * @brief record Records a call to the function.
+         * @param elapsed The time the call took.
+         * @param failed Whether the call ended by throwing an exception.
+         */
+        void record(std::chrono::nanoseconds elapsed, bool failed);
+
+        /**
+         * @brief getProfile Summarizes the calls recorded so far.
+         * @return The summary of the calls.
+         */
+        ScriptFunctionProfile getProfile() const;
+
+        /**
+         * @brief reset Forgets the calls recorded so far.
+         */
+        void reset();
+
+    private:
+        static const std::size_t bucketCount{256};
+
+        const std::string m_name; ///> The name of the function
+        std::atomic<std::uint64_t> m_calls; ///> The number of calls recorded
+        std::atomic<std::uint64_t> m_exceptions; ///> The number of calls that threw
+        std::atomic<std::uint64_t> m_totalNanoseconds; ///> The combined duration of the calls
+        std::atomic<std::uint64_t> m_maxNanoseconds; ///> The duration of the longest call
+        std::array<std::atomic<std::uint64_t>, bucketCount> m_buckets; ///> The number of calls by duration, four buckets per power of two nanoseconds
+    };
+
+    ScriptProfiler();
+    ScriptProfiler& operator=(const ScriptProfiler&) = delete;
+    ScriptProfiler(const ScriptProfiler&) = delete;
+    ~ScriptProfiler() = default;
+
+    /**
+     * @brief setEnabled Starts or stops recording calls. The calls recorded so far are kept.
+     * @param enabled Whether to record calls.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief isEnabled Returns true if calls are being recorded.
+     * @return True if calls are being recorded, else false.
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief getCounter Gets the counter for the named function, creating it if needed.
+     * This takes a lock, so callers on hot paths should look the counter up once and keep it.
+     * @param name The name of the function.
+     * @return The counter for the function.
+     */
+    Counter& getCounter(const std::string& name);
+
+    /**
+     * @brief getProfiles Summarizes the calls recorded for every function that has been called.
+     * @return The summaries, the function with the most time spent in it first.
+     */
+    std::vector<ScriptFunctionProfile> getProfiles() const;
+
+    /**
+     * @brief reset Forgets the calls recorded so far for every function.
+     */
+    void reset();
+
+    /**
+     * @brief profile Calls the function, recording its duration and any exception it throws against the counter while profiling is enabled.
+     * Exceptions are rethrown.
+     * @param counter The counter to record the call against.
+     * @param f The function to call.
+     */
+    template<typename F>
+    void profile(Counter& counter, F&& f) const
+    {
+        if(!isEnabled()) {
+            f();
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            f();
+        } catch(...) {
+            counter.record(std::chrono::steady_clock::now() - start, true);
+            throw;
+        }
+        counter.record(std::chrono::steady_clock::now() - start, false);
+    }
+
+private:
+    std::atomic<bool> m_enabled; ///> Whether calls are being recorded
+    mutable std::mutex m_countersMutex; ///> Guards the map of counters
+    std::map<std::string, std::unique_ptr<Counter>> m_counters; ///> The counter of each function, by function name
+};
+
+/**
+ * @brief getSharedScriptProfiler Gets the process-wide script profiler, which the geometrizer engines and script runner record calls with.
+ * @return The shared script profiler.
+ */
+ScriptProfiler& getSharedScriptProfiler();
+
+/**
+ * @brief formatScriptProfiles Formats script function profiles as a plain text table, one function per line.
+ * @param profiles The profiles to format.
+ * @return The table.
+ */
+std::string formatScriptProfiles(const std::vector<ScriptFunctionProfile>& profiles);
+
+/**
+ * @brief writeScriptProfiles Writes script function profiles to the given filepath as JSON. Will attempt to overwrite any existing file.
+ * @param profiles The profiles to write.
+ * @param filePath The path of the file to write to.
+ * @return True if the file was written, else false.
+ */
+bool writeScriptProfiles(const std::vector<ScriptFunctionProfile>& profiles, const std::string& filePath);
+
+}
+
+}
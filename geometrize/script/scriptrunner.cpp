@@ -6,6 +6,7 @@
 #include "chaiscript/chaiscript.hpp"
 
 #include "script/chaiscriptcreator.h"
+#include "script/scriptprofiler.h"
 
 namespace geometrize
 {
@@ -13,14 +14,17 @@ namespace geometrize
 namespace script
 {
 
-void runScript(const std::string& code, chaiscript::ChaiScript& runner)
+void runScript(const std::string& code, chaiscript::ChaiScript& runner, const std::string& name)
 {
     const QString errorTitle{QCoreApplication::translate("Script evaluation error dialog title", "Script evaluation failure", "Title of an error message dialog shown when the app fails to run a script")};
     const QString errorPreamble{QCoreApplication::translate("Script evaluation error message", "Could not evaluate script: %1", "Error message text shown when the app fails to run a script")};
     const QString unknownError{QCoreApplication::translate("Script evaluation unknown error", "Unknown script evaluation error", "Error message shown when the app fails to run a script, and has no additional information about the error")};
 
     try {
-        runner.eval(code);
+        ScriptProfiler& profiler{getSharedScriptProfiler()};
+        profiler.profile(profiler.getCounter(name), [&code, &runner]() {
+            runner.eval(code);
+        });
     } catch (const std::string& s) {
         QMessageBox::warning(nullptr, errorTitle, errorPreamble.arg(QString::fromStdString(s)));
     } catch (const std::exception& e) {
@@ -17,8 +17,9 @@ namespace script
  * @brief runScript Evaluates the provided script code.
  * @param code The script code to evaluate.
  * @param runner The engine that will evaluate the script.
+ * @param name The name the evaluation is recorded under by the shared script profiler, such as the path of the script file.
  */
-void runScript(const std::string& code, chaiscript::ChaiScript& runner);
+void runScript(const std::string& code, chaiscript::ChaiScript& runner, const std::string& name = "runScript");
 
 /**
  * @brief runScript Evaluates the provided script code, creating a fresh engine to evaluate the script.
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "cereal/cereal.hpp"
 #include "cereal/types/map.hpp"
@@ -9,9 +11,30 @@
 
 #include "geometrize/runner/imagerunneroptions.h"
 
+#include "optimizer/weightmask.h"
+
 namespace geometrize
 {
 
+namespace optimizer
+{
+
+template<class Archive>
+void serialize(Archive& ar, WeightRegion& region)
+{
+    // The shape goes through an integer so the same code reads and writes it
+    std::uint32_t shape{static_cast<std::uint32_t>(region.shape)};
+    ar(cereal::make_nvp("shape", shape));
+    region.shape = static_cast<WeightRegion::Shape>(shape);
+    ar(cereal::make_nvp("x1", region.x1));
+    ar(cereal::make_nvp("y1", region.y1));
+    ar(cereal::make_nvp("x2", region.x2));
+    ar(cereal::make_nvp("y2", region.y2));
+    ar(cereal::make_nvp("weight", region.weight));
+}
+
+}
+
 namespace serialization
 {
 
@@ -22,7 +45,10 @@ class ImageTaskPreferencesData
 {
 public:
     template<class Archive>
-    void archive(Archive& ar, geometrize::ImageRunnerOptions& options, bool& scriptsEnabled, std::map<std::string, std::string>& scripts)
+    void archive(Archive& ar, geometrize::ImageRunnerOptions& options, std::uint32_t& pyramidDepth, std::uint32_t& tileSize,
+                 float& targetSimilarity, std::uint32_t& timeLimit, std::uint32_t& shapeLimit,
+                 bool& regionOfInterestEnabled, std::vector<geometrize::optimizer::WeightRegion>& weightRegions, bool& errorGuidedSampling,
+                 std::uint32_t& searchesPerStep, bool& scriptsEnabled, std::map<std::string, std::string>& scripts)
     {
         ar(cereal::make_nvp(shapeAlphaKey, options.alpha));
         ar(cereal::make_nvp(maxShapeMutationsKey, options.maxShapeMutations));
@@ -30,18 +56,46 @@ public:
         ar(cereal::make_nvp(shapeTypesKey, options.shapeTypes));
         ar(cereal::make_nvp(randomSeedKey, options.seed));
         ar(cereal::make_nvp(maxThreadsKey, options.maxThreads));
+        optionalNvp(ar, pyramidDepthKey, pyramidDepth);
+        optionalNvp(ar, tileSizeKey, tileSize);
+        optionalNvp(ar, targetSimilarityKey, targetSimilarity);
+        optionalNvp(ar, timeLimitKey, timeLimit);
+        optionalNvp(ar, shapeLimitKey, shapeLimit);
+        optionalNvp(ar, regionOfInterestEnabledKey, regionOfInterestEnabled);
+        optionalNvp(ar, weightRegionsKey, weightRegions);
+        optionalNvp(ar, errorGuidedSamplingKey, errorGuidedSampling);
+        optionalNvp(ar, searchesPerStepKey, searchesPerStep);
 
         ar(cereal::make_nvp(scriptsEnabledKey, scriptsEnabled));
         ar(cereal::make_nvp(scriptsKey, scripts));
     }
 
 private:
+    // Reads or writes a value that older preference files may not contain, leaving the value untouched if the key is missing
+    template<class Archive, class T>
+    void optionalNvp(Archive& ar, const std::string& key, T& value)
+    {
+        try {
+            ar(cereal::make_nvp(key, value));
+        } catch(const cereal::Exception&) {
+        }
+    }
+
     const std::string shapeAlphaKey{"shapeAlpha"};
     const std::string maxShapeMutationsKey{"maxShapeMutations"};
     const std::string shapeCountKey{"shapeCount"};
     const std::string shapeTypesKey{"shapeTypes"};
     const std::string randomSeedKey{"randomSeed"};
     const std::string maxThreadsKey{"maxThreads"};
+    const std::string pyramidDepthKey{"pyramidDepth"};
+    const std::string tileSizeKey{"tileSize"};
+    const std::string targetSimilarityKey{"stopAtTargetSimilarity"};
+    const std::string timeLimitKey{"stopAfterSeconds"};
+    const std::string shapeLimitKey{"stopAfterShapes"};
+    const std::string regionOfInterestEnabledKey{"regionOfInterestEnabled"};
+    const std::string weightRegionsKey{"weightRegions"};
+    const std::string errorGuidedSamplingKey{"errorGuidedSampling"};
+    const std::string searchesPerStepKey{"searchesPerStep"};
 
     const std::string scriptsEnabledKey{"scriptModeEnabled"};
     const std::string scriptsKey{"scripts"};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "cereal/cereal.hpp"
+#include "cereal/types/string.hpp"
+
+#include "script/scriptprofiler.h"
+
+namespace geometrize
+{
+
+namespace script
+{
+
+template<class Archive>
+void serialize(Archive& ar, ScriptFunctionProfile& profile)
+{
+    ar(cereal::make_nvp("name", profile.name));
+    ar(cereal::make_nvp("calls", profile.calls));
+    ar(cereal::make_nvp("exceptions", profile.exceptions));
+    ar(cereal::make_nvp("totalMilliseconds", profile.totalMilliseconds));
+    ar(cereal::make_nvp("meanMilliseconds", profile.meanMilliseconds));
+    ar(cereal::make_nvp("p50Milliseconds", profile.p50Milliseconds));
+    ar(cereal::make_nvp("p90Milliseconds", profile.p90Milliseconds));
+    ar(cereal::make_nvp("p99Milliseconds", profile.p99Milliseconds));
+    ar(cereal::make_nvp("maxMilliseconds", profile.maxMilliseconds));
+}
+
+}
+
+}
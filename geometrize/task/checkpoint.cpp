@@ -0,0 +1,353 @@
+#include "checkpoint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <QSaveFile>
+#include <QString>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/model.h"
+#include "geometrize/shaperesult.h"
+#include "geometrize/shape/circle.h"
+#include "geometrize/shape/ellipse.h"
+#include "geometrize/shape/line.h"
+#include "geometrize/shape/polyline.h"
+#include "geometrize/shape/quadraticbezier.h"
+#include "geometrize/shape/rectangle.h"
+#include "geometrize/shape/rotatedellipse.h"
+#include "geometrize/shape/rotatedrectangle.h"
+#include "geometrize/shape/shape.h"
+#include "geometrize/shape/shapetypes.h"
+#include "geometrize/shape/triangle.h"
+
+#include "task/shapelog.h"
+
+namespace
+{
+
+const char checkpointMagic[8]{'G', 'E', 'O', 'M', 'C', 'K', 'P', 'T'}; // Identifies checkpoint files
+const std::uint32_t checkpointVersion{1}; // Bumped whenever the layout of checkpoint files changes
+
+// Appends the bytes of plain values to a buffer
+class Writer
+{
+public:
+    explicit Writer(std::string& out) : m_out{out}
+    {
+    }
+
+    template<typename T>
+    void operator()(const T& value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "Only arithmetic values can be written directly");
+        m_out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T, typename U>
+    void operator()(const std::vector<std::pair<T, U>>& points)
+    {
+        (*this)(static_cast<std::uint64_t>(points.size()));
+        for(const auto& point : points) {
+            (*this)(point.first);
+            (*this)(point.second);
+        }
+    }
+
+    void operator()(const std::string& bytes)
+    {
+        (*this)(static_cast<std::uint64_t>(bytes.size()));
+        m_out.append(bytes);
+    }
+
+    void operator()(const geometrize::rgba& color)
+    {
+        (*this)(color.r);
+        (*this)(color.g);
+        (*this)(color.b);
+        (*this)(color.a);
+    }
+
+    void operator()(const geometrize::Bitmap& bitmap)
+    {
+        const std::vector<std::uint8_t>& data{bitmap.getDataRef()};
+        (*this)(bitmap.getWidth());
+        (*this)(bitmap.getHeight());
+        (*this)(static_cast<std::uint64_t>(data.size()));
+        m_out.append(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+private:
+    std::string& m_out;
+};
+
+// Reads plain values back out of a buffer, failing rather than reading past the end
+class Reader
+{
+public:
+    Reader(const std::string& in, const std::size_t position) : m_in{in}, m_position{position}, m_ok{true}
+    {
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+    std::size_t getPosition() const
+    {
+        return m_position;
+    }
+
+    template<typename T>
+    void operator()(T& value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "Only arithmetic values can be read directly");
+        if(!take(sizeof(T))) {
+            return;
+        }
+        std::memcpy(&value, m_in.data() + m_position - sizeof(T), sizeof(T));
+    }
+
+    template<typename T, typename U>
+    void operator()(std::vector<std::pair<T, U>>& points)
+    {
+        std::uint64_t count{0};
+        (*this)(count);
+        if(!m_ok || count > (m_in.size() - m_position) / (sizeof(T) + sizeof(U))) {
+            m_ok = false;
+            return;
+        }
+        points.resize(static_cast<std::size_t>(count));
+        for(auto& point : points) {
+            (*this)(point.first);
+            (*this)(point.second);
+        }
+    }
+
+    void operator()(std::string& bytes)
+    {
+        std::uint64_t size{0};
+        (*this)(size);
+        if(!m_ok || !take(static_cast<std::size_t>(size))) {
+            m_ok = false;
+            return;
+        }
+        bytes.assign(m_in.data() + m_position - size, static_cast<std::size_t>(size));
+    }
+
+    void operator()(geometrize::rgba& color)
+    {
+        (*this)(color.r);
+        (*this)(color.g);
+        (*this)(color.b);
+        (*this)(color.a);
+    }
+
+    std::unique_ptr<geometrize::Bitmap> readBitmap()
+    {
+        std::uint32_t width{0};
+        std::uint32_t height{0};
+        std::uint64_t size{0};
+        (*this)(width);
+        (*this)(height);
+        (*this)(size);
+        if(!m_ok || size != static_cast<std::uint64_t>(width) * height * 4U || !take(static_cast<std::size_t>(size))) {
+            m_ok = false;
+            return nullptr;
+        }
+        const auto first = reinterpret_cast<const std::uint8_t*>(m_in.data() + m_position - size);
+        return std::make_unique<geometrize::Bitmap>(width, height, std::vector<std::uint8_t>(first, first + size));
+    }
+
+private:
+    bool take(const std::size_t size)
+    {
+        if(!m_ok || size > m_in.size() - m_position) {
+            m_ok = false;
+            return false;
+        }
+        m_position += size;
+        return true;
+    }
+
+    const std::string& m_in;
+    std::size_t m_position;
+    bool m_ok;
+};
+
+// Visits the fields that make up each type of shape, the same fields that the script bindings expose
+template<typename F> void visitFields(geometrize::Rectangle& s, F& f) { f(s.m_x1); f(s.m_y1); f(s.m_x2); f(s.m_y2); }
+template<typename F> void visitFields(geometrize::RotatedRectangle& s, F& f) { f(s.m_x1); f(s.m_y1); f(s.m_x2); f(s.m_y2); f(s.m_angle); }
+template<typename F> void visitFields(geometrize::Triangle& s, F& f) { f(s.m_x1); f(s.m_y1); f(s.m_x2); f(s.m_y2); f(s.m_x3); f(s.m_y3); }
+template<typename F> void visitFields(geometrize::Ellipse& s, F& f) { f(s.m_x); f(s.m_y); f(s.m_rx); f(s.m_ry); }
+template<typename F> void visitFields(geometrize::RotatedEllipse& s, F& f) { f(s.m_x); f(s.m_y); f(s.m_rx); f(s.m_ry); f(s.m_angle); }
+template<typename F> void visitFields(geometrize::Circle& s, F& f) { f(s.m_x); f(s.m_y); f(s.m_r); }
+template<typename F> void visitFields(geometrize::Line& s, F& f) { f(s.m_x1); f(s.m_y1); f(s.m_x2); f(s.m_y2); }
+template<typename F> void visitFields(geometrize::QuadraticBezier& s, F& f) { f(s.m_cx); f(s.m_cy); f(s.m_x1); f(s.m_y1); f(s.m_x2); f(s.m_y2); }
+template<typename F> void visitFields(geometrize::Polyline& s, F& f) { f(s.m_points); }
+
+template<typename T>
+void writeShape(const geometrize::Shape& shape, Writer& writer)
+{
+    // The writer only reads the fields, the visitors take them by non-const reference so that reading can share them
+    visitFields(const_cast<T&>(static_cast<const T&>(shape)), writer);
+}
+
+template<typename T>
+std::shared_ptr<geometrize::Shape> readShape(const geometrize::Model& model, Reader& reader)
+{
+    std::shared_ptr<T> shape{std::make_shared<T>(model)};
+    visitFields(*shape, reader);
+    return shape;
+}
+
+bool encodeShape(const geometrize::Shape& shape, Writer& writer)
+{
+    switch(shape.getType()) {
+    case geometrize::RECTANGLE: writeShape<geometrize::Rectangle>(shape, writer); return true;
+    case geometrize::ROTATED_RECTANGLE: writeShape<geometrize::RotatedRectangle>(shape, writer); return true;
+    case geometrize::TRIANGLE: writeShape<geometrize::Triangle>(shape, writer); return true;
+    case geometrize::ELLIPSE: writeShape<geometrize::Ellipse>(shape, writer); return true;
+    case geometrize::ROTATED_ELLIPSE: writeShape<geometrize::RotatedEllipse>(shape, writer); return true;
+    case geometrize::CIRCLE: writeShape<geometrize::Circle>(shape, writer); return true;
+    case geometrize::LINE: writeShape<geometrize::Line>(shape, writer); return true;
+    case geometrize::QUADRATIC_BEZIER: writeShape<geometrize::QuadraticBezier>(shape, writer); return true;
+    case geometrize::POLYLINE: writeShape<geometrize::Polyline>(shape, writer); return true;
+    default: return false;
+    }
+}
+
+std::shared_ptr<geometrize::Shape> decodeShape(const std::uint32_t type, const geometrize::Model& model, Reader& reader)
+{
+    switch(type) {
+    case geometrize::RECTANGLE: return readShape<geometrize::Rectangle>(model, reader);
+    case geometrize::ROTATED_RECTANGLE: return readShape<geometrize::RotatedRectangle>(model, reader);
+    case geometrize::TRIANGLE: return readShape<geometrize::Triangle>(model, reader);
+    case geometrize::ELLIPSE: return readShape<geometrize::Ellipse>(model, reader);
+    case geometrize::ROTATED_ELLIPSE: return readShape<geometrize::RotatedEllipse>(model, reader);
+    case geometrize::CIRCLE: return readShape<geometrize::Circle>(model, reader);
+    case geometrize::LINE: return readShape<geometrize::Line>(model, reader);
+    case geometrize::QUADRATIC_BEZIER: return readShape<geometrize::QuadraticBezier>(model, reader);
+    case geometrize::POLYLINE: return readShape<geometrize::Polyline>(model, reader);
+    default: return nullptr;
+    }
+}
+
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+Checkpoint::Checkpoint(const Bitmap& target, const Bitmap& current) : target{target}, current{current}
+{
+}
+
+bool writeCheckpoint(const Checkpoint& checkpoint, const std::string& filePath)
+{
+    std::string data;
+    Writer writer(data);
+    data.append(checkpointMagic, sizeof(checkpointMagic));
+    writer(checkpointVersion);
+    writer(checkpoint.stepIndex);
+    writer(checkpoint.preferences);
+    writer(checkpoint.target);
+    writer(checkpoint.current);
+
+    writer(static_cast<std::uint64_t>(checkpoint.shapes.size()));
+    for(const geometrize::ShapeResult& result : checkpoint.shapes) {
+        writer(static_cast<std::uint32_t>(result.shape->getType()));
+        writer(result.color);
+        writer(result.score);
+        if(!encodeShape(*result.shape, writer)) {
+            return false;
+        }
+    }
+
+    // Written to a temporary file that replaces the old checkpoint once complete
+    QSaveFile file(QString::fromStdString(filePath));
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    if(file.write(data.data(), static_cast<qint64>(data.size())) != static_cast<qint64>(data.size())) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+std::unique_ptr<Checkpoint> readCheckpoint(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if(!file) {
+        return nullptr;
+    }
+    const std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if(data.size() < sizeof(checkpointMagic) || data.compare(0, sizeof(checkpointMagic), checkpointMagic, sizeof(checkpointMagic)) != 0) {
+        return nullptr;
+    }
+
+    Reader reader(data, sizeof(checkpointMagic));
+    std::uint32_t version{0};
+    std::uint64_t stepIndex{0};
+    std::string preferences;
+    reader(version);
+    if(!reader.ok() || version != checkpointVersion) {
+        return nullptr;
+    }
+    reader(stepIndex);
+    reader(preferences);
+    const std::unique_ptr<Bitmap> target{reader.readBitmap()};
+    const std::unique_ptr<Bitmap> current{reader.readBitmap()};
+    std::uint64_t shapeCount{0};
+    reader(shapeCount);
+    if(!reader.ok() || target->getWidth() != current->getWidth() || target->getHeight() != current->getHeight()) {
+        return nullptr;
+    }
+
+    auto checkpoint = std::make_unique<Checkpoint>(*target, *current);
+    checkpoint->stepIndex = stepIndex;
+    checkpoint->preferences = preferences;
+    checkpoint->shapeCount = shapeCount;
+    checkpoint->encodedShapes = data.substr(reader.getPosition());
+    return checkpoint;
+}
+
+bool decodeCheckpointShapes(const Checkpoint& checkpoint, const geometrize::Model& model, std::vector<geometrize::ShapeResult>& shapes)
+{
+    Reader reader(checkpoint.encodedShapes, 0);
+    shapes.clear();
+    for(std::uint64_t i = 0; i < checkpoint.shapeCount; i++) {
+        std::uint32_t type{0};
+        geometrize::rgba color{0, 0, 0, 0};
+        float score{0.0f};
+        reader(type);
+        reader(color);
+        reader(score);
+        if(!reader.ok()) {
+            return false;
+        }
+        const std::shared_ptr<geometrize::Shape> shape{decodeShape(type, model, reader)};
+        if(!shape || !reader.ok()) {
+            return false;
+        }
+        shapes.push_back(geometrize::ShapeResult{score, color, shape});
+    }
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geometrize/bitmap/bitmap.h"
+#include "geometrize/shaperesult.h"
+
+#include "task/shapelog.h"
+
+namespace geometrize
+{
+class Model;
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+/**
+ * @brief The Checkpoint struct holds everything needed to resume an image task exactly where it left off.
+ * The random numbers each step uses are derived from the seed in the preferences and the step index alone, so these together restore the random state too.
+ */
+struct Checkpoint
+{
+    Checkpoint(const Bitmap& target, const Bitmap& current);
+
+    Bitmap target; ///< The target image.
+    Bitmap current; ///< The image that the shapes have been drawn on so far.
+    ShapeLogView shapes; ///< The shapes added so far, written out by writeCheckpoint. Empty for checkpoints that were read from a file.
+    std::string encodedShapes; ///< The shapes of a checkpoint that was read from a file, turned back into shapes by decodeCheckpointShapes.
+    std::uint64_t shapeCount{0}; ///< The number of shapes in encodedShapes.
+    std::string preferences; ///< The image task preferences, see ImageTaskPreferences::saveToString.
+    std::uint64_t stepIndex{0}; ///< The number of steps taken so far, see Stepper::getStepIndex.
+};
+
+/**
+ * @brief writeCheckpoint Writes a checkpoint to a binary file. The file is replaced atomically, so an interrupted write leaves the previous checkpoint intact.
+ * Checkpoints are written in the byte order of the machine, and are meant for resuming on the machine that wrote them.
+ * @param checkpoint The checkpoint to write.
+ * @param filePath The path to write the checkpoint to.
+ * @return True if the checkpoint was written, else false.
+ */
+bool writeCheckpoint(const Checkpoint& checkpoint, const std::string& filePath);
+
+/**
+ * @brief readCheckpoint Reads a checkpoint from a file written by writeCheckpoint.
+ * @param filePath The path to the checkpoint file.
+ * @return The checkpoint, or nullptr if the file could not be read or is not a checkpoint.
+ */
+std::unique_ptr<Checkpoint> readCheckpoint(const std::string& filePath);
+
+/**
+ * @brief decodeCheckpointShapes Turns the shapes of a checkpoint read from a file back into shapes.
+ * This is separate from reading the checkpoint because shapes refer to the model they belong to, which is created from the checkpoint's images.
+ * @param checkpoint The checkpoint, as returned by readCheckpoint.
+ * @param model The model that the shapes will belong to.
+ * @param shapes The decoded shapes, in the order they were added.
+ * @return True if the shapes were decoded, else false.
+ */
+bool decodeCheckpointShapes(const Checkpoint& checkpoint, const geometrize::Model& model, std::vector<geometrize::ShapeResult>& shapes);
+
+}
+
+}
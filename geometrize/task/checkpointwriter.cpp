@@ -0,0 +1,118 @@
+#include "checkpointwriter.h"
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "task/checkpoint.h"
+
+namespace geometrize
+{
+
+namespace task
+{
+
+class CheckpointWriter::CheckpointWriterImpl
+{
+public:
+    CheckpointWriterImpl() : m_writing{false}, m_stopping{false}
+    {
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    ~CheckpointWriterImpl()
+    {
+        // Checkpoints that are still pending are written before the thread exits, they may be the last ones a run produces
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    CheckpointWriterImpl& operator=(const CheckpointWriterImpl&) = delete;
+    CheckpointWriterImpl(const CheckpointWriterImpl&) = delete;
+
+    void submit(std::shared_ptr<const Checkpoint> checkpoint, const std::string& filePath)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending[filePath] = std::move(checkpoint);
+        }
+        m_wake.notify_all();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_pending.empty() && !m_writing; });
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(true) {
+            m_wake.wait(lock, [this]() { return !m_pending.empty() || m_stopping; });
+            if(m_pending.empty()) {
+                return;
+            }
+
+            const auto next = m_pending.begin();
+            const std::string filePath{next->first};
+            const std::shared_ptr<const Checkpoint> checkpoint{std::move(next->second)};
+            m_pending.erase(next);
+            m_writing = true;
+
+            lock.unlock();
+            writeCheckpoint(*checkpoint, filePath);
+            lock.lock();
+
+            m_writing = false;
+            if(m_pending.empty()) {
+                m_idle.notify_all();
+            }
+        }
+    }
+
+    std::mutex m_mutex; ///> Guards the pending checkpoints and the writer state
+    std::condition_variable m_wake; ///> Signalled when a checkpoint is submitted or the writer is stopping
+    std::condition_variable m_idle; ///> Signalled when every pending checkpoint has been written
+    std::map<std::string, std::shared_ptr<const Checkpoint>> m_pending; ///> The latest checkpoint waiting to be written for each file
+    bool m_writing; ///> Whether a checkpoint is being written right now
+    bool m_stopping; ///> Whether the writer thread should exit once the pending checkpoints are written
+    std::thread m_thread; ///> The thread that encodes and writes the checkpoints
+};
+
+CheckpointWriter::CheckpointWriter() : d{std::make_unique<CheckpointWriter::CheckpointWriterImpl>()}
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+}
+
+void CheckpointWriter::submit(std::shared_ptr<const Checkpoint> checkpoint, const std::string& filePath)
+{
+    d->submit(std::move(checkpoint), filePath);
+}
+
+void CheckpointWriter::flush()
+{
+    d->flush();
+}
+
+CheckpointWriter& getSharedCheckpointWriter()
+{
+    static CheckpointWriter writer;
+    return writer;
+}
+
+}
+
+}
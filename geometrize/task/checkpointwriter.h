@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace geometrize
+{
+
+namespace task
+{
+
+struct Checkpoint;
+
+/**
+ * @brief The CheckpointWriter class writes checkpoints to disk on a background thread, so tasks never wait on encoding or file IO.
+ * Only the latest checkpoint submitted for each file is written. A checkpoint that is superseded before the writer gets to it is dropped.
+ */
+class CheckpointWriter
+{
+public:
+    CheckpointWriter();
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    ~CheckpointWriter();
+
+    /**
+     * @brief submit Queues a checkpoint to be written, replacing any checkpoint for the same file that has not been written yet. This may be called from any thread.
+     * @param checkpoint The checkpoint to write. It must not be modified afterwards.
+     * @param filePath The path to write the checkpoint to.
+     */
+    void submit(std::shared_ptr<const Checkpoint> checkpoint, const std::string& filePath);
+
+    /**
+     * @brief flush Blocks until every checkpoint submitted so far has been written.
+     */
+    void flush();
+
+private:
+    class CheckpointWriterImpl;
+    std::unique_ptr<CheckpointWriterImpl> d;
+};
+
+/**
+ * @brief getSharedCheckpointWriter Gets the process-wide checkpoint writer, which writes the checkpoints of every image task on one background thread.
+ * @return The shared checkpoint writer.
+ */
+CheckpointWriter& getSharedCheckpointWriter();
+
+}
+
+}
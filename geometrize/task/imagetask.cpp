@@ -1,10 +1,21 @@
 #include "imagetask.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
-#include <QThread>
+#include <QMetaObject>
 
 #include "geometrize/commonutil.h"
 #include "geometrize/bitmap/bitmap.h"
@@ -13,9 +24,69 @@
 #include "geometrize/shaperesult.h"
 #include "geometrize/shape/rectangle.h"
 
+#include "optimizer/cancellation.h"
+#include "optimizer/weightmask.h"
+
 #include "preferences/imagetaskpreferences.h"
 #include "script/geometrizerengine.h"
+#include "task/checkpoint.h"
+#include "task/checkpointwriter.h"
 #include "task/imagetaskworker.h"
+#include "task/keyframes.h"
+#include "task/shapelog.h"
+#include "task/stopconditions.h"
+#include "task/taskscheduler.h"
+
+namespace
+{
+
+// The preferences that a step reads, copied on the task's thread so the worker never reads preferences while they are being edited
+struct StepSettings
+{
+    geometrize::ImageRunnerOptions options;
+    std::uint32_t pyramidDepth{0};
+    std::uint32_t tileSize{0};
+    bool regionOfInterestEnabled{false};
+    std::vector<geometrize::optimizer::WeightRegion> weightRegions;
+    bool errorGuidedSampling{false};
+    std::uint32_t searchesPerStep{4};
+    geometrize::task::StopConditions stopConditions;
+    bool scriptModeEnabled{false};
+    std::map<std::string, std::string> scripts;
+    std::uint64_t scriptsRevision{0};
+    std::string checkpointPath;
+    std::uint32_t checkpointInterval{0};
+};
+
+// Rebuilds the preferences that a step was taken with, for saving in checkpoints
+geometrize::preferences::ImageTaskPreferences toPreferences(const StepSettings& settings)
+{
+    geometrize::preferences::ImageTaskPreferences preferences;
+    preferences.setShapeTypes(settings.options.shapeTypes);
+    preferences.setShapeAlpha(settings.options.alpha);
+    preferences.setCandidateShapeCount(settings.options.shapeCount);
+    preferences.setMaxShapeMutations(settings.options.maxShapeMutations);
+    preferences.setSeed(settings.options.seed);
+    preferences.setMaxThreads(settings.options.maxThreads);
+    preferences.setPyramidDepth(settings.pyramidDepth);
+    preferences.setTileSize(settings.tileSize);
+    preferences.setRegionOfInterestEnabled(settings.regionOfInterestEnabled);
+    preferences.setWeightRegions(settings.weightRegions);
+    preferences.setErrorGuidedSamplingEnabled(settings.errorGuidedSampling);
+    preferences.setSearchesPerStep(settings.searchesPerStep);
+    preferences.setTargetSimilarity(settings.stopConditions.targetSimilarity);
+    preferences.setTimeLimit(settings.stopConditions.timeLimit);
+    preferences.setShapeLimit(settings.stopConditions.shapeLimit);
+    preferences.setScriptModeEnabled(settings.scriptModeEnabled);
+    preferences.setScripts(settings.scripts);
+    return preferences;
+}
+
+const std::chrono::milliseconds runBatchDuration{33}; // The time that a batch of steps should take while running, so the views still update smoothly
+const std::size_t maxRunBatchSize{256}; // The maximum number of steps in one batch while running
+const std::size_t keyframeInterval{256}; // The number of shapes between keyframes of the current image, the most shapes that rewinding has to redraw
+
+}
 
 namespace geometrize
 {
@@ -27,26 +98,34 @@ class ImageTask::ImageTaskImpl
 {
 public:
     ImageTaskImpl(ImageTask* pQ, const std::string& displayName, Bitmap& bitmap, Qt::ConnectionType workerConnectionType) :
-        q{pQ}, m_preferences{}, m_displayName{displayName}, m_id{getId()}, m_worker{bitmap}
+        q{pQ}, m_preferences{}, m_displayName{displayName}, m_id{getId()}, m_scheduler{getSharedTaskScheduler()}, m_schedulerId{m_scheduler.addTask()}, m_synchronous{workerConnectionType == Qt::DirectConnection}, m_worker{bitmap},
+        m_running{false}, m_runId{0}, m_publishedCount{0}, m_publishPosted{false}, m_willStepPosted{false}, m_keyframes{keyframeInterval}, m_checkpointInterval{0}, m_lastCheckpoint{std::chrono::steady_clock::now()}
     {
-        init(workerConnectionType);
+        init();
     }
 
     ImageTaskImpl(ImageTask* pQ, const std::string& displayName, Bitmap& bitmap, const Bitmap& initial, Qt::ConnectionType workerConnectionType) :
-        q{pQ}, m_preferences{}, m_displayName{displayName}, m_id{getId()}, m_worker{bitmap, initial}
+        q{pQ}, m_preferences{}, m_displayName{displayName}, m_id{getId()}, m_scheduler{getSharedTaskScheduler()}, m_schedulerId{m_scheduler.addTask()}, m_synchronous{workerConnectionType == Qt::DirectConnection}, m_worker{bitmap, initial},
+        m_running{false}, m_runId{0}, m_publishedCount{0}, m_publishPosted{false}, m_willStepPosted{false}, m_keyframes{keyframeInterval}, m_checkpointInterval{0}, m_lastCheckpoint{std::chrono::steady_clock::now()}
     {
-        init(workerConnectionType);
+        init();
     }
 
     ~ImageTaskImpl()
     {
         disconnectAll();
 
-        m_workerThread.quit();
-        if(!m_workerThread.wait(1000)) {
-            m_workerThread.terminate();
-            m_workerThread.wait();
+        // Stops a run without announcing it, so the batch in progress does not queue another
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_running = false;
+            m_runId++;
         }
+
+        // Aborts the step in progress, if any, then drops the steps that have not started and waits for the aborted one to return
+        // The search checks for cancellation between candidates and mutations, so this only blocks for milliseconds
+        m_worker.cancel();
+        m_scheduler.removeTask(m_schedulerId);
     }
 
     ImageTaskImpl& operator=(const ImageTaskImpl&) = delete;
@@ -77,14 +156,26 @@ public:
         return m_worker.getCurrent();
     }
 
+    std::shared_ptr<const Bitmap> getCurrentSnapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_publishedSnapshot;
+    }
+
+    std::shared_ptr<const Bitmap> getTargetSnapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_targetSnapshot;
+    }
+
     std::uint32_t getWidth() const
     {
-        return m_worker.getCurrent().getWidth();
+        return m_width;
     }
 
     std::uint32_t getHeight() const
     {
-        return m_worker.getCurrent().getHeight();
+        return m_height;
     }
 
     ShapeMutator& getShapeMutator()
@@ -107,40 +198,217 @@ public:
         return m_worker.isStepping();
     }
 
-    void stepModel()
+    void stepModel(const std::size_t count)
     {
-        emit q->signal_step(m_preferences.getImageRunnerOptions());
+        const StepSettings settings{captureSettings()};
+
+        // The token is taken now rather than when the job starts, so cancelling also discards this step if it is still queued
+        const geometrize::optimizer::CancellationToken token{m_worker.getCancellationToken()};
+        runOnWorker([this, settings, count, token]() {
+            applySettings(settings);
+            stepToKeyframes(settings.options, count, token);
+            checkpoint(settings, false);
+        });
+    }
+
+    void startRunning(const std::size_t maxSteps)
+    {
+        std::uint64_t runId{0};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            if(m_running) {
+                return;
+            }
+            m_running = true;
+            runId = ++m_runId;
+            m_runSettings = captureSettings();
+        }
+        emit q->signal_runningChanged(true);
+
+        // The time limit is a budget for each run, so a run that stopped at the limit can be started again without raising it
+        runOnWorker([this, runId, maxSteps]() {
+            m_worker.resetStepTime();
+            runBatches(runId, maxSteps);
+        });
+    }
+
+    void stopRunning()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            if(!m_running) {
+                return;
+            }
+            m_running = false;
+            m_runId++;
+        }
+        m_worker.cancel();
+        emit q->signal_runningChanged(false);
+    }
+
+    bool isRunning() const
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_running;
+    }
+
+    void switchCurrent(const Bitmap& current)
+    {
+        assert(current.getWidth() == m_width && current.getHeight() == m_height);
+
+        // Swapped on the worker like the target, so the image is never written while a step is drawing into it
+        m_worker.cancel();
+        runOnWorker([this, current]() {
+            m_worker.getCurrent() = current;
+            m_worker.resetStepper();
+            m_keyframes.add(m_shapes.size(), m_worker.getCurrent());
+            takeSnapshot(true);
+        });
+    }
+
+    void switchTarget(const Bitmap& target)
+    {
+        assert(target.getWidth() == m_width && target.getHeight() == m_height);
+
+        // The task's thread reads the new image from now on, and the worker shares the same copy
+        std::shared_ptr<const Bitmap> snapshot{std::make_shared<const Bitmap>(target)};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_targetSnapshot = snapshot;
+        }
+
+        // Abort the step in progress and swap the image on the worker, so the swap never happens in the middle of a step
+        // A run carries on with its next batch once the swap is done
+        m_worker.cancel();
+        runOnWorker([this, snapshot]() {
+            m_worker.getTarget() = *snapshot;
+            m_worker.resetStepper();
+        });
+    }
+
+    void rewindTo(const std::size_t shapeCount)
+    {
+        // A run would carry on from the point it was at, so it is stopped, and the step in progress is dropped rather than waited for
+        stopRunning();
+        m_worker.cancel();
+        runOnWorker([this, shapeCount]() { rewind(shapeCount); });
+    }
+
+    void cancelSteps()
+    {
+        m_worker.cancel();
+    }
+
+    void imagesChanged()
+    {
+        m_worker.resetStepper();
+
+        // A replaced current image cannot be rebuilt from the earlier keyframes, so rewinding to this point or later starts from a keyframe of the new image
+        runOnWorker([this]() {
+            m_keyframes.add(m_shapes.size(), m_worker.getCurrent());
+            takeSnapshot(true);
+        });
     }
 
     void drawShape(std::shared_ptr<geometrize::Shape> shape, const geometrize::rgba color)
     {
-        emit q->signal_drawShape(shape, color);
+        runOnWorker([this, shape, color]() { m_worker.drawShape(shape, color); });
     }
 
     void drawBackgroundRectangle()
     {
-        const geometrize::rgba color{geometrize::commonutil::getAverageImageColor(m_worker.getRunner().getTarget())};
-        const std::shared_ptr<geometrize::Rectangle> rectangle = std::make_shared<geometrize::Rectangle>(m_worker.getRunner().getModel());
-        rectangle->m_x1 = 0;
-        rectangle->m_x2 = m_worker.getTarget().getWidth();
-        rectangle->m_y1 = 0;
-        rectangle->m_y2 = m_worker.getTarget().getHeight();
-        emit q->signal_drawShape(rectangle, color);
+        // The color is worked out on the worker, where the target is swapped, so it comes from the target that the rectangle is drawn against
+        runOnWorker([this]() {
+            const geometrize::rgba color{geometrize::commonutil::getAverageImageColor(m_worker.getTarget())};
+            const std::shared_ptr<geometrize::Rectangle> rectangle = std::make_shared<geometrize::Rectangle>(m_worker.getRunner().getModel());
+            rectangle->m_x1 = 0;
+            rectangle->m_x2 = m_width;
+            rectangle->m_y1 = 0;
+            rectangle->m_y2 = m_height;
+            m_worker.drawShape(rectangle, color);
+        });
+    }
+
+    ShapeLogView getShapes() const
+    {
+        return m_shapes.getView();
+    }
+
+    ShapeLogView getPublishedShapes() const
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_shapes.getView().slice(0, m_publishedCount);
+    }
+
+    geometrize::optimizer::Arena::Statistics getAllocationStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_allocationStatistics;
+    }
+
+    void setCheckpointFile(const std::string& filePath, const std::uint32_t intervalSeconds)
+    {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        m_checkpointPath = filePath;
+        m_checkpointInterval = intervalSeconds;
+        m_runSettings = captureSettings();
+    }
+
+    void saveCheckpoint()
+    {
+        const StepSettings settings{captureSettings()};
+        runOnWorker([this, settings]() { checkpoint(settings, true); });
+    }
+
+    void setPriority(const int priority)
+    {
+        m_scheduler.setPriority(m_schedulerId, priority);
+    }
+
+    int getPriority() const
+    {
+        return m_scheduler.getPriority(m_schedulerId);
+    }
+
+    void setWeight(const std::uint32_t weight)
+    {
+        m_scheduler.setWeight(m_schedulerId, weight);
+    }
+
+    std::uint32_t getWeight() const
+    {
+        return m_scheduler.getWeight(m_schedulerId);
     }
 
     void modelWillStep()
     {
-        emit q->signal_modelWillStep();
+        // Called on the worker, at most one notification is waiting on the task's thread at a time
+        if(m_synchronous) {
+            emit q->signal_modelWillStep();
+        } else if(!m_willStepPosted.exchange(true)) {
+            QMetaObject::invokeMethod(q, [this]() {
+                m_willStepPosted = false;
+                emit q->signal_modelWillStep();
+            }, Qt::QueuedConnection);
+        }
     }
 
-    void modelDidStep(std::vector<geometrize::ShapeResult> shapes)
+    void modelDidStep(const std::vector<geometrize::ShapeResult>& shapes)
     {
-        m_geometrizer.setEnabled(m_preferences.isScriptModeEnabled());
-        if(m_preferences.isScriptModeEnabled()) {
-            m_geometrizer.setupScripts(m_preferences.getScripts());
+        // Called on the worker. Shapes pile up until the task's thread gets round to publishing them, so a busy UI
+        // receives one update carrying everything added since the last one instead of a backlog of small ones
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_shapes.append(shapes);
+            m_allocationStatistics = m_worker.getAllocationStatistics();
         }
 
-        emit q->signal_modelDidStep(shapes);
+        // The current image holds exactly the shapes in the log at this point, so this is where keyframes and snapshots are taken
+        const std::size_t shapeCount{m_shapes.size()};
+        if(m_keyframes.isDue(shapeCount)) {
+            m_keyframes.add(shapeCount, m_worker.getCurrent());
+        }
+        takeSnapshot(false);
     }
 
     preferences::ImageTaskPreferences& getPreferences()
@@ -151,6 +419,10 @@ public:
     void setPreferences(const preferences::ImageTaskPreferences preferences)
     {
         m_preferences = preferences;
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_runSettings = captureSettings();
+        }
         emit q->signal_preferencesSet();
     }
 
@@ -161,33 +433,342 @@ private:
         return id++;
     }
 
-    void init(const Qt::ConnectionType connectionType)
+    void init()
     {
         m_geometrizer.setMutator(&m_worker.getRunner().getModel().getShapeMutator());
 
-        qRegisterMetaType<std::vector<geometrize::ShapeResult>>();
+        qRegisterMetaType<geometrize::task::ShapeLogView>();
+        qRegisterMetaType<geometrize::task::StopReason>();
         qRegisterMetaType<geometrize::ImageRunnerOptions>();
         qRegisterMetaType<std::shared_ptr<geometrize::Shape>>();
         qRegisterMetaType<geometrize::rgba>();
 
-        m_worker.moveToThread(&m_workerThread);
-        m_workerThread.start();
+        m_width = m_worker.getTarget().getWidth();
+        m_height = m_worker.getTarget().getHeight();
+        m_targetSnapshot = std::make_shared<const Bitmap>(m_worker.getTarget());
 
-        connectSignals(connectionType);
+        // Nothing is on the worker yet, so the keyframe and snapshot of the starting image are taken here
+        m_keyframes.add(0, m_worker.getCurrent());
+        m_publishedSnapshot = std::make_shared<const Bitmap>(m_worker.getCurrent());
+
+        connectSignals();
     }
 
-    void connectSignals(const Qt::ConnectionType connectionType)
+    StepSettings captureSettings() const
     {
-        q->connect(q, &ImageTask::signal_step, &m_worker, &ImageTaskWorker::step, connectionType);
-        q->connect(q, &ImageTask::signal_drawShape, &m_worker, &ImageTaskWorker::drawShape, connectionType);
-        q->connect(&m_worker, &ImageTaskWorker::signal_willStep, q, &ImageTask::modelWillStep, connectionType);
-        q->connect(&m_worker, &ImageTaskWorker::signal_didStep, q, &ImageTask::modelDidStep, connectionType);
+        StepSettings settings;
+        settings.options = m_preferences.getImageRunnerOptions();
+        settings.pyramidDepth = m_preferences.getPyramidDepth();
+        settings.tileSize = m_preferences.getTileSize();
+        settings.regionOfInterestEnabled = m_preferences.isRegionOfInterestEnabled();
+        settings.weightRegions = m_preferences.getWeightRegions();
+        settings.errorGuidedSampling = m_preferences.isErrorGuidedSamplingEnabled();
+        settings.searchesPerStep = m_preferences.getSearchesPerStep();
+        settings.stopConditions.targetSimilarity = m_preferences.getTargetSimilarity();
+        settings.stopConditions.timeLimit = m_preferences.getTimeLimit();
+        settings.stopConditions.shapeLimit = m_preferences.getShapeLimit();
+        settings.scriptModeEnabled = m_preferences.isScriptModeEnabled();
+        settings.scriptsRevision = m_preferences.getScriptsRevision();
+        settings.checkpointPath = m_checkpointPath;
+        settings.checkpointInterval = m_checkpointInterval;
+
+        // Checkpoints keep the scripts even while script mode is off, so they are not lost when resuming
+        if(settings.scriptModeEnabled || !settings.checkpointPath.empty()) {
+            settings.scripts = m_preferences.getScripts();
+        }
+        return settings;
+    }
+
+    // Runs on the worker, before stepping, so the script engine is only ever touched by the thread that runs the shape mutators
+    void applySettings(const StepSettings& settings)
+    {
+        // Tiles and pyramid levels search on models of their own, which the scripted shape functions do not reach, so script mode searches the whole image
+        m_worker.setPyramidDepth(settings.scriptModeEnabled ? 0 : settings.pyramidDepth);
+        m_worker.setTileSize(settings.scriptModeEnabled ? 0 : settings.tileSize);
+        m_worker.setWeightRegions(settings.regionOfInterestEnabled ? settings.weightRegions : std::vector<geometrize::optimizer::WeightRegion>{});
+        m_worker.setErrorGuidedSamplingEnabled(settings.errorGuidedSampling);
+        m_worker.setSearchesPerStep(settings.searchesPerStep);
+        m_worker.setStopConditions(settings.stopConditions);
+
+        // Evaluating the scripts costs more than a small step, so the engine is only touched when script mode or the scripts change
+        if(settings.scriptModeEnabled != m_appliedScriptMode) {
+            m_geometrizer.setEnabled(settings.scriptModeEnabled);
+            m_worker.setBatchMutator(settings.scriptModeEnabled ? &m_geometrizer : nullptr);
+            m_appliedScriptMode = settings.scriptModeEnabled;
+        }
+        if(settings.scriptModeEnabled && settings.scriptsRevision != m_appliedScriptsRevision) {
+            m_geometrizer.setupScripts(settings.scripts);
+            m_appliedScriptsRevision = settings.scriptsRevision;
+        }
+    }
+
+    // Runs on the worker. Steps back-to-back in batches sized to take about one time slice, queueing the next batch behind any
+    // other jobs for this task instead of waiting on the UI, so the scheduler can still interleave other tasks between batches
+    void runBatches(const std::uint64_t runId, std::size_t stepsLeft)
+    {
+        std::size_t batchSize{1};
+        while(true) {
+            // The token is taken before checking the run is current, so a stop that comes between the two still cancels the batch
+            const geometrize::optimizer::CancellationToken token{m_worker.getCancellationToken()};
+            StepSettings settings;
+            {
+                std::lock_guard<std::mutex> lock(m_runMutex);
+                if(runId != m_runId) {
+                    return;
+                }
+                settings = m_runSettings;
+            }
+            applySettings(settings);
+
+            // Checked before every batch rather than only when a batch ends early, so a run started with its limits already met stops straight away
+            const StopReason reason{m_worker.getStopReason()};
+            if(reason != StopReason::NONE) {
+                checkpoint(settings, true);
+                finishRun(runId, reason);
+                return;
+            }
+
+            const std::size_t count{stepsLeft == 0 ? batchSize : std::min(batchSize, stepsLeft)};
+            const auto start = std::chrono::steady_clock::now();
+            const std::size_t completed{stepToKeyframes(settings.options, count, token)};
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            if(stepsLeft != 0) {
+                stepsLeft -= completed;
+                if(stepsLeft == 0) {
+                    checkpoint(settings, true);
+                    finishRun(runId, StopReason::STEP_LIMIT);
+                    return;
+                }
+            }
+            checkpoint(settings, false);
+
+            if(elapsed < runBatchDuration / 2 && batchSize < maxRunBatchSize) {
+                batchSize *= 2;
+            } else if(elapsed > runBatchDuration * 2 && batchSize > 1) {
+                batchSize /= 2;
+            }
+
+            // Without a scheduler there is nothing to yield to, so a synchronous run keeps going until it is stopped or reaches its limit
+            if(!m_synchronous) {
+                runOnWorker([this, runId, stepsLeft]() { runBatches(runId, stepsLeft); });
+                return;
+            }
+        }
+    }
+
+    // Runs on the worker. Steps are split where keyframes fall due, so a keyframe is taken every keyframeInterval shapes however
+    // large the batches get, and rewinding never redraws more than that, plus the shapes of one tiled step
+    std::size_t stepToKeyframes(const geometrize::ImageRunnerOptions& options, const std::size_t count, const geometrize::optimizer::CancellationToken& token)
+    {
+        std::size_t completed{0};
+        while(completed < count) {
+            const std::size_t left{count - completed};
+            const std::size_t stepped{m_worker.stepN(options, left, token, m_keyframes.getShapesUntilDue(m_shapes.size()))};
+            completed += stepped;
+            if(stepped == 0 || token.isCancelled() || m_worker.getStopReason() != StopReason::NONE) {
+                break;
+            }
+        }
+        return completed;
+    }
+
+    // Runs on the worker between steps, so the images, shapes and step index it captures agree with each other
+    // Only the images are copied here, the shapes are shared with the log, and encoding and writing happen on the checkpoint writer's thread
+    void checkpoint(const StepSettings& settings, const bool force)
+    {
+        if(settings.checkpointPath.empty()) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if(!force && now - m_lastCheckpoint < std::chrono::seconds(settings.checkpointInterval)) {
+            return;
+        }
+        m_lastCheckpoint = now;
+
+        auto snapshot = std::make_shared<Checkpoint>(m_worker.getTarget(), m_worker.getCurrent());
+        snapshot->shapes = m_shapes.getView();
+        snapshot->preferences = toPreferences(settings).saveToString();
+        snapshot->stepIndex = m_worker.getStepIndex();
+        getSharedCheckpointWriter().submit(std::move(snapshot), settings.checkpointPath);
+    }
+
+    // Runs on the worker when a run reaches its step limit or meets a stop condition
+    void finishRun(const std::uint64_t runId, const StopReason reason)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            if(runId != m_runId) {
+                return;
+            }
+            m_running = false;
+            m_runId++;
+        }
+        const auto announce = [this, reason]() {
+            emit q->signal_runningChanged(false);
+            emit q->signal_runCompleted(reason);
+        };
+        if(m_synchronous) {
+            announce();
+        } else {
+            QMetaObject::invokeMethod(q, announce, Qt::QueuedConnection);
+        }
+    }
+
+    // Runs on the worker, restores the latest keyframe at or before the shape count and redraws the shapes after it
+    // The rewound image reaches the task's thread as a snapshot like any other, so the current image is only ever written here on the worker
+    void rewind(const std::size_t shapeCount)
+    {
+        const ShapeLogView all{m_shapes.getView()};
+        if(shapeCount >= all.size()) {
+            return;
+        }
+        std::size_t keyframeCount{0};
+        if(!m_keyframes.restore(shapeCount, m_worker.getCurrent(), keyframeCount)) {
+            return;
+        }
+        const float score{shapeCount == 0 ? 1.0f : all[shapeCount - 1].score};
+        m_worker.rewind(all.slice(keyframeCount, shapeCount), shapeCount, score);
+        m_keyframes.truncate(shapeCount);
+
+        // Published as a rewind, which hands the listeners every shape in the snapshot, so shapes that were not published yet are not lost or published twice
+        std::shared_ptr<const Bitmap> snapshot{std::make_shared<const Bitmap>(m_worker.getCurrent())};
+        bool post{false};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_shapes.truncate(shapeCount);
+            m_publishedCount = std::min(m_publishedCount, shapeCount);
+            m_snapshot = std::move(snapshot);
+            m_snapshotCount = shapeCount;
+            m_snapshotWanted = false;
+            m_rewindPending = true;
+            post = !m_publishPosted;
+            m_publishPosted = true;
+        }
+        if(m_synchronous) {
+            publishShapes();
+        } else if(post) {
+            QMetaObject::invokeMethod(q, [this]() { publishShapes(); }, Qt::QueuedConnection);
+        }
+    }
+
+    // Runs on the worker between steps. Copies the current image for the task's thread to draw, since the worker keeps drawing into the original
+    // Only one copy is taken per publish, the steps taken while a publish is waiting are handed out with the next copy
+    void takeSnapshot(const bool force)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            if(!force && !m_snapshotWanted) {
+                return;
+            }
+        }
+
+        std::shared_ptr<const Bitmap> snapshot{std::make_shared<const Bitmap>(m_worker.getCurrent())};
+        bool post{false};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_snapshot = std::move(snapshot);
+            m_snapshotCount = m_shapes.size();
+            m_snapshotWanted = false;
+            post = !m_publishPosted;
+            m_publishPosted = true;
+        }
+        if(m_synchronous) {
+            publishShapes();
+        } else if(post) {
+            QMetaObject::invokeMethod(q, [this]() { publishShapes(); }, Qt::QueuedConnection);
+        }
+    }
+
+    // Runs on the task's thread, hands every shape in the latest snapshot that was not published yet to the listeners in one go
+    // After a rewind the listeners start again, so they are handed every shape in the snapshot instead
+    void publishShapes()
+    {
+        ShapeLogView shapes;
+        bool rewound{false};
+        bool behind{false};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            const ShapeLogView all{m_shapes.getView()};
+            const std::size_t count{std::min(m_snapshotCount, all.size())};
+            rewound = m_rewindPending;
+            m_rewindPending = false;
+            shapes = all.slice(rewound ? 0 : m_publishedCount, count);
+            m_publishedCount = count;
+            if(m_snapshot) {
+                m_publishedSnapshot = m_snapshot;
+            }
+            m_publishPosted = false;
+            m_snapshotWanted = true;
+            behind = all.size() > count;
+
+            // Preferences are edited in place by the UI, so a running task picks up changes whenever it publishes
+            m_runSettings = captureSettings();
+        }
+
+        // Shapes added after the snapshot are published with the next one, which the next step takes, or this job if the worker has stopped
+        if(behind && !m_synchronous) {
+            runOnWorker([this]() { takeSnapshot(false); });
+        }
+        if(rewound) {
+            emit q->signal_modelRewound(shapes);
+        } else {
+            emit q->signal_modelDidStep(shapes);
+        }
+    }
+
+    void runOnWorker(std::function<void()> job)
+    {
+        // Errors are handled inside the job, so a failing step ends the run and is reported instead of leaving it running with nothing to step it
+        std::function<void()> guarded{[this, job]() {
+            try {
+                job();
+            } catch(const std::exception& e) {
+                failJob(e.what());
+            } catch(...) {
+                failJob("Unknown error while stepping");
+            }
+        }};
+
+        // Direct connections run the worker inline on the calling thread, everything else is queued on the shared scheduler
+        if(m_synchronous) {
+            guarded();
+        } else {
+            m_scheduler.submit(m_schedulerId, std::move(guarded));
+        }
+    }
+
+    // Runs on the worker when a job throws. A run is ended, since its next batch would most likely fail the same way
+    void failJob(const std::string& errorMessage)
+    {
+        std::uint64_t runId{0};
+        bool running{false};
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            runId = m_runId;
+            running = m_running;
+        }
+        if(running) {
+            finishRun(runId, StopReason::STEP_FAILED);
+        }
+
+        const auto report = [this, errorMessage]() { emit q->signal_stepFailed(errorMessage); };
+        if(m_synchronous) {
+            report();
+        } else {
+            QMetaObject::invokeMethod(q, report, Qt::QueuedConnection);
+        }
+    }
+
+    void connectSignals()
+    {
+        // The worker signals are handled on the worker itself, which forwards them to the task's thread, see modelWillStep and modelDidStep
+        q->connect(&m_worker, &ImageTaskWorker::signal_willStep, q, &ImageTask::modelWillStep, Qt::DirectConnection);
+        q->connect(&m_worker, &ImageTaskWorker::signal_didStep, q, &ImageTask::modelDidStep, Qt::DirectConnection);
     }
 
     void disconnectAll()
     {
-        q->disconnect(q, &ImageTask::signal_step, &m_worker, &ImageTaskWorker::step);
-        q->disconnect(q, &ImageTask::signal_drawShape, &m_worker, &ImageTaskWorker::drawShape);
         q->disconnect(&m_worker, &ImageTaskWorker::signal_willStep, q, &ImageTask::modelWillStep);
         q->disconnect(&m_worker, &ImageTaskWorker::signal_didStep, q, &ImageTask::modelDidStep);
     }
@@ -196,9 +777,34 @@ private:
     preferences::ImageTaskPreferences m_preferences; ///> Runtime configuration parameters for the runner.
     const std::string m_displayName; ///> The display name of the image task.
     const std::size_t m_id; ///> A unique id for the image task.
-    QThread m_workerThread; ///> Thread that the image task worker runs on.
+    TaskScheduler& m_scheduler; ///> The process-wide scheduler that runs the worker's steps.
+    const std::size_t m_schedulerId; ///> The id of the image task within the scheduler.
+    bool m_synchronous; ///> Whether the worker runs inline on the calling thread instead of on the scheduler.
     ImageTaskWorker m_worker; ///> The image task worker.
+    mutable std::mutex m_runMutex; ///> Guards the run state, the run settings and publishing the shapes.
+    bool m_running; ///> Whether the task is stepping back-to-back on the worker.
+    std::uint64_t m_runId; ///> Changed whenever a run starts or stops, so batches left over from an earlier run do not continue.
+    StepSettings m_runSettings; ///> The settings that a run steps with, refreshed from the preferences on the task's thread.
+    ShapeLog m_shapes; ///> Every shape added to the model, appended on the worker.
+    std::size_t m_publishedCount; ///> The number of shapes in the log that have been published to the task's thread.
+    bool m_publishPosted; ///> Whether publishing the pending shapes is already queued on the task's thread.
+    bool m_snapshotWanted{true}; ///> Whether the worker should copy the current image after its next step, set whenever the last copy has been published.
+    std::shared_ptr<const Bitmap> m_snapshot; ///> The latest copy of the current image taken on the worker, waiting to be published.
+    std::size_t m_snapshotCount{0}; ///> The number of shapes in the log when the latest copy was taken.
+    geometrize::optimizer::Arena::Statistics m_allocationStatistics; ///> The candidate shape allocation counters of the stepper, copied on the worker after every step.
+    bool m_rewindPending{false}; ///> Whether the model was rewound since the last publish, so the next one is announced as a rewind.
+    std::shared_ptr<const Bitmap> m_publishedSnapshot; ///> The copy of the current image that goes with the shapes published so far, what the UI draws.
+    std::shared_ptr<const Bitmap> m_targetSnapshot; ///> A copy of the target image for the task's thread, replaced by switchTarget before the worker swaps its own.
+    std::uint32_t m_width{0}; ///> The width of the images, which never changes, so it is safe to read on any thread.
+    std::uint32_t m_height{0}; ///> The height of the images, which never changes, so it is safe to read on any thread.
+    std::atomic<bool> m_willStepPosted; ///> Whether a will-step notification is already queued on the task's thread.
+    KeyframeStore m_keyframes; ///> Compressed copies of the current image every so many shapes, for rewinding, only used on the worker.
+    std::string m_checkpointPath; ///> The file that checkpoints are written to, empty if checkpoints are disabled.
+    std::uint32_t m_checkpointInterval; ///> The minimum number of seconds between periodic checkpoints.
+    std::chrono::steady_clock::time_point m_lastCheckpoint; ///> When the last checkpoint was taken, only used on the worker.
     geometrize::script::GeometrizerEngine m_geometrizer; ///> The script-based geometrizer for the image task.
+    bool m_appliedScriptMode{false}; ///> Whether the geometrizer was last enabled, only used on the worker thread.
+    std::uint64_t m_appliedScriptsRevision{0}; ///> The revision of the scripts the geometrizer last evaluated, zero if it has evaluated none, only used on the worker thread.
 };
 
 ImageTask::ImageTask(Bitmap& target, Qt::ConnectionType workerConnectionType) : QObject(),
@@ -245,6 +851,16 @@ const Bitmap& ImageTask::getCurrent() const
     return d->getCurrent();
 }
 
+std::shared_ptr<const Bitmap> ImageTask::getCurrentSnapshot() const
+{
+    return d->getCurrentSnapshot();
+}
+
+std::shared_ptr<const Bitmap> ImageTask::getTargetSnapshot() const
+{
+    return d->getTargetSnapshot();
+}
+
 std::uint32_t ImageTask::getWidth() const
 {
     return d->getWidth();
@@ -272,7 +888,52 @@ bool ImageTask::isStepping() const
 
 void ImageTask::stepModel()
 {
-    d->stepModel();
+    d->stepModel(1);
+}
+
+void ImageTask::stepModel(const std::size_t count)
+{
+    d->stepModel(count);
+}
+
+void ImageTask::startRunning(const std::size_t maxSteps)
+{
+    d->startRunning(maxSteps);
+}
+
+void ImageTask::stopRunning()
+{
+    d->stopRunning();
+}
+
+bool ImageTask::isRunning() const
+{
+    return d->isRunning();
+}
+
+void ImageTask::switchCurrent(const Bitmap& current)
+{
+    d->switchCurrent(current);
+}
+
+void ImageTask::switchTarget(const Bitmap& target)
+{
+    d->switchTarget(target);
+}
+
+void ImageTask::rewindTo(const std::size_t shapeCount)
+{
+    d->rewindTo(shapeCount);
+}
+
+void ImageTask::cancelSteps()
+{
+    d->cancelSteps();
+}
+
+void ImageTask::imagesChanged()
+{
+    d->imagesChanged();
 }
 
 void ImageTask::drawShape(std::shared_ptr<geometrize::Shape> shape, const geometrize::rgba color)
@@ -285,12 +946,57 @@ void ImageTask::drawBackgroundRectangle()
     d->drawBackgroundRectangle();
 }
 
+ShapeLogView ImageTask::getShapes() const
+{
+    return d->getShapes();
+}
+
+ShapeLogView ImageTask::getPublishedShapes() const
+{
+    return d->getPublishedShapes();
+}
+
+geometrize::optimizer::Arena::Statistics ImageTask::getAllocationStatistics() const
+{
+    return d->getAllocationStatistics();
+}
+
+void ImageTask::setCheckpointFile(const std::string& filePath, const std::uint32_t intervalSeconds)
+{
+    d->setCheckpointFile(filePath, intervalSeconds);
+}
+
+void ImageTask::saveCheckpoint()
+{
+    d->saveCheckpoint();
+}
+
+void ImageTask::setPriority(const int priority)
+{
+    d->setPriority(priority);
+}
+
+int ImageTask::getPriority() const
+{
+    return d->getPriority();
+}
+
+void ImageTask::setWeight(const std::uint32_t weight)
+{
+    d->setWeight(weight);
+}
+
+std::uint32_t ImageTask::getWeight() const
+{
+    return d->getWeight();
+}
+
 void ImageTask::modelWillStep()
 {
     d->modelWillStep();
 }
 
-void ImageTask::modelDidStep(std::vector<geometrize::ShapeResult> shapes)
+void ImageTask::modelDidStep(const std::vector<geometrize::ShapeResult>& shapes)
 {
     d->modelDidStep(shapes);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,7 +14,10 @@
 #include "geometrize/runner/imagerunneroptions.h"
 #include "geometrize/shape/shapemutator.h"
 
+#include "optimizer/arena.h"
 #include "preferences/imagetaskpreferences.h"
+#include "task/shapelog.h"
+#include "task/stopconditions.h"
 
 namespace geometrize
 {
@@ -29,7 +34,8 @@ namespace chaiscript
 class ChaiScript;
 }
 
-Q_DECLARE_METATYPE(std::vector<geometrize::ShapeResult>) ///< Shape data passed around by the image task worker thread.
+Q_DECLARE_METATYPE(geometrize::task::ShapeLogView) ///< Shapes published by the image task to its listeners.
+Q_DECLARE_METATYPE(geometrize::task::StopReason) ///< Reason published by the image task when a run completes.
 Q_DECLARE_METATYPE(geometrize::ImageRunnerOptions) ///< Image runner options passed to the image task worker thread.
 Q_DECLARE_METATYPE(std::shared_ptr<geometrize::Shape>) ///< Shape passed to the image task worker thread.
 Q_DECLARE_METATYPE(geometrize::rgba) ///< Shape color passed to the image task worker thread.
@@ -42,6 +48,8 @@ namespace task
 
 /**
  * @brief The ImageTask class transforms a source image into a collection of shapes approximating the source image.
+ * Steps run on the process-wide task scheduler, which shares one thread pool between every image task, see task/taskscheduler.h.
+ * Constructing a task with Qt::DirectConnection runs its steps inline on the calling thread instead.
  */
 class ImageTask : public QObject
 {
@@ -64,12 +72,14 @@ public:
 
     /**
      * @brief getTarget Gets the target bitmap.
+     * The worker reads it while the model steps and swaps it in switchTarget, so it must not be touched while the task is stepping, see getTargetSnapshot.
      * @return The target bitmap.
      */
     Bitmap& getTarget();
 
     /**
      * @brief getCurrent Gets the current bitmap.
+     * The worker draws into it while the model steps, so it must not be touched while the task is stepping, see getCurrentSnapshot and switchCurrent.
      * @return The current bitmap.
      */
     Bitmap& getCurrent();
@@ -86,6 +96,20 @@ public:
      */
     const Bitmap& getCurrent() const;
 
+    /**
+     * @brief getCurrentSnapshot Gets a copy of the current bitmap taken on the worker, which holds exactly the shapes published by the last signal_modelDidStep or signal_modelRewound.
+     * The copy is never written to, so it is safe to read on the task's thread while the model steps.
+     * @return The latest published copy of the current bitmap.
+     */
+    std::shared_ptr<const Bitmap> getCurrentSnapshot() const;
+
+    /**
+     * @brief getTargetSnapshot Gets a copy of the target bitmap, which switchTarget replaces as soon as it is called.
+     * The copy is never written to, so it is safe to read on the task's thread while the model steps.
+     * @return The latest copy of the target bitmap.
+     */
+    std::shared_ptr<const Bitmap> getTargetSnapshot() const;
+
     /**
      * @brief getWidth Gets the width of the images used by the image task.
      * @return The width of the images used by the image task.
@@ -121,6 +145,65 @@ public:
       */
      void stepModel();
 
+     /**
+      * @brief stepModel Steps the internal model several times in a single job on the task scheduler.
+      * The modelWillStep and modelDidStep signals are emitted once for the whole batch, and modelDidStep carries all of the shapes that were added.
+      * @param count The number of times to step the model.
+      */
+     void stepModel(std::size_t count);
+
+     /**
+      * @brief startRunning Starts stepping the internal model back-to-back on the task scheduler, until stopRunning is called, the step limit is reached,
+      * or one of the stop conditions in the preferences is met.
+      * The worker never waits for the listeners. Shapes added while the listeners are busy are delivered together by the next modelDidStep signal.
+      * Preference changes are picked up between batches of steps. A task constructed with Qt::DirectConnection runs inline, and only returns once it stops.
+      * @param maxSteps The number of steps to run before stopping, zero runs until stopped.
+      */
+     void startRunning(std::size_t maxSteps = 0);
+
+     /**
+      * @brief stopRunning Stops stepping the internal model, aborting the step in progress.
+      */
+     void stopRunning();
+
+     /**
+      * @brief isRunning Returns true if the internal model is being stepped back-to-back, see startRunning.
+      * @return True if the task is running, else false.
+      */
+     bool isRunning() const;
+
+     /**
+      * @brief switchTarget Replaces the target image. The step in progress is aborted, and the image is swapped on the worker before the next step starts.
+      * @param target The new target image, which must be the same size as the current one.
+      */
+     void switchTarget(const Bitmap& target);
+
+     /**
+      * @brief switchCurrent Replaces the current image. The step in progress is aborted, and the image is swapped on the worker before the next step starts.
+      * @param current The new current image, which must be the same size as the target.
+      */
+     void switchCurrent(const Bitmap& current);
+
+     /**
+      * @brief rewindTo Goes back to an earlier point, removing every shape added after it, so the task can carry on down a different path from there.
+      * A running task is stopped first. The image is restored from the nearest keyframe before that point, so only the few shapes after the keyframe are redrawn.
+      * The random numbers of later steps are not rewound, so stepping again adds different shapes than before. Emits signal_modelRewound once done.
+      * @param shapeCount The number of shapes to keep. Does nothing if the task has no more shapes than this.
+      */
+     void rewindTo(std::size_t shapeCount);
+
+     /**
+      * @brief cancelSteps Aborts the step in progress and discards the steps that are queued, within milliseconds. This may be called from any thread.
+      * Cancelled steps still emit modelDidStep, carrying the shapes added before they were cancelled. Steps requested afterwards run as normal,
+      * and a running task carries on with its next batch of steps.
+      */
+     void cancelSteps();
+
+     /**
+      * @brief imagesChanged Tells the task that its target or current image was replaced, so the data cached from them is rebuilt before the next step.
+      */
+     void imagesChanged();
+
      /**
       * @brief drawShape Draws a shape with the given color to the internal model.
       * @param shape The shape to add to the model.
@@ -133,6 +216,65 @@ public:
       */
      void drawBackgroundRectangle();
 
+     /**
+      * @brief setPriority Sets the scheduling priority of this task. Steps of tasks with a higher priority run before steps of tasks with a lower priority.
+      * @param priority The priority, zero by default.
+      */
+     void setPriority(int priority);
+
+     /**
+      * @brief getPriority Gets the scheduling priority of this task.
+      * @return The priority.
+      */
+     int getPriority() const;
+
+     /**
+      * @brief setWeight Sets the scheduling weight of this task. Busy tasks of equal priority share the processor in proportion to their weights.
+      * @param weight The weight, one by default.
+      */
+     void setWeight(std::uint32_t weight);
+
+     /**
+      * @brief getWeight Gets the scheduling weight of this task.
+      * @return The weight.
+      */
+     std::uint32_t getWeight() const;
+
+     /**
+      * @brief getShapes Gets a view of every shape added to the model so far. This is cheap however many shapes there are, no shapes are copied.
+      * The view may include shapes that have not been published by signal_modelDidStep yet. This may be called from any thread.
+      * @return A view of the shapes added so far.
+      */
+     ShapeLogView getShapes() const;
+
+     /**
+      * @brief getPublishedShapes Gets a view of the shapes published to the listeners so far, which are exactly the shapes held by getCurrentSnapshot.
+      * Unlike getShapes, this never runs ahead of what the listeners have been shown. This may be called from any thread.
+      * @return A view of the shapes published so far.
+      */
+     ShapeLogView getPublishedShapes() const;
+
+     /**
+      * @brief getAllocationStatistics Gets the allocation counters of the memory that candidate shapes are allocated from, as of the latest step.
+      * This may be called from any thread.
+      * @return The allocation counters.
+      */
+     geometrize::optimizer::Arena::Statistics getAllocationStatistics() const;
+
+     /**
+      * @brief setCheckpointFile Sets the file that checkpoints of this task are periodically written to, so that it can be resumed if the process dies.
+      * Checkpoints are taken between steps, at most once per interval and whenever a run stops by itself, and written by a background thread.
+      * They hold the images, the shapes, the preferences and the random state, see task/checkpoint.h.
+      * @param filePath The path of the checkpoint file, empty to disable checkpoints.
+      * @param intervalSeconds The minimum number of seconds between periodic checkpoints.
+      */
+     void setCheckpointFile(const std::string& filePath, std::uint32_t intervalSeconds);
+
+     /**
+      * @brief saveCheckpoint Writes a checkpoint to the checkpoint file once the step in progress is done. Does nothing if no checkpoint file is set.
+      */
+     void saveCheckpoint();
+
      /**
       * @brief getPreferences Gets a reference to the current preferences of this task.
       * @return A reference to the current preferences of this task.
@@ -147,36 +289,51 @@ public:
 
 signals:
      /**
-      * @brief signal_step Signal that the image task emits to make the internal model step.
+      * @brief signal_modelWillStep Signal that is emitted immediately before the underlying image task model is stepped.
       */
-     void signal_step(geometrize::ImageRunnerOptions options);
+     void signal_modelWillStep();
 
      /**
-      * @brief signal_drawShape Signal that the image task emits to draw a shape to the internal model.
-      * @param shape The shape to draw.
-      * @param color The color of the shape to draw.
+      * @brief signal_modelDidStep Signal that is emitted after the underlying image task model is stepped.
+      * Emissions are coalesced: if the task's thread is busy while the worker keeps stepping, one emission carries the shapes of several steps.
+      * @param shapes A view of the shapes that were added since the last emission, sharing storage with the task's shape log.
       */
-     void signal_drawShape(std::shared_ptr<geometrize::Shape> shape, geometrize::rgba color);
+     void signal_modelDidStep(geometrize::task::ShapeLogView shapes);
 
      /**
-      * @brief signal_modelWillStep Signal that is emitted immediately before the underlying image task model is stepped.
+      * @brief signal_modelRewound Signal that is emitted after the model goes back to an earlier point, see rewindTo.
+      * Shapes published earlier by signal_modelDidStep may no longer be part of the model, so listeners should start again from the shapes given here.
+      * @param shapes A view of every shape in the model after rewinding, from the first shape up to those held by getCurrentSnapshot.
       */
-     void signal_modelWillStep();
+     void signal_modelRewound(geometrize::task::ShapeLogView shapes);
+
+     /**
+      * @brief signal_preferencesSet Signal that is emitted immediately after the image task preferences are set.
+      */
+     void signal_preferencesSet();
 
      /**
-      * @brief signal_modelDidStep Signal that is emitted immediately after the underlying image task model is stepped.
-      * @param shapes The shapes that were added in the last step.
+      * @brief signal_runningChanged Signal that is emitted when the task starts or stops running, including when a run reaches its step limit.
+      * @param running Whether the task is now running.
       */
-     void signal_modelDidStep(std::vector<geometrize::ShapeResult> shapes);
+     void signal_runningChanged(bool running);
 
      /**
-      * @brief signal_preferencesSet Signal that is emitted immediately after the image task preferences are set.
+      * @brief signal_runCompleted Signal that is emitted when a run stops by itself, immediately after signal_runningChanged. Not emitted when stopRunning is called.
+      * @param reason The step limit or stop condition that ended the run.
       */
-     void signal_preferencesSet();
+     void signal_runCompleted(geometrize::task::StopReason reason);
+
+     /**
+      * @brief signal_stepFailed Signal that is emitted when stepping or drawing throws an error, such as a script function failing.
+      * A running task is stopped first, with signal_runCompleted giving StopReason::STEP_FAILED. Shapes added before the error are kept.
+      * @param errorMessage The text of the error message.
+      */
+     void signal_stepFailed(const std::string& errorMessage);
 
 private:
     void modelWillStep();
-    void modelDidStep(std::vector<geometrize::ShapeResult> shapes);
+    void modelDidStep(const std::vector<geometrize::ShapeResult>& shapes);
 
     class ImageTaskImpl;
     std::unique_ptr<ImageTaskImpl> d;
@@ -1,22 +1,31 @@
 #include "imagetaskworker.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
 #include "geometrize/bitmap/bitmap.h"
 #include "geometrize/bitmap/rgba.h"
 #include "geometrize/model.h"
 #include "geometrize/runner/imagerunner.h"
 #include "geometrize/shaperesult.h"
 
+#include "optimizer/cancellation.h"
+#include "optimizer/stepper.h"
+
 namespace geometrize
 {
 
 namespace task
 {
 
-ImageTaskWorker::ImageTaskWorker(Bitmap& bitmap) : QObject(), m_runner{bitmap}, m_working{false}
+ImageTaskWorker::ImageTaskWorker(Bitmap& bitmap) : QObject(), m_runner{bitmap}, m_stepper{m_runner.getModel()}, m_working{false}, m_pyramidDepth{0}, m_tileSize{0}, m_resetPending{false}
 {
 }
 
-ImageTaskWorker::ImageTaskWorker(Bitmap& bitmap, const Bitmap& initial) : QObject(), m_runner{bitmap, initial}, m_working{false}
+ImageTaskWorker::ImageTaskWorker(Bitmap& bitmap, const Bitmap& initial) : QObject(), m_runner{bitmap, initial}, m_stepper{m_runner.getModel()}, m_working{false}, m_pyramidDepth{0}, m_tileSize{0}, m_resetPending{false}
 {
 }
 
@@ -25,21 +34,73 @@ ImageTaskWorker::~ImageTaskWorker()
 }
 
 void ImageTaskWorker::step(const geometrize::ImageRunnerOptions options)
+{
+    stepN(options, 1);
+}
+
+std::size_t ImageTaskWorker::stepN(const geometrize::ImageRunnerOptions options, const std::size_t count, const geometrize::optimizer::CancellationToken token, const std::size_t maxShapes)
 {
     emit signal_willStep();
     m_working = true;
-    const std::vector<geometrize::ShapeResult> results{m_runner.step(options)};
+    prepareStepper();
+    std::vector<geometrize::ShapeResult> results;
+    std::size_t completed{0};
+    try {
+        while(completed < count && results.size() < maxShapes && !token.isCancelled()) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<geometrize::ShapeResult> shapes{m_stepper.step(options, token)};
+            m_stopConditions.addStepTime(std::chrono::steady_clock::now() - start);
+
+            // A cancelled step returns without drawing anything, a step that was cancelled after drawing still counts
+            if(shapes.empty() && token.isCancelled()) {
+                break;
+            }
+            m_stopConditions.addShapes(shapes);
+            std::copy(shapes.begin(), shapes.end(), std::back_inserter(results));
+            completed++;
+
+            if(getStopReason() != StopReason::NONE) {
+                break;
+            }
+        }
+    } catch(...) {
+        // A step that throws, such as one calling a broken script, draws nothing, but the steps before it did and must still be reported
+        m_working = false;
+        emit signal_didStep(results);
+        throw;
+    }
     m_working = false;
     emit signal_didStep(results);
+    return completed;
 }
 
 void ImageTaskWorker::drawShape(std::shared_ptr<geometrize::Shape> shape, geometrize::rgba color)
 {
     emit signal_willStep();
     m_working = true;
-    const geometrize::ShapeResult result{m_runner.getModel().drawShape(shape, color)};
-    m_working = false;
-    emit signal_didStep({ result });
+    try {
+        prepareStepper();
+        const geometrize::ShapeResult result{m_stepper.drawShape(shape, color)};
+        m_stopConditions.addShapes({ result });
+        m_working = false;
+        emit signal_didStep({ result });
+    } catch(...) {
+        m_working = false;
+        throw;
+    }
+}
+
+void ImageTaskWorker::rewind(const ShapeLogView& shapes, const std::size_t shapeCount, const float score)
+{
+    m_stepper.reset();
+    m_resetPending = false;
+    prepareStepper();
+
+    // Drawn through the stepper so its cached error data follows along, rather than being rebuilt after every shape
+    for(const geometrize::ShapeResult& shape : shapes) {
+        m_stepper.drawShape(shape.shape, shape.color);
+    }
+    m_stopConditions.rewind(shapeCount, score);
 }
 
 geometrize::Bitmap& ImageTaskWorker::getCurrent()
@@ -72,6 +133,85 @@ bool ImageTaskWorker::isStepping() const
     return m_working;
 }
 
+void ImageTaskWorker::setPyramidDepth(const std::uint32_t depth)
+{
+    m_pyramidDepth = depth;
+}
+
+void ImageTaskWorker::setTileSize(const std::uint32_t tileSize)
+{
+    m_tileSize = tileSize;
+}
+
+void ImageTaskWorker::setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions)
+{
+    m_stepper.setWeightRegions(regions);
+}
+
+void ImageTaskWorker::setErrorGuidedSamplingEnabled(const bool enabled)
+{
+    m_stepper.setErrorGuidedSamplingEnabled(enabled);
+}
+
+void ImageTaskWorker::setSearchesPerStep(const std::uint32_t searches)
+{
+    m_stepper.setSearchesPerStep(searches);
+}
+
+void ImageTaskWorker::setBatchMutator(geometrize::optimizer::BatchMutator* mutator)
+{
+    m_stepper.setBatchMutator(mutator);
+}
+
+geometrize::optimizer::CancellationToken ImageTaskWorker::getCancellationToken() const
+{
+    return m_cancellation.getToken();
+}
+
+void ImageTaskWorker::cancel()
+{
+    m_cancellation.cancel();
+}
+
+void ImageTaskWorker::setStopConditions(const StopConditions& conditions)
+{
+    m_stopConditions.setConditions(conditions);
+}
+
+void ImageTaskWorker::resetStepTime()
+{
+    m_stopConditions.resetStepTime();
+}
+
+StopReason ImageTaskWorker::getStopReason() const
+{
+    return m_stopConditions.check();
+}
+
+std::uint64_t ImageTaskWorker::getStepIndex() const
+{
+    return m_stepper.getStepIndex();
+}
+
+geometrize::optimizer::Arena::Statistics ImageTaskWorker::getAllocationStatistics() const
+{
+    return m_stepper.getAllocationStatistics();
+}
+
+void ImageTaskWorker::resetStepper()
+{
+    m_resetPending = true;
+}
+
+void ImageTaskWorker::prepareStepper()
+{
+    if(m_resetPending.exchange(false)) {
+        m_stepper.reset();
+    }
+    m_stepper.setPyramidDepth(m_pyramidDepth);
+    m_stepper.setTileSize(m_tileSize);
+}
+
 }
 
 }
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include <QObject>
 
@@ -10,6 +14,12 @@
 #include "geometrize/runner/imagerunneroptions.h"
 #include "geometrize/shaperesult.h"
 
+#include "optimizer/arena.h"
+#include "optimizer/cancellation.h"
+#include "optimizer/stepper.h"
+#include "task/shapelog.h"
+#include "task/stopconditions.h"
+
 namespace geometrize
 {
 
@@ -35,12 +45,110 @@ public:
      */
     void step(geometrize::ImageRunnerOptions options);
 
+    /**
+     * @brief stepN Steps the image task worker several times in one go. Emits the willStep signal once when called, and the didStep signal once with all of the added shapes on completion.
+     * @param options The options to provide the image runner when stepping.
+     * @param count The number of times to step.
+     * @param token A token that ends the steps early when cancelled. The shapes added before cancellation are still reported by the didStep signal.
+     * Steps also end early once a stop condition is met, see setStopConditions.
+     * @param maxShapes The number of added shapes after which the steps end early. A step that adds several shapes at once may go past it.
+     * If a step throws, the shapes added by the steps before it are reported by the didStep signal and then the exception is rethrown.
+     * @return The number of steps that ran to completion.
+     */
+    std::size_t stepN(geometrize::ImageRunnerOptions options, std::size_t count, geometrize::optimizer::CancellationToken token = geometrize::optimizer::CancellationToken(),
+                      std::size_t maxShapes = std::numeric_limits<std::size_t>::max());
+
+    /**
+     * @brief getCancellationToken Gets a token that is cancelled by the next call to cancel. This may be called from any thread.
+     * @return The cancellation token.
+     */
+    geometrize::optimizer::CancellationToken getCancellationToken() const;
+
+    /**
+     * @brief cancel Aborts the step in progress, and every step queued with a token taken before this call, within milliseconds.
+     * The model is left as it was after the last shape that was added. This may be called from any thread.
+     */
+    void cancel();
+
+    /**
+     * @brief resetStepper Discards the data the stepper caches from the target and current images, so it is rebuilt before the next step.
+     * Call this after either image is replaced. This may be called from any thread.
+     */
+    void resetStepper();
+
     /**
      * @brief isStepping Returns true if the internal model is currently stepping.
      * @return True if the internal model is currently stepping, else false.
      */
     bool isStepping() const;
 
+    /**
+     * @brief setPyramidDepth Sets how many times the images are halved in size before searching for shapes. Takes effect from the next step.
+     * This may be called from any thread.
+     * @param depth The pyramid depth, zero searches at full resolution.
+     */
+    void setPyramidDepth(std::uint32_t depth);
+
+    /**
+     * @brief setTileSize Sets the spacing of the tile grid used to search large images in parallel. Takes effect from the next step.
+     * This may be called from any thread.
+     * @param tileSize The tile size in pixels, zero disables tiling.
+     */
+    void setTileSize(std::uint32_t tileSize);
+
+    /**
+     * @brief setWeightRegions Sets the regions of the image that shapes are searched for in and scored by. Must be called on the worker thread.
+     * @param regions The weight regions in pixels of the target image, or none to search the whole image.
+     */
+    void setWeightRegions(const std::vector<geometrize::optimizer::WeightRegion>& regions);
+
+    /**
+     * @brief setErrorGuidedSamplingEnabled Sets whether random candidates are placed where the most error remains. Must be called on the worker thread.
+     * @param enabled Whether candidate placement follows the remaining error.
+     */
+    void setErrorGuidedSamplingEnabled(bool enabled);
+
+    /**
+     * @brief setSearchesPerStep Sets the number of independent searches per step, each hill climbing its own candidate. Must be called on the worker thread.
+     * @param searches The number of searches per step.
+     */
+    void setSearchesPerStep(std::uint32_t searches);
+
+    /**
+     * @brief setBatchMutator Sets the mutator that hill climbing candidates are mutated in batches by. Must be called on the worker thread.
+     * @param mutator The batch mutator, or null to have every candidate mutate itself. The worker does not take ownership of the mutator.
+     */
+    void setBatchMutator(geometrize::optimizer::BatchMutator* mutator);
+
+    /**
+     * @brief setStopConditions Sets the limits that end stepping automatically. Must be called on the worker thread.
+     * @param conditions The stop conditions.
+     */
+    void setStopConditions(const StopConditions& conditions);
+
+    /**
+     * @brief resetStepTime Starts the time limit over, so each run gets the whole time budget. Must be called on the worker thread.
+     */
+    void resetStepTime();
+
+    /**
+     * @brief getStopReason Checks the stop conditions against the shapes added and the time spent stepping so far. Must be called on the worker thread.
+     * @return The first stop condition that is met, or StopReason::NONE if there is none.
+     */
+    StopReason getStopReason() const;
+
+    /**
+     * @brief getStepIndex Gets the number of steps taken so far, which the random numbers of the next step are derived from. Must be called on the worker thread.
+     * @return The step index.
+     */
+    std::uint64_t getStepIndex() const;
+
+    /**
+     * @brief getAllocationStatistics Gets the combined allocation counters of the arenas that candidate shapes are allocated from. Must be called on the worker thread.
+     * @return The allocation counters.
+     */
+    geometrize::optimizer::Arena::Statistics getAllocationStatistics() const;
+
     /**
      * @brief drawShape Draws a shape with the given color to the image task. Emits the willStep signal when called, and didStep signal on completion.
      * @param shape The shape to draw.
@@ -48,6 +156,15 @@ public:
      */
     void drawShape(std::shared_ptr<geometrize::Shape> shape, geometrize::rgba color);
 
+    /**
+     * @brief rewind Goes back to an earlier point, after the current image was replaced with an earlier copy of it, by redrawing the shapes added since that copy.
+     * Emits no signals, and must be called on the worker thread.
+     * @param shapes The shapes to redraw on top of the earlier image, in the order they were added.
+     * @param shapeCount The number of shapes in the model once the shapes are redrawn.
+     * @param score The score of the model once the shapes are redrawn.
+     */
+    void rewind(const ShapeLogView& shapes, std::size_t shapeCount, float score);
+
     /**
      * @brief getCurrent Gets the current working bitmap.
      * @return The current working bitmap.
@@ -76,11 +193,23 @@ public:
 
 signals:
     void signal_willStep();
-    void signal_didStep(std::vector<geometrize::ShapeResult> shapes);
+    void signal_didStep(const std::vector<geometrize::ShapeResult>& shapes);
 
 private:
+    /**
+     * @brief prepareStepper Applies the pending reset, pyramid depth and tile size to the stepper. Called on the worker thread before stepping or drawing.
+     */
+    void prepareStepper();
+
+
     ImageRunner m_runner;
+    geometrize::optimizer::Stepper m_stepper; ///> Steps the runner's model using the SIMD difference and energy kernels.
     std::atomic<bool> m_working;
+    std::atomic<std::uint32_t> m_pyramidDepth; ///> The pyramid depth to use for the next step, applied to the stepper on the worker thread.
+    std::atomic<std::uint32_t> m_tileSize; ///> The tile size to use for the next step, applied to the stepper on the worker thread.
+    std::atomic<bool> m_resetPending; ///> Whether the stepper should discard its cached image data before the next step.
+    geometrize::optimizer::CancellationSource m_cancellation; ///> Hands out the tokens that steps are aborted with.
+    StopConditionTracker m_stopConditions; ///> Checks the shapes added and time spent stepping against the stop conditions, only used on the worker thread.
 };
 
 }
@@ -0,0 +1,89 @@
+#include "keyframes.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <QByteArray>
+
+#include "geometrize/bitmap/bitmap.h"
+
+namespace
+{
+
+const int compressionLevel{1}; // Keyframes are taken while stepping, so speed matters more than size, and flat areas of the image still shrink well
+
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+KeyframeStore::KeyframeStore(const std::size_t interval) : m_interval{std::max<std::size_t>(interval, 1)}, m_keyframes{}
+{
+}
+
+bool KeyframeStore::isDue(const std::size_t shapeCount) const
+{
+    return m_keyframes.empty() || shapeCount >= m_keyframes.back().shapeCount + m_interval;
+}
+
+std::size_t KeyframeStore::getShapesUntilDue(const std::size_t shapeCount) const
+{
+    if(m_keyframes.empty() || shapeCount >= m_keyframes.back().shapeCount + m_interval) {
+        return 1;
+    }
+    return m_keyframes.back().shapeCount + m_interval - shapeCount;
+}
+
+void KeyframeStore::add(const std::size_t shapeCount, const geometrize::Bitmap& bitmap)
+{
+    truncate(shapeCount);
+    if(!m_keyframes.empty() && m_keyframes.back().shapeCount == shapeCount) {
+        m_keyframes.pop_back();
+    }
+
+    const std::vector<std::uint8_t>& data{bitmap.getDataRef()};
+    m_keyframes.push_back(Keyframe{shapeCount, qCompress(data.data(), static_cast<int>(data.size()), compressionLevel)});
+}
+
+bool KeyframeStore::restore(const std::size_t shapeCount, geometrize::Bitmap& bitmap, std::size_t& keyframeShapeCount) const
+{
+    const auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), shapeCount, [](const std::size_t count, const Keyframe& keyframe) {
+        return count < keyframe.shapeCount;
+    });
+    if(next == m_keyframes.begin()) {
+        return false;
+    }
+
+    const Keyframe& keyframe{*(next - 1)};
+    const QByteArray data{qUncompress(keyframe.data)};
+    std::vector<std::uint8_t>& pixels{bitmap.getDataRef()};
+    if(static_cast<std::size_t>(data.size()) != pixels.size()) {
+        return false;
+    }
+    std::memcpy(pixels.data(), data.constData(), pixels.size());
+    keyframeShapeCount = keyframe.shapeCount;
+    return true;
+}
+
+void KeyframeStore::truncate(const std::size_t shapeCount)
+{
+    const auto first = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), shapeCount, [](const std::size_t count, const Keyframe& keyframe) {
+        return count < keyframe.shapeCount;
+    });
+    m_keyframes.erase(first, m_keyframes.end());
+}
+
+void KeyframeStore::clear()
+{
+    m_keyframes.clear();
+}
+
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <QByteArray>
+
+namespace geometrize
+{
+class Bitmap;
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+/**
+ * @brief The KeyframeStore class keeps compressed copies of an image task's current image, taken every so many shapes.
+ * Together with the shape log, these let the task go back to any earlier shape count by restoring the nearest keyframe and redrawing the shapes after it.
+ * The store is not synchronized, it is meant to be used from the thread that steps the task.
+ */
+class KeyframeStore
+{
+public:
+    /**
+     * @brief KeyframeStore Creates an empty keyframe store.
+     * @param interval The number of shapes between keyframes, so going back never redraws more than this many shapes.
+     */
+    explicit KeyframeStore(std::size_t interval);
+    KeyframeStore& operator=(const KeyframeStore&) = delete;
+    KeyframeStore(const KeyframeStore&) = delete;
+    ~KeyframeStore() = default;
+
+    /**
+     * @brief isDue Returns true if enough shapes have been added since the latest keyframe that another one should be taken.
+     * @param shapeCount The number of shapes added to the image so far.
+     * @return True if a keyframe should be added, else false.
+     */
+    bool isDue(std::size_t shapeCount) const;
+
+    /**
+     * @brief getShapesUntilDue Gets the number of shapes that can still be added before another keyframe is due.
+     * @param shapeCount The number of shapes added to the image so far.
+     * @return The number of shapes to add until a keyframe should be taken, at least one.
+     */
+    std::size_t getShapesUntilDue(std::size_t shapeCount) const;
+
+    /**
+     * @brief add Compresses and stores a keyframe of the image, replacing any keyframes taken at or after the same shape count.
+     * @param shapeCount The number of shapes that had been added to the image.
+     * @param bitmap The image.
+     */
+    void add(std::size_t shapeCount, const geometrize::Bitmap& bitmap);
+
+    /**
+     * @brief restore Decompresses the latest keyframe taken at or before the given shape count into a bitmap.
+     * @param shapeCount The shape count to go back to.
+     * @param bitmap The bitmap to restore the keyframe into, which must be the size of the images the keyframes were taken of.
+     * @param keyframeShapeCount The shape count that the restored keyframe was taken at.
+     * @return True if a keyframe was restored, else false.
+     */
+    bool restore(std::size_t shapeCount, geometrize::Bitmap& bitmap, std::size_t& keyframeShapeCount) const;
+
+    /**
+     * @brief truncate Discards the keyframes taken after the given shape count.
+     * @param shapeCount The number of shapes to keep keyframes for.
+     */
+    void truncate(std::size_t shapeCount);
+
+    /**
+     * @brief clear Discards every keyframe.
+     */
+    void clear();
+
+private:
+    struct Keyframe
+    {
+        std::size_t shapeCount; ///> The number of shapes that had been added to the image
+        QByteArray data; ///> The compressed pixel data of the image
+    };
+
+    const std::size_t m_interval; ///> The number of shapes between keyframes
+    std::vector<Keyframe> m_keyframes; ///> The keyframes, in order of shape count
+};
+
+}
+
+}
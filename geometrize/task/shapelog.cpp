@@ -0,0 +1,186 @@
+#include "shapelog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "geometrize/shaperesult.h"
+
+namespace geometrize
+{
+
+namespace task
+{
+
+ShapeLogView::const_iterator::const_iterator(const ShapeLogView* view, const std::size_t index) : m_view{view}, m_index{index}
+{
+}
+
+ShapeLogView::const_iterator::reference ShapeLogView::const_iterator::operator*() const
+{
+    return (*m_view)[m_index];
+}
+
+ShapeLogView::const_iterator::pointer ShapeLogView::const_iterator::operator->() const
+{
+    return &(*m_view)[m_index];
+}
+
+ShapeLogView::const_iterator& ShapeLogView::const_iterator::operator++()
+{
+    m_index++;
+    return *this;
+}
+
+ShapeLogView::const_iterator ShapeLogView::const_iterator::operator++(int)
+{
+    const_iterator previous{*this};
+    m_index++;
+    return previous;
+}
+
+bool ShapeLogView::const_iterator::operator==(const const_iterator& other) const
+{
+    return m_view == other.m_view && m_index == other.m_index;
+}
+
+bool ShapeLogView::const_iterator::operator!=(const const_iterator& other) const
+{
+    return !(*this == other);
+}
+
+ShapeLogView::ShapeLogView() : m_chunks{}, m_first{0}, m_last{0}
+{
+}
+
+ShapeLogView::ShapeLogView(std::shared_ptr<const Chunks> chunks, const std::size_t first, const std::size_t last) : m_chunks{std::move(chunks)}, m_first{first}, m_last{last}
+{
+}
+
+std::size_t ShapeLogView::size() const
+{
+    return m_last - m_first;
+}
+
+bool ShapeLogView::empty() const
+{
+    return m_last == m_first;
+}
+
+const geometrize::ShapeResult& ShapeLogView::operator[](const std::size_t index) const
+{
+    assert(index < size());
+    const std::size_t position{m_first + index};
+
+    // The chunk may be appended to while this reads it, so the element is reached through data(), which never changes once the chunk is created
+    const Chunk& chunk{*(*m_chunks)[position / ShapeLog::CHUNK_SIZE]};
+    return chunk.data()[position % ShapeLog::CHUNK_SIZE];
+}
+
+const geometrize::ShapeResult& ShapeLogView::at(const std::size_t index) const
+{
+    if(index >= size()) {
+        throw std::out_of_range("Shape log view index out of range");
+    }
+    return (*this)[index];
+}
+
+const geometrize::ShapeResult& ShapeLogView::back() const
+{
+    return (*this)[size() - 1];
+}
+
+ShapeLogView ShapeLogView::slice(const std::size_t first, const std::size_t last) const
+{
+    const std::size_t clampedLast{std::min(last, size())};
+    const std::size_t clampedFirst{std::min(first, clampedLast)};
+    return ShapeLogView(m_chunks, m_first + clampedFirst, m_first + clampedLast);
+}
+
+std::vector<geometrize::ShapeResult> ShapeLogView::toVector() const
+{
+    std::vector<geometrize::ShapeResult> shapes;
+    shapes.reserve(size());
+    for(const geometrize::ShapeResult& shape : *this) {
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+ShapeLogView::const_iterator ShapeLogView::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+ShapeLogView::const_iterator ShapeLogView::end() const
+{
+    return const_iterator(this, size());
+}
+
+ShapeLog::ShapeLog() : m_chunks{std::make_shared<ShapeLogView::Chunks>()}, m_size{0}
+{
+}
+
+void ShapeLog::append(const std::vector<geometrize::ShapeResult>& shapes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(const geometrize::ShapeResult& shape : shapes) {
+        if(m_size == m_chunks->size() * CHUNK_SIZE) {
+            // Views hold on to the chunk list they were taken with, so a new chunk goes into a copy of the list rather than the shared one
+            auto chunks = std::make_shared<ShapeLogView::Chunks>(*m_chunks);
+            auto chunk = std::make_shared<ShapeLogView::Chunk>();
+            chunk->reserve(CHUNK_SIZE);
+            chunks->push_back(std::move(chunk));
+            m_chunks = std::move(chunks);
+        }
+
+        // Never reallocates, the chunk was reserved to its full size, so shapes already in views stay where they are
+        m_chunks->back()->push_back(shape);
+        m_size++;
+    }
+}
+
+void ShapeLog::truncate(const std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(size >= m_size) {
+        return;
+    }
+
+    // Views may still read past the new end, so nothing they hold is changed: whole chunks are shared with the new list,
+    // and the partly kept chunk is copied so that appending to it later does not overwrite the shapes those views see
+    const std::size_t wholeChunks{size / CHUNK_SIZE};
+    const std::size_t remainder{size % CHUNK_SIZE};
+    auto chunks = std::make_shared<ShapeLogView::Chunks>(m_chunks->begin(), m_chunks->begin() + wholeChunks);
+    if(remainder != 0) {
+        const ShapeLogView::Chunk& partial{*(*m_chunks)[wholeChunks]};
+        auto chunk = std::make_shared<ShapeLogView::Chunk>();
+        chunk->reserve(CHUNK_SIZE);
+        std::copy(partial.begin(), partial.begin() + remainder, std::back_inserter(*chunk));
+        chunks->push_back(std::move(chunk));
+    }
+    m_chunks = std::move(chunks);
+    m_size = size;
+}
+
+ShapeLogView ShapeLog::getView() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return ShapeLogView(m_chunks, 0, m_size);
+}
+
+std::size_t ShapeLog::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+}
+
+}
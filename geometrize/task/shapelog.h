@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "geometrize/shaperesult.h"
+
+namespace geometrize
+{
+
+namespace task
+{
+
+class ShapeLog;
+
+/**
+ * @brief The ShapeLogView class is an immutable view of a range of the shapes in a shape log.
+ * Views share the storage of the log, so they are cheap to copy and to keep around. A view never changes, even as more shapes are added to the log.
+ * Views may be read on any thread, including while the log is being appended to.
+ */
+class ShapeLogView
+{
+public:
+    /**
+     * @brief The const_iterator class iterates over the shapes in a view, in the order they were added.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = geometrize::ShapeResult;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const geometrize::ShapeResult*;
+        using reference = const geometrize::ShapeResult&;
+
+        const_iterator(const ShapeLogView* view, std::size_t index);
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator& other) const;
+        bool operator!=(const const_iterator& other) const;
+
+    private:
+        const ShapeLogView* m_view; ///> The view being iterated over
+        std::size_t m_index; ///> The index of the current shape within the view
+    };
+
+    /**
+     * @brief ShapeLogView Creates an empty view.
+     */
+    ShapeLogView();
+
+    /**
+     * @brief size Gets the number of shapes in the view.
+     * @return The number of shapes.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief empty Returns true if the view has no shapes.
+     * @return True if the view is empty, else false.
+     */
+    bool empty() const;
+
+    /**
+     * @brief operator[] Gets a shape in the view, without bounds checking.
+     * @param index The index of the shape within the view.
+     * @return The shape.
+     */
+    const geometrize::ShapeResult& operator[](std::size_t index) const;
+
+    /**
+     * @brief at Gets a shape in the view.
+     * @param index The index of the shape within the view.
+     * @return The shape.
+     * @throws std::out_of_range if the index is not within the view.
+     */
+    const geometrize::ShapeResult& at(std::size_t index) const;
+
+    /**
+     * @brief back Gets the last shape in the view, which must not be empty.
+     * @return The last shape.
+     */
+    const geometrize::ShapeResult& back() const;
+
+    /**
+     * @brief slice Gets a view of part of this view, without copying any shapes.
+     * @param first The index of the first shape in the slice, clamped to the size of this view.
+     * @param last The index one past the last shape in the slice, clamped to the size of this view.
+     * @return The slice.
+     */
+    ShapeLogView slice(std::size_t first, std::size_t last) const;
+
+    /**
+     * @brief toVector Copies the shapes in the view into a vector, for use with functions that take vectors of shapes, such as the exporters.
+     * @return The shapes in the view.
+     */
+    std::vector<geometrize::ShapeResult> toVector() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    friend class ShapeLog;
+
+    using Chunk = std::vector<geometrize::ShapeResult>;
+    using Chunks = std::vector<std::shared_ptr<Chunk>>;
+
+    ShapeLogView(std::shared_ptr<const Chunks> chunks, std::size_t first, std::size_t last);
+
+    std::shared_ptr<const Chunks> m_chunks; ///> The chunks of the log at the time the view was taken
+    std::size_t m_first; ///> The index of the first shape of the view within the log
+    std::size_t m_last; ///> The index one past the last shape of the view within the log
+};
+
+/**
+ * @brief The ShapeLog class is an append-only record of the shapes added to an image task.
+ * Shapes are stored in fixed-size chunks that are never moved or reallocated, so taking a view of the log costs the same however many shapes it holds.
+ * One thread at a time may append or truncate, while any thread may take views.
+ */
+class ShapeLog
+{
+public:
+    static const std::size_t CHUNK_SIZE{1024}; ///< The number of shapes stored in each chunk.
+
+    ShapeLog();
+    ShapeLog& operator=(const ShapeLog&) = delete;
+    ShapeLog(const ShapeLog&) = delete;
+    ~ShapeLog() = default;
+
+    /**
+     * @brief append Adds shapes to the end of the log.
+     * @param shapes The shapes to add.
+     */
+    void append(const std::vector<geometrize::ShapeResult>& shapes);
+
+    /**
+     * @brief truncate Removes the shapes after the given number of shapes from the log. Views taken earlier keep the shapes they hold.
+     * @param size The number of shapes to keep, the log is left unchanged if it holds fewer shapes than this.
+     */
+    void truncate(std::size_t size);
+
+    /**
+     * @brief getView Gets a view of every shape added to the log so far.
+     * @return The view.
+     */
+    ShapeLogView getView() const;
+
+    /**
+     * @brief size Gets the number of shapes added to the log so far.
+     * @return The number of shapes.
+     */
+    std::size_t size() const;
+
+private:
+    std::shared_ptr<ShapeLogView::Chunks> m_chunks; ///> The chunks, replaced by a longer copy whenever a chunk is added so that existing views keep theirs
+    std::size_t m_size; ///> The number of shapes in the log
+    mutable std::mutex m_mutex; ///> Guards the chunk list and the size
+};
+
+}
+
+}
@@ -0,0 +1,71 @@
+#include "stopconditions.h"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "geometrize/shaperesult.h"
+
+namespace geometrize
+{
+
+namespace task
+{
+
+StopConditionTracker::StopConditionTracker() : m_conditions{}, m_stepTime{0}, m_shapeCount{0}, m_lastScore{1.0f}
+{
+}
+
+void StopConditionTracker::setConditions(const StopConditions& conditions)
+{
+    m_conditions = conditions;
+}
+
+bool StopConditionTracker::hasConditions() const
+{
+    return m_conditions.targetSimilarity > 0.0f || m_conditions.timeLimit != 0 || m_conditions.shapeLimit != 0;
+}
+
+void StopConditionTracker::addShapes(const std::vector<geometrize::ShapeResult>& shapes)
+{
+    if(shapes.empty()) {
+        return;
+    }
+    m_shapeCount += shapes.size();
+    m_lastScore = shapes.back().score;
+}
+
+void StopConditionTracker::addStepTime(const std::chrono::steady_clock::duration time)
+{
+    m_stepTime += time;
+}
+
+void StopConditionTracker::resetStepTime()
+{
+    m_stepTime = std::chrono::steady_clock::duration::zero();
+}
+
+void StopConditionTracker::rewind(const std::size_t shapeCount, const float score)
+{
+    m_shapeCount = shapeCount;
+    m_lastScore = score;
+}
+
+StopReason StopConditionTracker::check() const
+{
+    // Scores are the normalized difference from the target, the same similarity percentage as the stats show is checked against
+    if(m_conditions.targetSimilarity > 0.0f && m_shapeCount != 0 && (100.0f - m_lastScore * 100.0f) >= m_conditions.targetSimilarity) {
+        return StopReason::TARGET_SIMILARITY;
+    }
+    if(m_conditions.timeLimit != 0 && m_stepTime >= std::chrono::seconds(m_conditions.timeLimit)) {
+        return StopReason::TIME_LIMIT;
+    }
+    if(m_conditions.shapeLimit != 0 && m_shapeCount >= m_conditions.shapeLimit) {
+        return StopReason::SHAPE_LIMIT;
+    }
+    return StopReason::NONE;
+}
+
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometrize
+{
+struct ShapeResult;
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+/**
+ * @brief The StopReason enum specifies why an image task stopped running by itself.
+ */
+enum class StopReason
+{
+    NONE, ///< The task has not met any of its stop conditions.
+    STEP_LIMIT, ///< The run reached the number of steps it was started with.
+    TARGET_SIMILARITY, ///< The current image became similar enough to the target image.
+    TIME_LIMIT, ///< The run spent its time budget stepping.
+    SHAPE_LIMIT, ///< The model holds as many shapes as it is allowed to.
+    STEP_FAILED ///< A step threw an error, such as a script function failing, see ImageTask::signal_stepFailed.
+};
+
+/**
+ * @brief The StopConditions struct holds the limits that end an image task run automatically. The first limit reached stops the run.
+ * A limit of zero is disabled. The time limit is a budget for each run, while the similarity and shape limits apply to the model as a whole,
+ * so a run started once either of those is met stops straight away until the limit is raised.
+ */
+struct StopConditions
+{
+    float targetSimilarity{0.0f}; ///< The similarity to the target image to stop at, as a percentage.
+    std::uint32_t timeLimit{0}; ///< The time each run may spend stepping, in seconds.
+    std::uint32_t shapeLimit{0}; ///< The number of shapes the model may hold.
+};
+
+/**
+ * @brief The StopConditionTracker class keeps track of the shapes an image task has added and the time it has spent stepping, and checks them against its stop conditions.
+ */
+class StopConditionTracker
+{
+public:
+    StopConditionTracker();
+
+    /**
+     * @brief setConditions Sets the stop conditions to check against. The progress made so far is kept.
+     * @param conditions The stop conditions.
+     */
+    void setConditions(const StopConditions& conditions);
+
+    /**
+     * @brief hasConditions Returns true if any of the stop conditions is enabled.
+     * @return True if there is a stop condition to check, else false.
+     */
+    bool hasConditions() const;
+
+    /**
+     * @brief addShapes Records shapes added to the model.
+     * @param shapes The shapes that were added, in the order they were added.
+     */
+    void addShapes(const std::vector<geometrize::ShapeResult>& shapes);
+
+    /**
+     * @brief addStepTime Records time spent stepping.
+     * @param time The time spent.
+     */
+    void addStepTime(std::chrono::steady_clock::duration time);
+
+    /**
+     * @brief resetStepTime Forgets the time spent stepping so far, so the time limit starts over. Called when a run starts.
+     */
+    void resetStepTime();
+
+    /**
+     * @brief rewind Goes back to an earlier point, after shapes were removed from the model. The time spent stepping is kept, it was spent all the same.
+     * @param shapeCount The number of shapes left in the model.
+     * @param score The score of the model with those shapes.
+     */
+    void rewind(std::size_t shapeCount, float score);
+
+    /**
+     * @brief check Checks the progress made so far against the stop conditions.
+     * @return The first stop condition that is met, or StopReason::NONE if there is none.
+     */
+    StopReason check() const;
+
+private:
+    StopConditions m_conditions; ///> The limits that end stepping
+    std::chrono::steady_clock::duration m_stepTime; ///> The time spent stepping since the current run started
+    std::size_t m_shapeCount; ///> The number of shapes added to the model
+    float m_lastScore; ///> The score of the model after the latest shape was added
+};
+
+}
+
+}
@@ -1,17 +1,29 @@
 #include "synchronousimagetask.h"
 
-#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "geometrize/bitmap/bitmap.h"
+#include "geometrize/bitmap/rgba.h"
+#include "geometrize/commonutil.h"
 #include "geometrize/shaperesult.h"
 #include "geometrize/runner/imagerunner.h"
 #include "geometrize/runner/imagerunneroptions.h"
 #include "geometrize/model.h"
+#include "geometrize/shape/rectangle.h"
 #include "geometrize/shape/shapemutator.h"
 
+#include "optimizer/stepper.h"
 #include "preferences/imagetaskpreferences.h"
-#include "task/imagetask.h"
+#include "script/geometrizerengine.h"
+#include "task/checkpoint.h"
+#include "task/checkpointwriter.h"
+#include "task/shapelog.h"
+#include "task/stopconditions.h"
 
 namespace geometrize
 {
@@ -22,66 +34,208 @@ namespace task
 class SynchronousImageTask::SynchronousImageTaskImpl
 {
 public:
-    SynchronousImageTaskImpl(SynchronousImageTask* pQ, Bitmap& target) :
-        q{pQ},
-        m_task{std::make_unique<geometrize::task::ImageTask>(target, Qt::DirectConnection)},
-        m_stepConnection{}
+    SynchronousImageTaskImpl(const Bitmap& target) :
+        m_runner{target}, m_stepper{m_runner.getModel()}, m_checkpointInterval{0}, m_lastCheckpoint{std::chrono::steady_clock::now()}
     {
-        m_stepConnection = q->connect(m_task.get(), &ImageTask::signal_modelDidStep, [this](const std::vector<geometrize::ShapeResult> shapes) {
-            std::copy(shapes.begin(), shapes.end(), std::back_inserter(m_shapes));
-        });
     }
-    SynchronousImageTaskImpl operator=(const SynchronousImageTaskImpl&) = delete;
-    SynchronousImageTaskImpl(const SynchronousImageTaskImpl&) = delete;
-    ~SynchronousImageTaskImpl()
+
+    SynchronousImageTaskImpl(const Bitmap& target, const Bitmap& initial) :
+        m_runner{target, initial}, m_stepper{m_runner.getModel()}, m_checkpointInterval{0}, m_lastCheckpoint{std::chrono::steady_clock::now()}
     {
-        QObject::disconnect(m_stepConnection);
     }
+    SynchronousImageTaskImpl operator=(const SynchronousImageTaskImpl&) = delete;
+    SynchronousImageTaskImpl(const SynchronousImageTaskImpl&) = delete;
+    ~SynchronousImageTaskImpl() = default;
 
     Bitmap& getTarget()
     {
-        return m_task->getTarget();
+        return m_runner.getTarget();
     }
 
     Bitmap& getCurrent()
     {
-        return m_task->getCurrent();
+        return m_runner.getCurrent();
     }
 
     void step()
     {
-        m_task->stepModel();
+        applyPreferences();
+        stepOnce();
+        checkpoint(false);
+    }
+
+    StopReason run()
+    {
+        applyPreferences();
+        if(!m_stopConditions.hasConditions()) {
+            return StopReason::NONE;
+        }
+        m_stopConditions.resetStepTime();
+
+        StopReason reason{m_stopConditions.check()};
+        while(reason == StopReason::NONE) {
+            // A step that adds nothing, e.g. because no shape types are enabled, would never get any closer to the limits
+            if(!stepOnce()) {
+                break;
+            }
+            reason = m_stopConditions.check();
+            checkpoint(false);
+        }
+
+        // The final checkpoint is on disk by the time this returns, so a script or batch job can exit straight away
+        checkpoint(true);
+        getSharedCheckpointWriter().flush();
+        return reason;
     }
 
     void drawBackgroundRectangle()
     {
-        m_task->drawBackgroundRectangle();
+        applyPreferences();
+        const geometrize::rgba color{geometrize::commonutil::getAverageImageColor(m_runner.getTarget())};
+        const std::shared_ptr<geometrize::Rectangle> rectangle = std::make_shared<geometrize::Rectangle>(m_runner.getModel());
+        rectangle->m_x1 = 0;
+        rectangle->m_x2 = m_runner.getTarget().getWidth();
+        rectangle->m_y1 = 0;
+        rectangle->m_y2 = m_runner.getTarget().getHeight();
+        addShapes({ m_stepper.drawShape(rectangle, color) });
     }
 
     geometrize::preferences::ImageTaskPreferences& getPreferences()
     {
-        return m_task->getPreferences();
+        return m_preferences;
     }
 
     void setPreferences(preferences::ImageTaskPreferences preferences)
     {
-        m_task->setPreferences(preferences);
+        m_preferences = preferences;
     }
 
-    std::vector<geometrize::ShapeResult> getShapes() const
+    ShapeLogView getShapes() const
     {
-        return m_shapes;
+        return m_shapes.getView();
+    }
+
+    bool restore(const Checkpoint& checkpoint)
+    {
+        std::vector<geometrize::ShapeResult> shapes;
+        if(!decodeCheckpointShapes(checkpoint, m_runner.getModel(), shapes)) {
+            return false;
+        }
+        m_preferences.loadFromString(checkpoint.preferences);
+        m_stepper.setStepIndex(checkpoint.stepIndex);
+        addShapes(shapes);
+        return true;
+    }
+
+    void setCheckpointFile(const std::string& filePath, const std::uint32_t intervalSeconds)
+    {
+        m_checkpointPath = filePath;
+        m_checkpointInterval = intervalSeconds;
+    }
+
+    bool saveCheckpoint(const std::string& filePath) const
+    {
+        return writeCheckpoint(*createCheckpoint(), filePath);
     }
 
 private:
-    SynchronousImageTask* q;
-    std::vector<geometrize::ShapeResult> m_shapes;
-    geometrize::preferences::ImageTaskPreferences m_preferences;
-    std::unique_ptr<geometrize::task::ImageTask> m_task;
-    QMetaObject::Connection m_stepConnection;
+    // Returns false if the step added no shapes
+    bool stepOnce()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<geometrize::ShapeResult> shapes{m_stepper.step(m_preferences.getImageRunnerOptions())};
+        m_stopConditions.addStepTime(std::chrono::steady_clock::now() - start);
+        addShapes(shapes);
+        return !shapes.empty();
+    }
+
+    void addShapes(const std::vector<geometrize::ShapeResult>& shapes)
+    {
+        m_stopConditions.addShapes(shapes);
+        m_shapes.append(shapes);
+    }
+
+    std::shared_ptr<Checkpoint> createCheckpoint() const
+    {
+        auto checkpoint = std::make_shared<Checkpoint>(m_runner.getTarget(), m_runner.getCurrent());
+        checkpoint->shapes = m_shapes.getView();
+        checkpoint->preferences = m_preferences.saveToString();
+        checkpoint->stepIndex = m_stepper.getStepIndex();
+        return checkpoint;
+    }
+
+    // Hands a checkpoint to the checkpoint writer if one is due, so stepping carries on while it is written
+    void checkpoint(const bool force)
+    {
+        if(m_checkpointPath.empty()) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if(!force && now - m_lastCheckpoint < std::chrono::seconds(m_checkpointInterval)) {
+            return;
+        }
+        m_lastCheckpoint = now;
+        getSharedCheckpointWriter().submit(createCheckpoint(), m_checkpointPath);
+    }
+
+    // Scripts may edit the preferences between steps, so they are read again before every step
+    void applyPreferences()
+    {
+        // Tiles and pyramid levels search on models of their own, which the scripted shape functions do not reach, so script mode searches the whole image
+        const bool scriptMode{m_preferences.isScriptModeEnabled()};
+        m_stepper.setPyramidDepth(scriptMode ? 0 : m_preferences.getPyramidDepth());
+        m_stepper.setTileSize(scriptMode ? 0 : m_preferences.getTileSize());
+        m_stepper.setWeightRegions(m_preferences.isRegionOfInterestEnabled() ? m_preferences.getWeightRegions() : std::vector<geometrize::optimizer::WeightRegion>{});
+        m_stepper.setErrorGuidedSamplingEnabled(m_preferences.isErrorGuidedSamplingEnabled());
+        m_stepper.setSearchesPerStep(m_preferences.getSearchesPerStep());
+
+        StopConditions conditions;
+        conditions.targetSimilarity = m_preferences.getTargetSimilarity();
+        conditions.timeLimit = m_preferences.getTimeLimit();
+        conditions.shapeLimit = m_preferences.getShapeLimit();
+        m_stopConditions.setConditions(conditions);
+
+        if(m_preferences.isScriptModeEnabled()) {
+            if(!m_geometrizer) {
+                m_geometrizer = std::make_unique<geometrize::script::GeometrizerEngine>();
+                m_geometrizer->setMutator(&m_runner.getModel().getShapeMutator());
+            }
+            // Evaluating the scripts costs more than a small step, so the engine is only touched when script mode or the scripts change
+            if(!m_appliedScriptMode) {
+                m_geometrizer->setEnabled(true);
+                m_stepper.setBatchMutator(m_geometrizer.get());
+                m_appliedScriptMode = true;
+            }
+            const std::uint64_t revision{m_preferences.getScriptsRevision()};
+            if(revision != m_appliedScriptsRevision) {
+                m_geometrizer->setupScripts(m_preferences.getScripts());
+                m_appliedScriptsRevision = revision;
+            }
+        } else if(m_geometrizer && m_appliedScriptMode) {
+            m_geometrizer->setEnabled(false);
+            m_stepper.setBatchMutator(nullptr);
+            m_appliedScriptMode = false;
+        }
+    }
+
+    geometrize::ImageRunner m_runner; ///> Holds the model that shapes are added to.
+    geometrize::optimizer::Stepper m_stepper; ///> Steps the runner's model, in place of ImageRunner::step.
+    geometrize::preferences::ImageTaskPreferences m_preferences; ///> Runtime configuration parameters for the stepper.
+    ShapeLog m_shapes; ///> Every shape added to the model.
+    StopConditionTracker m_stopConditions; ///> Checks the shapes added and time spent stepping against the stop conditions.
+    std::unique_ptr<geometrize::script::GeometrizerEngine> m_geometrizer; ///> The script engine, only created once script mode is enabled.
+    bool m_appliedScriptMode{false}; ///> Whether the script engine was last enabled.
+    std::uint64_t m_appliedScriptsRevision{0}; ///> The revision of the scripts the script engine last evaluated, zero if it has evaluated none.
+    std::string m_checkpointPath; ///> The file that checkpoints are written to, empty if checkpoints are disabled.
+    std::uint32_t m_checkpointInterval; ///> The minimum number of seconds between periodic checkpoints.
+    std::chrono::steady_clock::time_point m_lastCheckpoint; ///> When the last checkpoint was taken.
 };
 
-SynchronousImageTask::SynchronousImageTask(Bitmap& target) : QObject{}, d{std::make_unique<SynchronousImageTask::SynchronousImageTaskImpl>(this, target)}
+SynchronousImageTask::SynchronousImageTask(Bitmap& target) : d{std::make_unique<SynchronousImageTask::SynchronousImageTaskImpl>(target)}
+{
+}
+
+SynchronousImageTask::SynchronousImageTask(const Bitmap& target, const Bitmap& initial) : d{std::make_unique<SynchronousImageTask::SynchronousImageTaskImpl>(target, initial)}
 {
 }
 
@@ -89,6 +243,19 @@ SynchronousImageTask::~SynchronousImageTask()
 {
 }
 
+std::shared_ptr<SynchronousImageTask> SynchronousImageTask::resume(const std::string& checkpointPath)
+{
+    const std::unique_ptr<Checkpoint> checkpoint{readCheckpoint(checkpointPath)};
+    if(!checkpoint) {
+        return nullptr;
+    }
+    auto task = std::make_shared<SynchronousImageTask>(checkpoint->target, checkpoint->current);
+    if(!task->d->restore(*checkpoint)) {
+        return nullptr;
+    }
+    return task;
+}
+
 Bitmap& SynchronousImageTask::getTarget()
 {
     return d->getTarget();
@@ -104,6 +271,11 @@ void SynchronousImageTask::stepModel()
     d->step();
 }
 
+StopReason SynchronousImageTask::run()
+{
+    return d->run();
+}
+
 void SynchronousImageTask::drawBackgroundRectangle()
 {
     d->drawBackgroundRectangle();
@@ -119,11 +291,21 @@ void SynchronousImageTask::setPreferences(const preferences::ImageTaskPreference
     d->setPreferences(preferences);
 }
 
-std::vector<geometrize::ShapeResult> SynchronousImageTask::getShapes() const
+ShapeLogView SynchronousImageTask::getShapes() const
 {
     return d->getShapes();
 }
 
+void SynchronousImageTask::setCheckpointFile(const std::string& filePath, const std::uint32_t intervalSeconds)
+{
+    d->setCheckpointFile(filePath, intervalSeconds);
+}
+
+bool SynchronousImageTask::saveCheckpoint(const std::string& filePath)
+{
+    return d->saveCheckpoint(filePath);
+}
+
 }
 
 }
@@ -1,16 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
-#include <vector>
-
-#include <QObject>
+#include <string>
 
 #include "preferences/imagetaskpreferences.h"
+#include "task/shapelog.h"
+#include "task/stopconditions.h"
 
 namespace geometrize
 {
 class Bitmap;
-struct ShapeResult;
 }
 
 namespace geometrize
@@ -21,18 +21,27 @@ namespace task
 
 /**
  * @brief The SynchronousImageTask class transforms a source image into a collection of shapes approximating the source image.
- * A wrapper around the asynchronous ImageTask class, this blocks when stepping the model.
+ * Unlike ImageTask, this steps the model inline on the calling thread and blocks until done. It is not a QObject, uses no signals and does not
+ * go through the task scheduler, so it is cheap to create many of them. The script engine is only created if script mode is enabled in the preferences.
  * This is a convenience class for use in scripts and console programs where we would rather block/wait when geometrizing something.
  */
-class SynchronousImageTask : public QObject
+class SynchronousImageTask
 {
-    Q_OBJECT
 public:
     SynchronousImageTask(Bitmap& target);
+    SynchronousImageTask(const Bitmap& target, const Bitmap& initial);
     ~SynchronousImageTask();
     SynchronousImageTask& operator=(const SynchronousImageTask&) = delete;
     SynchronousImageTask(const SynchronousImageTask&) = delete;
 
+    /**
+     * @brief resume Creates a task from a checkpoint file, in exactly the state it was in when the checkpoint was taken.
+     * Stepping the resumed task adds the same shapes that the original task would have gone on to add.
+     * @param checkpointPath The path to a checkpoint written by an ImageTask or a SynchronousImageTask.
+     * @return The resumed task, or nullptr if the checkpoint could not be read.
+     */
+    static std::shared_ptr<SynchronousImageTask> resume(const std::string& checkpointPath);
+
     /**
      * @brief getTarget Gets the target bitmap.
      * @return The target bitmap.
@@ -50,6 +59,13 @@ public:
       */
      void stepModel();
 
+     /**
+      * @brief run Steps the internal model until one of the stop conditions in the preferences is met, see ImageTaskPreferences.
+      * Returns straight away if no stop condition is set, rather than stepping forever.
+      * @return The stop condition that ended the run, or StopReason::NONE if there is none.
+      */
+     StopReason run();
+
      /**
       * @brief drawBackgroundRectangle Convenience function that draws a background rectangle shape using the target image's background color.
       */
@@ -68,10 +84,25 @@ public:
      void setPreferences(preferences::ImageTaskPreferences preferences);
 
      /**
-      * @brief getShapes Gets a vector of shapes generated so far by this task.
-      * @return The vector of shapes generated so far by this task.
+      * @brief getShapes Gets a view of the shapes generated so far by this task, sharing storage with the task's shape log.
+      * @return A view of the shapes generated so far by this task.
+      */
+     ShapeLogView getShapes() const;
+
+     /**
+      * @brief setCheckpointFile Sets the file that checkpoints of this task are periodically written to while stepping, see ImageTask::setCheckpointFile.
+      * A checkpoint is also written whenever run returns.
+      * @param filePath The path of the checkpoint file, empty to disable checkpoints.
+      * @param intervalSeconds The minimum number of seconds between periodic checkpoints.
+      */
+     void setCheckpointFile(const std::string& filePath, std::uint32_t intervalSeconds);
+
+     /**
+      * @brief saveCheckpoint Writes a checkpoint of this task to a file right away.
+      * @param filePath The path to write the checkpoint to.
+      * @return True if the checkpoint was written, else false.
       */
-     std::vector<geometrize::ShapeResult> getShapes() const;
+     bool saveCheckpoint(const std::string& filePath);
 
 private:
      class SynchronousImageTaskImpl;
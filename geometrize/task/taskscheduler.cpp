@@ -0,0 +1,268 @@
+#include "taskscheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "optimizer/threadpool.h"
+
+namespace
+{
+
+// The scheduling state of one registered task
+struct TaskEntry
+{
+    int priority;
+    std::uint32_t weight;
+    std::deque<std::function<void()>> jobs; // Jobs waiting to run, oldest first
+    bool running{false}; // Whether one of the task's jobs is running right now
+    double virtualTime{0.0}; // Running time the task has received, divided by its weight
+};
+
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+class TaskScheduler::TaskSchedulerImpl
+{
+public:
+    TaskSchedulerImpl(geometrize::optimizer::ThreadPool& pool, const std::size_t maxConcurrentJobs) :
+        m_pool{pool}, m_maxRunners{std::max<std::size_t>(1U, maxConcurrentJobs)}, m_runners{0}, m_nextId{0}, m_virtualTime{0.0}
+    {
+    }
+
+    ~TaskSchedulerImpl()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for(auto& entry : m_tasks) {
+            entry.second.jobs.clear();
+        }
+        m_changed.wait(lock, [this]() { return m_runners == 0; });
+    }
+
+    TaskSchedulerImpl& operator=(const TaskSchedulerImpl&) = delete;
+    TaskSchedulerImpl(const TaskSchedulerImpl&) = delete;
+
+    std::size_t addTask(const int priority, const std::uint32_t weight)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const std::size_t id{m_nextId++};
+        TaskEntry& entry{m_tasks[id]};
+        entry.priority = priority;
+        entry.weight = std::max(1U, weight);
+        entry.virtualTime = m_virtualTime;
+        return id;
+    }
+
+    void removeTask(const std::size_t taskId)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        if(it == m_tasks.end()) {
+            return;
+        }
+        it->second.jobs.clear();
+        m_changed.wait(lock, [&it]() { return !it->second.running; });
+        m_tasks.erase(it);
+    }
+
+    void submit(const std::size_t taskId, std::function<void()> job)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        assert(it != m_tasks.end() && "Job submitted for a task that is not registered");
+        if(it == m_tasks.end()) {
+            return;
+        }
+
+        // A task that was idle rejoins at the current virtual time, so it cannot bank running time while it had nothing to do
+        TaskEntry& entry{it->second};
+        if(!entry.running && entry.jobs.empty()) {
+            entry.virtualTime = std::max(entry.virtualTime, m_virtualTime);
+        }
+        entry.jobs.push_back(std::move(job));
+
+        if(m_runners < m_maxRunners) {
+            m_runners++;
+            m_pool.submit([this]() { runNextJob(); });
+        }
+    }
+
+    void setPriority(const std::size_t taskId, const int priority)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        if(it != m_tasks.end()) {
+            it->second.priority = priority;
+        }
+    }
+
+    int getPriority(const std::size_t taskId) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        return it == m_tasks.end() ? TaskScheduler::DEFAULT_PRIORITY : it->second.priority;
+    }
+
+    void setWeight(const std::size_t taskId, const std::uint32_t weight)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        if(it != m_tasks.end()) {
+            it->second.weight = std::max(1U, weight);
+        }
+    }
+
+    std::uint32_t getWeight(const std::size_t taskId) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        return it == m_tasks.end() ? TaskScheduler::DEFAULT_WEIGHT : it->second.weight;
+    }
+
+    std::size_t getPendingJobCount(const std::size_t taskId) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_tasks.find(taskId);
+        if(it == m_tasks.end()) {
+            return 0;
+        }
+        return it->second.jobs.size() + (it->second.running ? 1U : 0U);
+    }
+
+private:
+    // Picks the task whose next job should run: the highest priority first, then the least running time for its weight, then the oldest task
+    TaskEntry* pickNext(std::size_t& taskId)
+    {
+        TaskEntry* best{nullptr};
+        for(auto& entry : m_tasks) {
+            TaskEntry& candidate{entry.second};
+            if(candidate.running || candidate.jobs.empty()) {
+                continue;
+            }
+            if(!best || candidate.priority > best->priority || (candidate.priority == best->priority && candidate.virtualTime < best->virtualTime)) {
+                best = &candidate;
+                taskId = entry.first;
+            }
+        }
+        return best;
+    }
+
+    // Runs on a pool thread, taking one job from the most deserving task
+    // The runner queues itself again while jobs remain rather than looping, so the pool thread is handed back between jobs
+    void runNextJob()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::size_t taskId{0};
+        TaskEntry* entry{pickNext(taskId)};
+        if(!entry) {
+            m_runners--;
+            m_changed.notify_all();
+            return;
+        }
+
+        std::function<void()> job{std::move(entry->jobs.front())};
+        entry->jobs.pop_front();
+        entry->running = true;
+        m_virtualTime = std::max(m_virtualTime, entry->virtualTime);
+        lock.unlock();
+
+        // Jobs handle their own errors, an exception that escapes one is a bug and is left to end the program rather than be hidden
+        const auto start = std::chrono::steady_clock::now();
+        job();
+        const std::chrono::duration<double, std::micro> elapsed{std::chrono::steady_clock::now() - start};
+        job = nullptr;
+
+        // The entry cannot have been erased while its job was running, removeTask waits for it
+        lock.lock();
+        entry->virtualTime += elapsed.count() / entry->weight;
+        entry->running = false;
+        if(pickNext(taskId)) {
+            m_pool.submit([this]() { runNextJob(); });
+        } else {
+            m_runners--;
+        }
+        m_changed.notify_all();
+    }
+
+    geometrize::optimizer::ThreadPool& m_pool; ///> The pool that jobs run on
+    const std::size_t m_maxRunners; ///> The maximum number of jobs that may run at the same time
+    std::size_t m_runners; ///> The number of runners queued or running on the pool, each running one job at a time
+    std::size_t m_nextId; ///> The id to give the next registered task
+    double m_virtualTime; ///> The virtual time of the most recently started job, given to tasks that become busy after being idle
+    std::map<std::size_t, TaskEntry> m_tasks; ///> The registered tasks, by id
+    mutable std::mutex m_mutex; ///> Guards all of the scheduling state
+    std::condition_variable m_changed; ///> Signalled whenever a job finishes or a runner exits
+};
+
+TaskScheduler::TaskScheduler(geometrize::optimizer::ThreadPool& pool, const std::size_t maxConcurrentJobs) :
+    d{std::make_unique<TaskScheduler::TaskSchedulerImpl>(pool, maxConcurrentJobs)}
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+}
+
+std::size_t TaskScheduler::addTask(const int priority, const std::uint32_t weight)
+{
+    return d->addTask(priority, weight);
+}
+
+void TaskScheduler::removeTask(const std::size_t taskId)
+{
+    d->removeTask(taskId);
+}
+
+void TaskScheduler::submit(const std::size_t taskId, std::function<void()> job)
+{
+    d->submit(taskId, std::move(job));
+}
+
+void TaskScheduler::setPriority(const std::size_t taskId, const int priority)
+{
+    d->setPriority(taskId, priority);
+}
+
+int TaskScheduler::getPriority(const std::size_t taskId) const
+{
+    return d->getPriority(taskId);
+}
+
+void TaskScheduler::setWeight(const std::size_t taskId, const std::uint32_t weight)
+{
+    d->setWeight(taskId, weight);
+}
+
+std::uint32_t TaskScheduler::getWeight(const std::size_t taskId) const
+{
+    return d->getWeight(taskId);
+}
+
+std::size_t TaskScheduler::getPendingJobCount(const std::size_t taskId) const
+{
+    return d->getPendingJobCount(taskId);
+}
+
+TaskScheduler& getSharedTaskScheduler()
+{
+    // One job per pool thread at most, each job's own parallel loops fill in the gaps
+    static TaskScheduler scheduler(geometrize::optimizer::getSharedThreadPool(), geometrize::optimizer::getSharedThreadPool().getThreadCount());
+    return scheduler;
+}
+
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace geometrize
+{
+
+namespace optimizer
+{
+class ThreadPool;
+}
+
+}
+
+namespace geometrize
+{
+
+namespace task
+{
+
+/**
+ * @brief The TaskScheduler class multiplexes the work of many image tasks over a single thread pool.
+ * Each registered task has a queue of jobs that run one at a time and in order. Tasks with a higher priority always go first,
+ * and tasks of equal priority share the pool in proportion to their weights, measured by the time their jobs take to run.
+ */
+class TaskScheduler
+{
+public:
+    static const int DEFAULT_PRIORITY{0}; ///< The priority that tasks are registered with by default.
+    static const std::uint32_t DEFAULT_WEIGHT{1}; ///< The weight that tasks are registered with by default.
+
+    /**
+     * @brief TaskScheduler Creates a scheduler that runs jobs on the given pool.
+     * @param pool The thread pool to run jobs on.
+     * @param maxConcurrentJobs The maximum number of jobs, from different tasks, that may run at the same time.
+     */
+    TaskScheduler(geometrize::optimizer::ThreadPool& pool, std::size_t maxConcurrentJobs);
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    TaskScheduler(const TaskScheduler&) = delete;
+    ~TaskScheduler();
+
+    /**
+     * @brief addTask Registers a new task with the scheduler.
+     * @param priority The priority of the task.
+     * @param weight The weight of the task, relative to other tasks of the same priority.
+     * @return The id of the task, used to submit jobs for it.
+     */
+    std::size_t addTask(int priority = DEFAULT_PRIORITY, std::uint32_t weight = DEFAULT_WEIGHT);
+
+    /**
+     * @brief removeTask Unregisters a task. Jobs that have not started are discarded, and if a job is running this blocks until it returns.
+     * @param taskId The id of the task to remove.
+     */
+    void removeTask(std::size_t taskId);
+
+    /**
+     * @brief submit Queues a job for a task. The job runs after the jobs already queued for the task, on one of the pool threads.
+     * Jobs must handle their own errors. An exception that escapes a job is not caught, and ends the program.
+     * @param taskId The id of the task.
+     * @param job The job to run.
+     */
+    void submit(std::size_t taskId, std::function<void()> job);
+
+    /**
+     * @brief setPriority Sets the priority of a task. Tasks with a higher priority run before tasks with a lower priority.
+     * @param taskId The id of the task.
+     * @param priority The priority of the task.
+     */
+    void setPriority(std::size_t taskId, int priority);
+
+    /**
+     * @brief getPriority Gets the priority of a task.
+     * @param taskId The id of the task.
+     * @return The priority of the task.
+     */
+    int getPriority(std::size_t taskId) const;
+
+    /**
+     * @brief setWeight Sets the weight of a task. A task with twice the weight of another task of the same priority gets twice the running time.
+     * @param taskId The id of the task.
+     * @param weight The weight of the task, zero is treated as one.
+     */
+    void setWeight(std::size_t taskId, std::uint32_t weight);
+
+    /**
+     * @brief getWeight Gets the weight of a task.
+     * @param taskId The id of the task.
+     * @return The weight of the task.
+     */
+    std::uint32_t getWeight(std::size_t taskId) const;
+
+    /**
+     * @brief getPendingJobCount Gets the number of jobs that are queued or running for a task.
+     * @param taskId The id of the task.
+     * @return The number of jobs queued or running.
+     */
+    std::size_t getPendingJobCount(std::size_t taskId) const;
+
+private:
+    class TaskSchedulerImpl;
+    std::unique_ptr<TaskSchedulerImpl> d;
+};
+
+/**
+ * @brief getSharedTaskScheduler Gets the process-wide scheduler that image tasks run their steps on, backed by the shared thread pool.
+ * @return The shared task scheduler.
+ */
+TaskScheduler& getSharedTaskScheduler();
+
+}
+
+}
@@ -85,7 +85,7 @@ bool openTemplate(chaiscript::ChaiScript& engine, const std::string& templateFol
 
     const std::string script{util::readFileAsString(scripts.front())};
     engine.set_global(chaiscript::var(templateFolder), "templateDirectory");
-    geometrize::script::runScript(script, engine);
+    geometrize::script::runScript(script, engine, scripts.front());
 
     return true;
 }